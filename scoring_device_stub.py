@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""
+Stand-in for the scoring device, for testing the remote without one.
+
+Listens on the command port, answers liveness pings with echoes, ACKs
+reliable frames and prints every command word it receives. Run it on a host
+that owns the target address (e.g. a hotspot called Piste_001 on
+192.168.4.1), or on localhost together with a host build.
+
+    python3 scoring_device_stub.py [--port 1234] [--drop 10] [--delay 50]
+                                   [--state 1] [--drift 80]
+
+--drop and --delay apply to echoes and ACKs so that loss and RTT handling
+can be exercised; --mute answers nothing, like a hung device.
+
+--state HZ plays a simulated bout and sends state datagrams to every remote
+that has pinged within the last two seconds: on each event (the clock
+starting or stopping, a touch, a card) and at HZ in between, for the
+scoreboard mirror and for measuring its receive cost (see scoreboard.h).
+Echoes and state datagrams carry the stub's ms clock, which --drift makes
+run fast (or slow, if negative) by that many ppm to exercise the remote's
+clock sync (see clock_sync.h).
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import time
+
+# Must match reliable_udp.h and liveness.h
+TAG_MASK = 0xFF000000
+RELIABLE_FRAME_TAG = 0x07000000
+RELIABLE_ACK_TAG = 0x08000000
+LIVENESS_PING_TAG = 0x09000000
+LIVENESS_ECHO_TAG = 0x0A000000
+COMMAND_TAG = 0x06000000
+STATE_TAG = 0x0B000000  # scoreboard.h
+STATE_VERSION = 2
+
+SUBSCRIPTION_S = 2.0  # remotes ping every second
+TICK_S = 0.01  # bout simulation step
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--port", type=int, default=1234)
+    parser.add_argument("--drop", type=float, default=0.0,
+                        help="percentage of echoes/ACKs to drop")
+    parser.add_argument("--delay", type=float, default=0.0,
+                        help="milliseconds to wait before answering")
+    parser.add_argument("--mute", action="store_true",
+                        help="never answer (simulates a hung device)")
+    parser.add_argument("--state", type=float, default=0.0, metavar="HZ",
+                        help="also send scoreboard state at this rate")
+    parser.add_argument("--drift", type=float, default=0.0, metavar="PPM",
+                        help="make the device clock run fast by this much")
+    return parser.parse_args()
+
+
+class DeviceClock:
+    """The device's ms clock: 32 bits from an arbitrary start, with drift."""
+
+    def __init__(self, drift_ppm):
+        self.start = time.monotonic()
+        self.origin_ms = random.randrange(1 << 32)
+        self.rate = 1 + drift_ppm / 1e6
+
+    def ms(self):
+        elapsed = (time.monotonic() - self.start) * self.rate
+        return (self.origin_ms + int(elapsed * 1000)) & 0xFFFFFFFF
+
+
+def reply(sock, addr, words, args):
+    """Send an answer, subject to --mute, --drop and --delay."""
+    if args.mute or random.uniform(0, 100) < args.drop:
+        return
+    if args.delay > 0:
+        time.sleep(args.delay / 1000.0)
+    sock.sendto(struct.pack(f"<{len(words)}I", *words), addr)
+
+
+class Bout:
+    """A bout that plays itself: the clock runs, touches and cards happen."""
+
+    def __init__(self):
+        self.seq = 0
+        self.scores = [0, 0]
+        self.cards = [0, 0]
+        self.remaining_cs = 3 * 60 * 100
+        self.running = True
+        self.weapon = 1  # epee
+        self.match_type = 0
+        self.priority = 0
+        self.period = 1
+
+    def advance(self, dt):
+        """Run the bout for dt seconds; True if anything but the clock
+        changed."""
+        event = False
+        if self.running:
+            self.remaining_cs = max(0, self.remaining_cs - round(dt * 100))
+        if self.remaining_cs == 0:
+            self.remaining_cs = 3 * 60 * 100
+            self.period = self.period % 3 + 1
+            event = True
+        # About one touch every five seconds, a card every thirty
+        if random.random() < dt / 5:
+            self.scores[random.randrange(2)] += 1
+            event = True
+        if random.random() < dt / 30:
+            event = True
+            side = random.randrange(2)
+            card = self.cards[side]
+            if not card & 0x01:
+                card |= 0x01  # yellow first, then reds
+            else:
+                reds = min((card >> 1 & 0x07) + 1, 7)
+                card = card & ~0x0E | reds << 1
+            self.cards[side] = card
+        if random.random() < dt / 10:
+            self.running = not self.running
+            event = True
+        return event
+
+    def pack(self, device_ms):
+        self.seq = (self.seq + 1) & 0xFFFF
+        return struct.pack(
+            "<5I",
+            STATE_TAG | STATE_VERSION << 16 | self.seq,
+            self.scores[0] & 0xFF | (self.scores[1] & 0xFF) << 8
+            | self.cards[0] << 16 | self.cards[1] << 24,
+            self.remaining_cs | (1 if self.running else 0) << 24,
+            self.weapon | self.match_type << 4 | self.priority << 8
+            | self.period << 12,
+            device_ms)
+
+
+def main():
+    args = parse_args()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    print(f"Scoring device stub listening on UDP port {args.port}")
+
+    # Per remote: boot epoch and recently applied sequence numbers, to drop
+    # retransmissions
+    applied = {}
+
+    clock = DeviceClock(args.drift)
+
+    # Remotes that pinged recently get state datagrams
+    subscribers = {}
+    bout = Bout()
+    period = 1.0 / args.state if args.state > 0 else None
+    next_tick = time.monotonic()
+    next_state = next_tick
+    sent_states = 0
+    last_report = next_tick
+
+    while True:
+        if period is not None:
+            now = time.monotonic()
+            if now >= next_tick:
+                # The bout clock runs on the device clock
+                event = bout.advance(TICK_S)
+                next_tick += TICK_S / clock.rate
+                if event or now >= next_state:
+                    state = bout.pack(clock.ms())
+                    for remote, seen in list(subscribers.items()):
+                        if now - seen > SUBSCRIPTION_S:
+                            del subscribers[remote]
+                        elif not args.mute:
+                            sock.sendto(state, remote)
+                            sent_states += 1
+                    next_state = now + period
+                if now - last_report >= 10:
+                    last_report = now
+                    print(f"{sent_states} state datagrams sent")
+                    sys.stdout.flush()
+            sock.settimeout(max(0.0, next_tick - time.monotonic()))
+        try:
+            data, addr = sock.recvfrom(512)
+        except socket.timeout:
+            continue
+        if len(data) < 4 or len(data) % 4 != 0:
+            continue
+        words = struct.unpack(f"<{len(data) // 4}I", data)
+        tag = words[0] & TAG_MASK
+        low = words[0] & 0x00FFFFFF
+
+        if tag == LIVENESS_PING_TAG:
+            subscribers[addr] = time.monotonic()
+            reply(sock, addr, [LIVENESS_ECHO_TAG | low, clock.ms()], args)
+            continue
+
+        if tag == RELIABLE_FRAME_TAG:
+            if len(words) < 2:
+                continue
+            remote = (low >> 16) & 0xFF
+            seq = low & 0xFFFF
+            epoch = words[1]
+            reply(sock, addr, [RELIABLE_ACK_TAG | low], args)
+            known_epoch, recent = applied.get(remote, (None, []))
+            if known_epoch != epoch:
+                # The remote has restarted, its sequence numbers start over
+                recent = []
+                applied[remote] = (epoch, recent)
+            if seq in recent:
+                print(f"{addr[0]} remote {remote:02x}: duplicate frame {seq}")
+                continue
+            recent.append(seq)
+            del recent[:-64]
+            words = words[2:]
+
+        for word in words:
+            if word & TAG_MASK == COMMAND_TAG:
+                print(f"{addr[0]}: command 0x{word:08X}")
+            else:
+                print(f"{addr[0]}: unknown word 0x{word:08X}")
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
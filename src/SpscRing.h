@@ -0,0 +1,100 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @class SpscRing
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+ *
+ * One task (or ISR) may call push(), one other task may call pop(). No locks
+ * are taken and no memory is allocated, so the producer side is safe to use
+ * from LVGL event callbacks. Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity> class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+public:
+  SpscRing() : head(0), tail(0) {}
+
+  /**
+   * @brief Appends an item (producer side).
+   * @return False if the ring is full and the item was not stored.
+   */
+  bool push(const T &item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+      return false;
+    }
+    slots[h & (Capacity - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Appends count items at once (producer side). The consumer sees
+   * either none or all of them.
+   * @return False if the ring has no room for all and none were stored.
+   */
+  bool push(const T *items, size_t count) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (Capacity - (h - tail.load(std::memory_order_acquire)) < count) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      slots[(h + i) & (Capacity - 1)] = items[i];
+    }
+    head.store(h + count, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes the oldest item (consumer side).
+   * @return False if the ring is empty.
+   */
+  bool pop(T &item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[t & (Capacity - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Gives access to the oldest item without removing it (consumer
+   * side).
+   * @return Pointer to the item, or NULL if the ring is empty.
+   */
+  const T *peek() const {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    return &slots[t & (Capacity - 1)];
+  }
+
+  /**
+   * @brief Number of items currently stored. Safe to call from either side,
+   * the result is a snapshot.
+   */
+  size_t size() const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  T slots[Capacity];
+  std::atomic<uint32_t> head; ///< Next slot to write, owned by the producer.
+  std::atomic<uint32_t> tail; ///< Next slot to read, owned by the consumer.
+};
+
+#endif // SPSCRING_H
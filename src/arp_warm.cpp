@@ -0,0 +1,181 @@
+#include "arp_warm.h"
+#include "logger.h"
+#include "wifi_power.h"
+#include <Arduino.h>
+#include <lwip/etharp.h>
+#include <lwip/ip4.h>
+#include <lwip/priv/tcpip_priv.h>
+
+enum { HOST_TARGET, HOST_GATEWAY, HOST_COUNT };
+
+struct Host {
+  ip4_addr_t ip;
+  bool valid;
+  bool pinned;
+};
+
+// Only touched on the lwIP thread, through tcpip_api_call()
+static Host hosts[HOST_COUNT];
+
+static volatile bool linkUp = false;
+static volatile bool allPinned = false;
+static volatile bool targetPinned = false;
+static volatile bool gatewayPinned = false;
+static uint32_t lastRefreshMs = 0;
+
+static volatile uint32_t arpMisses = 0;
+static volatile uint32_t resolutions = 0;
+static volatile uint32_t refreshes = 0;
+
+struct ArpCall {
+  struct tcpip_api_call_data call; // must be first
+  uint32_t targetIp;
+  uint32_t gatewayIp;
+  bool refresh;
+};
+
+static err_t doSetHosts(struct tcpip_api_call_data *data) {
+  ArpCall *c = (ArpCall *)data;
+  ip4_addr_set_u32(&hosts[HOST_TARGET].ip, c->targetIp);
+  ip4_addr_set_u32(&hosts[HOST_GATEWAY].ip, c->gatewayIp);
+  for (int i = 0; i < HOST_COUNT; i++) {
+    hosts[i].valid = !ip4_addr_isany_val(hosts[i].ip);
+    hosts[i].pinned = false;
+  }
+  // The scoring device is usually the AP itself
+  if (c->gatewayIp == c->targetIp) {
+    hosts[HOST_GATEWAY].valid = false;
+  }
+  return ERR_OK;
+}
+
+static err_t doUnpin(struct tcpip_api_call_data *data) {
+  (void)data;
+  for (int i = 0; i < HOST_COUNT; i++) {
+#if ETHARP_SUPPORT_STATIC_ENTRIES
+    if (hosts[i].pinned) {
+      etharp_remove_static_entry(&hosts[i].ip);
+    }
+#endif
+    hosts[i].valid = false;
+    hosts[i].pinned = false;
+  }
+  return ERR_OK;
+}
+
+// Pins hosts that have been resolved, asks for the others and, on a
+// refresh, re-announces us to the pinned ones
+static err_t doService(struct tcpip_api_call_data *data) {
+  ArpCall *c = (ArpCall *)data;
+  bool all = true;
+  for (int i = 0; i < HOST_COUNT; i++) {
+    Host &h = hosts[i];
+    if (!h.valid) {
+      continue;
+    }
+    struct netif *netif = ip4_route(&h.ip);
+    if (netif == NULL) {
+      all = false;
+      continue;
+    }
+    if (h.pinned) {
+      if (c->refresh) {
+        etharp_request(netif, &h.ip);
+        refreshes++;
+      }
+      continue;
+    }
+
+    struct eth_addr *eth;
+    const ip4_addr_t *ip;
+    if (etharp_find_addr(netif, &h.ip, &eth, &ip) >= 0) {
+      // Without static entries the refresh keeps the dynamic one alive
+#if ETHARP_SUPPORT_STATIC_ENTRIES
+      struct eth_addr mac = *eth;
+      etharp_add_static_entry(&h.ip, &mac);
+#endif
+      h.pinned = true;
+      resolutions++;
+      LOG_INFO("ARP: Pinned %u.%u.%u.%u\n", ip4_addr1(&h.ip), ip4_addr2(&h.ip),
+               ip4_addr3(&h.ip), ip4_addr4(&h.ip));
+    } else {
+      etharp_request(netif, &h.ip);
+      all = false;
+    }
+  }
+  allPinned = all;
+  targetPinned = hosts[HOST_TARGET].pinned;
+  gatewayPinned = hosts[HOST_GATEWAY].pinned;
+  return ERR_OK;
+}
+
+void arpWarmOnGotIp(uint32_t targetIp, uint32_t gatewayIp) {
+  ArpCall c;
+  c.targetIp = targetIp;
+  c.gatewayIp = gatewayIp;
+  tcpip_api_call(doSetHosts, &c.call);
+  allPinned = false;
+  lastRefreshMs = millis();
+  linkUp = true;
+}
+
+void arpWarmOnLinkDown() {
+  linkUp = false;
+  ArpCall c;
+  tcpip_api_call(doUnpin, &c.call);
+  allPinned = false;
+  targetPinned = false;
+  gatewayPinned = false;
+}
+
+uint32_t serviceArpWarm() {
+  if (!linkUp) {
+    return ARP_WARM_IDLE;
+  }
+  ArpCall c;
+  if (!allPinned) {
+    c.refresh = false;
+    tcpip_api_call(doService, &c.call);
+    if (!allPinned) {
+      return ARP_WARM_RESOLVE_RETRY_MS;
+    }
+  }
+
+  uint32_t sinceRefresh = millis() - lastRefreshMs;
+  if (sinceRefresh >= ARP_WARM_REFRESH_MS) {
+    lastRefreshMs = millis();
+    sinceRefresh = 0;
+    if (remoteActive()) {
+      c.refresh = true;
+      tcpip_api_call(doService, &c.call);
+    }
+  }
+  return ARP_WARM_REFRESH_MS - sinceRefresh;
+}
+
+void arpWarmCheckNextHop(uint32_t ip) {
+  ip4_addr_t dest;
+  ip4_addr_set_u32(&dest, ip);
+  struct netif *netif = ip4_route(&dest);
+  if (netif == NULL) {
+    return;
+  }
+  const ip4_addr_t *hop = &dest;
+  if (!ip4_addr_netcmp(&dest, netif_ip4_addr(netif),
+                       netif_ip4_netmask(netif))) {
+    hop = netif_ip4_gw(netif);
+  }
+  struct eth_addr *eth;
+  const ip4_addr_t *found;
+  if (etharp_find_addr(netif, hop, &eth, &found) < 0) {
+    arpMisses++;
+  }
+}
+
+void getArpWarmStats(ArpWarmStats *stats) {
+  stats->arpMisses = arpMisses;
+  stats->resolutions = resolutions;
+  stats->refreshes = refreshes;
+  stats->targetPinned = targetPinned;
+  stats->gatewayPinned = gatewayPinned;
+}
@@ -0,0 +1,50 @@
+#ifndef ARP_WARM_H
+#define ARP_WARM_H
+
+#include <stdint.h>
+
+// Keeps the ARP entries for the scoring device and the gateway warm. A
+// datagram to an unresolved next hop waits in the ARP queue for a full
+// request/reply round trip, which would land on the first command after
+// an idle period. After GOT_IP both hosts are resolved right away; the
+// first resolution of each is pinned as a static entry for the rest of the
+// association (a piste change means another device at the same address,
+// so link down unpins them). While the remote is active the network task
+// also sends an ARP request every ARP_WARM_REFRESH_MS, which keeps the
+// scoring device's entry for us warm so its ACKs and echoes do not wait.
+#define ARP_WARM_REFRESH_MS 60000
+#define ARP_WARM_RESOLVE_RETRY_MS 250 // until both hosts are resolved
+
+// Returned by serviceArpWarm() while there is no link
+#define ARP_WARM_IDLE UINT32_MAX
+
+typedef struct {
+  uint32_t arpMisses;   // datagrams sent while their next hop was unresolved
+  uint32_t resolutions; // hosts resolved and pinned
+  uint32_t refreshes;   // ARP requests sent by the refresh timer
+  bool targetPinned;
+  bool gatewayPinned;
+} ArpWarmStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WiFi event task. Addresses in network byte order, as (uint32_t)IPAddress.
+void arpWarmOnGotIp(uint32_t targetIp, uint32_t gatewayIp);
+void arpWarmOnLinkDown();
+
+// Network task; returns the ms until the next resolve attempt or refresh
+uint32_t serviceArpWarm();
+
+// lwIP thread, right before a datagram to ip is handed to udp_sendto():
+// counts it as an ARP miss if its next hop is not resolved
+void arpWarmCheckNextHop(uint32_t ip);
+
+void getArpWarmStats(ArpWarmStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARP_WARM_H
@@ -1,9 +1,63 @@
 #include "backlight.h"
+#include "logger.h"
+#include "wifi_power.h"
 #include <Arduino.h>
 #include <Preferences.h>
+#include <driver/ledc.h>
+#include <esp_sleep.h>
+
+#define BL_MODE LEDC_LOW_SPEED_MODE // the only mode with the RTC clock
+#define BL_FADE_MAX 1023            // step count, cycles and scale fields
+
+// CIE 1931: relative luminance for lightness l (0-100)
+static constexpr double cieLuminance(double l) {
+  return l > 8.0 ? ((l + 16.0) / 116.0) * ((l + 16.0) / 116.0) *
+                       ((l + 16.0) / 116.0)
+                 : l / 903.3;
+}
+
+// Any level above 0 stays visibly lit
+static constexpr uint16_t levelDuty(uint32_t level) {
+  return level == 0 ? 0
+         : cieLuminance(level * 100.0 / 255.0) * BL_DUTY_MAX < 1.0
+             ? 1
+             : (uint16_t)(cieLuminance(level * 100.0 / 255.0) * BL_DUTY_MAX +
+                          0.5);
+}
+
+#define BL_DUTY_1(i) levelDuty(i),
+#define BL_DUTY_4(i)                                                           \
+  BL_DUTY_1(i) BL_DUTY_1(i + 1) BL_DUTY_1(i + 2) BL_DUTY_1(i + 3)
+#define BL_DUTY_16(i)                                                          \
+  BL_DUTY_4(i) BL_DUTY_4(i + 4) BL_DUTY_4(i + 8) BL_DUTY_4(i + 12)
+#define BL_DUTY_64(i)                                                          \
+  BL_DUTY_16(i) BL_DUTY_16(i + 16) BL_DUTY_16(i + 32) BL_DUTY_16(i + 48)
+
+static constexpr uint16_t LEVEL_DUTY[256] = {
+    BL_DUTY_64(0) BL_DUTY_64(64) BL_DUTY_64(128) BL_DUTY_64(192)};
+static_assert(LEVEL_DUTY[0] == 0 && LEVEL_DUTY[1] == 1 &&
+                  LEVEL_DUTY[255] == BL_DUTY_MAX,
+              "backlight table must span the duty range");
+
+// The perceptual level with the duty closest to a linear level (0-255) of
+// firmware before the table, for stored settings
+static uint8_t levelFromLinear(uint8_t linear) {
+  uint32_t duty = ((uint32_t)linear * BL_DUTY_MAX + 127) / 255;
+  uint32_t level = 0;
+  while (level < 255 && LEVEL_DUTY[level + 1] <= duty) {
+    level++;
+  }
+  if (level < 255 &&
+      LEVEL_DUTY[level + 1] - duty < duty - LEVEL_DUTY[level]) {
+    level++;
+  }
+  return (uint8_t)level;
+}
 
 static unsigned long lastTouchTime = 0;
 static bool backlightActive = true;
+static bool litInLightSleep = false;
+static unsigned long fadeEndMs = 0; // of the fade to idle
 
 // Runtime values (loaded from NVS or defaults)
 static uint8_t defaultBrightness = DEFAULT_BRIGHTNESS_DEFAULT;
@@ -12,16 +66,82 @@ static uint32_t backlightTimeoutMs = BACKLIGHT_TIMEOUT_MS_DEFAULT;
 
 static Preferences backlightPrefs;
 
-void setBrightness(__UINT8_TYPE__ value) {
-  ledcSetup(BL_CH, BL_FREQ, BL_RES);
-  ledcAttachPin(TFT_BL, BL_CH);
-  ledcWrite(BL_CH, value);
+// Prefers the 8 MHz RTC clock, which keeps running in light sleep
+static void configureLedc() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = BL_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)BL_RES;
+  timer.timer_num = (ledc_timer_t)BL_TIMER;
+  timer.freq_hz = BL_FREQ;
+  timer.clk_cfg = LEDC_USE_RTC8M_CLK;
+  litInLightSleep = ledc_timer_config(&timer) == ESP_OK;
+  if (litInLightSleep) {
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+  } else {
+    timer.clk_cfg = LEDC_AUTO_CLK;
+    ledc_timer_config(&timer);
+  }
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = TFT_BL;
+  channel.speed_mode = BL_MODE;
+  channel.channel = (ledc_channel_t)BL_CH;
+  channel.intr_type = LEDC_INTR_DISABLE;
+  channel.timer_sel = (ledc_timer_t)BL_TIMER;
+  channel.duty = 0;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+}
+
+// Takes effect at the next PWM period, also in the middle of a fade
+static void writeDuty(uint32_t duty) {
+  ledc_set_duty(BL_MODE, (ledc_channel_t)BL_CH, duty);
+  ledc_update_duty(BL_MODE, (ledc_channel_t)BL_CH);
+}
+
+// Hardware fade from the current duty, without the driver's fade service:
+// that one would block a wake-up until the fade has finished. Returns the
+// fade time.
+static uint32_t fadeDuty(uint32_t duty, uint32_t ms) {
+  uint32_t from = ledc_get_duty(BL_MODE, (ledc_channel_t)BL_CH);
+  bool up = duty > from;
+  uint32_t delta = up ? duty - from : from - duty;
+  uint32_t periods = ms * BL_FREQ / 1000;
+  if (delta == 0 || periods == 0) {
+    writeDuty(duty);
+    return 0;
+  }
+  uint32_t scale = (delta + BL_FADE_MAX - 1) / BL_FADE_MAX;
+  uint32_t steps = delta / scale;
+  uint32_t cycles = periods / steps;
+  cycles = cycles < 1 ? 1 : cycles > BL_FADE_MAX ? BL_FADE_MAX : cycles;
+  // Start less than one step off so that the last step lands on duty
+  uint32_t start = up ? duty - steps * scale : duty + steps * scale;
+  ledc_set_fade(BL_MODE, (ledc_channel_t)BL_CH, start,
+                up ? LEDC_DUTY_DIR_INCREASE : LEDC_DUTY_DIR_DECREASE, steps,
+                cycles, scale);
+  ledc_update_duty(BL_MODE, (ledc_channel_t)BL_CH);
+  return steps * cycles * 1000 / BL_FREQ;
 }
 
+void setBrightness(__UINT8_TYPE__ value) { writeDuty(LEVEL_DUTY[value]); }
+
 void initBacklight() {
   // Load settings from NVS
   backlightPrefs.begin("backlight", false);
 
+  // Keep the brightness users had set before the levels became perceptual
+  if (backlightPrefs.getUChar("ver", 0) < BACKLIGHT_LEVELS_VERSION) {
+    const char *const keys[] = {"defBright", "idleBright"};
+    for (const char *key : keys) {
+      if (backlightPrefs.isKey(key)) {
+        uint8_t linear = backlightPrefs.getUChar(key, 0);
+        backlightPrefs.putUChar(key, levelFromLinear(linear));
+      }
+    }
+    backlightPrefs.putUChar("ver", BACKLIGHT_LEVELS_VERSION);
+  }
+
   // Read values from NVS, use defaults if not found
   defaultBrightness =
       backlightPrefs.getUChar("defBright", DEFAULT_BRIGHTNESS_DEFAULT);
@@ -36,34 +156,55 @@ void initBacklight() {
       "Backlight settings loaded: Default=%d, Idle=%d, Timeout=%dms\n",
       defaultBrightness, idleBrightness, backlightTimeoutMs);
 
+  configureLedc();
   setBrightness(defaultBrightness);
   lastTouchTime = millis();
   backlightActive = true;
 }
 
-void updateBacklightTimer() {
+uint32_t updateBacklightTimer() {
   unsigned long currentTime = millis();
+  if (!backlightActive) {
+    long fading = (long)(fadeEndMs - currentTime);
+    return fading > 0 ? (uint32_t)fading : UINT32_MAX;
+  }
 
   // Check if timeout has elapsed
-  if (backlightActive && (currentTime - lastTouchTime >= backlightTimeoutMs)) {
-    // Turn off backlight after inactivity
-    setBrightness(idleBrightness);
+  unsigned long elapsed = currentTime - lastTouchTime;
+  if (elapsed >= backlightTimeoutMs) {
+    // Fade to idle brightness after inactivity
+    uint32_t fadeMs = fadeDuty(LEVEL_DUTY[idleBrightness], BL_FADE_TO_IDLE_MS);
+    fadeEndMs = currentTime + fadeMs;
     backlightActive = false;
-    Serial.println("Backlight off due to inactivity");
+    wifiPowerOnIdle();
+    LOG_INFO("Backlight: dimming after inactivity\n");
+    return fadeMs > 0 ? fadeMs : UINT32_MAX;
   }
+  return backlightTimeoutMs - elapsed;
+}
+
+// Out of line, so that the touch path stays a store and a branch
+static void __attribute__((noinline)) wakeBacklight() {
+  writeDuty(LEVEL_DUTY[defaultBrightness]); // cuts a running fade short
+  backlightActive = true;
+  LOG_INFO("Backlight: restored on touch\n");
 }
 
 void resetBacklightTimer() {
   lastTouchTime = millis();
 
-  // If backlight was off, turn it back on
-  if (!backlightActive) {
-    setBrightness(defaultBrightness);
-    backlightActive = true;
-    Serial.println("Backlight restored on touch");
+  // If backlight was dimmed, turn it back on
+  if (__builtin_expect(!backlightActive, 0)) {
+    wakeBacklight();
   }
 }
 
+bool backlightDimmed() {
+  return !backlightActive && (long)(millis() - fadeEndMs) >= 0;
+}
+
+bool backlightLitInLightSleep() { return litInLightSleep; }
+
 // Global touch event callback - resets backlight on any touch
 void onTouchEvent(lv_event_t *e) {
   lv_event_code_t code = lv_event_get_code(e);
@@ -2,14 +2,22 @@
 
 #include <lvgl.h>
 
+// Brightness settings are perceptual levels 0-255. They reach the LEDC duty
+// through a CIE 1931 lightness table, so equal steps look equal. LEDC is
+// configured once; dimming to idle is a hardware fade, waking is instant.
 #define TFT_BL 21
 #define BL_CH 0
+#define BL_TIMER 0
 #define BL_FREQ 2000 // 2 kHz (good for TFT)
-#define BL_RES 8     // 0–255
-
-// Default values (used if NVS not initialized)
-#define DEFAULT_BRIGHTNESS_DEFAULT 100
-#define IDLE_BRIGHTNESS_DEFAULT 10
+#define BL_RES 11    // duty 0-2047, resolves the dark end of the table
+#define BL_DUTY_MAX ((1 << BL_RES) - 1)
+#define BL_FADE_TO_IDLE_MS 1000
+
+// Default values (used if NVS not initialized). Same duty as the linear
+// levels 100 and 10 of firmware before the lightness table.
+#define DEFAULT_BRIGHTNESS_DEFAULT 176
+#define IDLE_BRIGHTNESS_DEFAULT 60
+#define BACKLIGHT_LEVELS_VERSION 1 // "ver" in NVS; 0: levels were linear
 #define BACKLIGHT_TIMEOUT_MS_DEFAULT 15000
 
 #ifdef __cplusplus
@@ -18,8 +26,15 @@ extern "C" {
 
 extern void setBrightness(__UINT8_TYPE__ value);
 extern void initBacklight();
-extern void updateBacklightTimer();
+// Dims after the timeout; returns the ms until then or until the fade ends
+// (UINT32_MAX if dimmed)
+extern uint32_t updateBacklightTimer();
+// Called for every touch sample: a store and a branch while lit
 extern void resetBacklightTimer();
+// At idle brightness after the timeout, fade completed
+extern bool backlightDimmed();
+// Whether the PWM keeps running in light sleep (LEDC on the 8 MHz RTC clock)
+extern bool backlightLitInLightSleep();
 extern void onTouchEvent(lv_event_t *e);
 
 // Setter functions for brightness and timeout settings
@@ -0,0 +1,74 @@
+#include "boot_profile.h"
+#include "logger.h"
+#include <Arduino.h>
+
+struct BootPhase {
+  const char *name;
+  uint32_t endUs; // since reset
+};
+
+static BootPhase phases[BOOT_MAX_PHASES];
+static uint32_t phaseCount = 0;
+static volatile uint32_t wifiReadyUs = 0;
+static uint32_t readyUs = 0;
+static uint32_t centralUs = 0;
+
+void bootMark(const char *name) {
+  if (phaseCount < BOOT_MAX_PHASES) {
+    phases[phaseCount].name = name;
+    phases[phaseCount].endUs = (uint32_t)esp_timer_get_time();
+    phaseCount++;
+  }
+}
+
+void bootMarkWiFiReady() {
+  if (wifiReadyUs != 0) {
+    return;
+  }
+  wifiReadyUs = (uint32_t)esp_timer_get_time();
+  if (readyUs != 0) {
+    // UI came up first, the report has already been written
+    LOG_INFO("Boot: WiFi ready at %u ms\n", wifiReadyUs / 1000);
+  }
+}
+
+void bootReport() {
+  if (readyUs != 0) {
+    return;
+  }
+  readyUs = (uint32_t)esp_timer_get_time();
+  bootMark("ui ready");
+
+  uint32_t previousUs = 0;
+  for (uint32_t i = 0; i < phaseCount; i++) {
+    LOG_INFO("Boot: %-16s %6u us, at %u ms\n", phases[i].name,
+             phases[i].endUs - previousUs, phases[i].endUs / 1000);
+    previousUs = phases[i].endUs;
+  }
+  if (wifiReadyUs != 0) {
+    LOG_INFO("Boot: WiFi ready at %u ms, UI ready at %u ms\n",
+             wifiReadyUs / 1000, readyUs / 1000);
+  } else {
+    LOG_INFO("Boot: UI ready at %u ms, WiFi still associating\n",
+             readyUs / 1000);
+  }
+  if (centralUs != 0) {
+    LOG_INFO("Boot: Central ready at %u ms\n", centralUs / 1000);
+  }
+}
+
+void bootMarkCentral() {
+  if (centralUs != 0) {
+    return;
+  }
+  centralUs = (uint32_t)esp_timer_get_time();
+  if (readyUs != 0) {
+    // Usually: the report went out with the No_Connection screen
+    LOG_INFO("Boot: Central ready at %u ms, %u ms after the UI\n",
+             centralUs / 1000, (centralUs - readyUs) / 1000);
+  }
+}
+
+uint32_t bootReadyUs() { return readyUs; }
+
+uint32_t bootCentralUs() { return centralUs; }
@@ -0,0 +1,45 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+
+// Boot-time profiler. setup() marks the end of every startup phase; the
+// first loop() iteration that has rendered the initial screen reports all
+// phases with their duration and the time since reset. That screen is
+// No_Connection, so the remote is only usable once the connectivity
+// listener first loads Central: bootMarkCentral() records that, which is
+// the time the referee waits for. Timestamps come from esp_timer, which
+// starts counting early in the bootloader hand-off.
+#define BOOT_MAX_PHASES 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Record the end of a phase. name must be a string literal. Call from the
+// Arduino task only.
+void bootMark(const char *name);
+
+// Record when the station got its IP address. Safe from the WiFi event
+// task; only the first call after boot counts.
+void bootMarkWiFiReady();
+
+// Mark "ui ready" and log the boot profile. Only the first call has any
+// effect, so it can sit in loop().
+void bootReport();
+
+// Record when the Central screen is first loaded and log the time since
+// reset. Only the first call has any effect.
+void bootMarkCentral();
+
+// Microseconds since reset at which the first screen was drawn, 0 before
+uint32_t bootReadyUs();
+
+// Microseconds since reset at which Central was first loaded, 0 before
+uint32_t bootCentralUs();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_PROFILE_H
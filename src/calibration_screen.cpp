@@ -0,0 +1,251 @@
+#include "calibration_screen.h"
+#include "logger.h"
+#include "screen_manager.h"
+#include "touch_calibration.h"
+#include "ui/ui.h"
+#include <Preferences.h>
+#include <stdio.h>
+
+typedef struct {
+  uint32_t version;
+  TouchCalibration native;
+} StoredCalibration;
+
+// Loop task
+static uint8_t displayRotation = 0;
+static int32_t screenWidth = 240;
+static int32_t screenHeight = 320;
+static TouchCalibration active; // rotation folded in
+static uint16_t lastRawX = 0;   // last pressed sample, for the screen
+static uint16_t lastRawY = 0;
+
+lv_obj_t *ui_Calibration_Screen = NULL;
+static lv_obj_t *crossH = NULL;
+static lv_obj_t *crossV = NULL;
+static lv_obj_t *instructions = NULL;
+static lv_obj_t *cancelButton = NULL;
+static lv_timer_t *leaveTimer = NULL; // result shown, touches ignored
+
+#define CAL_TARGETS 4 // three to solve, one to check
+static int32_t targets[CAL_TARGETS][2];
+static int32_t rawPoints[CAL_TARGETS][2];
+static uint32_t step = 0;
+static char resultText[48];
+
+static int32_t nativeWidth() {
+  return displayRotation & 1 ? screenHeight : screenWidth;
+}
+
+static int32_t nativeHeight() {
+  return displayRotation & 1 ? screenWidth : screenHeight;
+}
+
+static bool loadCalibration(TouchCalibration *native) {
+  StoredCalibration stored;
+  Preferences prefs;
+  if (!prefs.begin(TOUCH_CAL_NAMESPACE, true)) {
+    return false; // never calibrated
+  }
+  size_t len = prefs.getBytes("cal", &stored, sizeof(stored));
+  prefs.end();
+  if (len != sizeof(stored) || stored.version != TOUCH_CAL_VERSION) {
+    return false;
+  }
+  *native = stored.native;
+  return true;
+}
+
+static void saveCalibration(const TouchCalibration *native) {
+  StoredCalibration stored;
+  stored.version = TOUCH_CAL_VERSION;
+  stored.native = *native;
+  Preferences prefs;
+  prefs.begin(TOUCH_CAL_NAMESPACE, false);
+  prefs.putBytes("cal", &stored, sizeof(stored));
+  prefs.end();
+}
+
+static void useCalibration(const TouchCalibration *native) {
+  touchCalibrationRotate(native, displayRotation, nativeWidth(),
+                         nativeHeight(), &active);
+}
+
+void initTouchMapping(uint8_t rotation, int32_t width, int32_t height) {
+  displayRotation = rotation & 3;
+  screenWidth = width;
+  screenHeight = height;
+  TouchCalibration native;
+  if (loadCalibration(&native)) {
+    LOG_INFO("Touch: calibration loaded\n");
+  } else {
+    touchCalibrationDefault(nativeWidth(), nativeHeight(), &native);
+  }
+  useCalibration(&native);
+}
+
+void mapTouchPoint(uint16_t rawX, uint16_t rawY, lv_point_t *point) {
+  lastRawX = rawX;
+  lastRawY = rawY;
+  int32_t x, y;
+  touchCalibrationApply(&active, rawX, rawY, screenWidth, screenHeight, &x,
+                        &y);
+  point->x = (lv_coord_t)x;
+  point->y = (lv_coord_t)y;
+}
+
+static void showTarget() {
+  lv_obj_set_pos(crossH, targets[step][0] - 10, targets[step][1] - 1);
+  lv_obj_set_pos(crossV, targets[step][0] - 1, targets[step][1] - 10);
+}
+
+static void leave(lv_timer_t *timer) {
+  (void)timer;
+  leaveTimer = NULL; // deleted after its one run
+  showScreen(SCREEN_BASIC_SETTINGS);
+}
+
+// Solves from the first three touches and checks against the fourth
+static void finish() {
+  int32_t native[3][2];
+  for (int i = 0; i < 3; i++) {
+    touchScreenToNative(displayRotation, nativeWidth(), nativeHeight(),
+                        targets[i][0], targets[i][1], &native[i][0],
+                        &native[i][1]);
+  }
+  TouchCalibration cal;
+  TouchCalibration rotated;
+  int32_t error = INT32_MAX;
+  bool solved = touchCalibrationSolve(rawPoints, native, &cal);
+  if (solved) {
+    int32_t x, y;
+    touchCalibrationRotate(&cal, displayRotation, nativeWidth(),
+                           nativeHeight(), &rotated);
+    touchCalibrationApply(&rotated, rawPoints[3][0], rawPoints[3][1],
+                          screenWidth, screenHeight, &x, &y);
+    int32_t dx = x - targets[3][0];
+    int32_t dy = y - targets[3][1];
+    error = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+  }
+
+  step = 0;
+  if (!solved || error > TOUCH_CAL_VERIFY_MAX_PX) {
+    if (solved) {
+      snprintf(resultText, sizeof(resultText),
+               "Off by %d px.\nTouch the cross again.", (int)error);
+    } else {
+      snprintf(resultText, sizeof(resultText),
+               "Touches too close.\nTouch the cross again.");
+    }
+    lv_label_set_text_static(instructions, resultText);
+    showTarget();
+    LOG_WARN("Touch: calibration rejected, error %d px\n", error);
+    return;
+  }
+
+  saveCalibration(&cal);
+  active = rotated;
+  lv_obj_add_flag(crossH, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_add_flag(crossV, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_add_flag(cancelButton, LV_OBJ_FLAG_HIDDEN);
+  lv_label_set_text_static(instructions, "Calibration saved");
+  leaveTimer = lv_timer_create(leave, 1000, NULL);
+  lv_timer_set_repeat_count(leaveTimer, 1);
+  LOG_INFO("Touch: calibration saved, check off by %d px\n", error);
+}
+
+// A touch is taken on release, however long it was held, so that a slow,
+// careful touch counts like any other
+static void onScreenEvent(lv_event_t *e) {
+  if (lv_event_get_code(e) == LV_EVENT_RELEASED && !leaveTimer &&
+      step < CAL_TARGETS) {
+    rawPoints[step][0] = lastRawX;
+    rawPoints[step][1] = lastRawY;
+    if (++step == CAL_TARGETS) {
+      finish();
+    } else {
+      showTarget();
+    }
+  }
+}
+
+static void onCancelClicked(lv_event_t *e) {
+  (void)e;
+  if (!leaveTimer) {
+    showScreen(SCREEN_BASIC_SETTINGS);
+  }
+}
+
+static lv_obj_t *createBar(lv_coord_t w, lv_coord_t h) {
+  lv_obj_t *bar = lv_obj_create(ui_Calibration_Screen);
+  lv_obj_remove_style_all(bar);
+  lv_obj_set_size(bar, w, h);
+  lv_obj_set_style_bg_color(bar, lv_color_hex(0xFF0000), 0);
+  lv_obj_set_style_bg_opa(bar, LV_OPA_COVER, 0);
+  lv_obj_clear_flag(bar, LV_OBJ_FLAG_CLICKABLE);
+  return bar;
+}
+
+void ui_Calibration_Screen_screen_init(void) {
+  ui_Calibration_Screen = lv_obj_create(NULL);
+  lv_obj_clear_flag(ui_Calibration_Screen, LV_OBJ_FLAG_SCROLLABLE);
+
+  // Near the corners, where mis-hits cost the most
+  int32_t w = screenWidth;
+  int32_t h = screenHeight;
+  const int32_t positions[CAL_TARGETS][2] = {
+      {w / 8, h / 8}, {w * 7 / 8, h / 8}, {w / 8, h * 7 / 8},
+      {w * 7 / 8, h * 7 / 8}};
+  memcpy(targets, positions, sizeof(targets));
+  step = 0;
+
+  crossH = createBar(21, 3);
+  crossV = createBar(3, 21);
+  instructions = lv_label_create(ui_Calibration_Screen);
+  lv_obj_set_style_text_align(instructions, LV_TEXT_ALIGN_CENTER, 0);
+  lv_obj_set_align(instructions, LV_ALIGN_CENTER);
+  lv_label_set_text_static(instructions, "Touch the cross.");
+  showTarget();
+
+  // Between the lower crosshairs, clear of all four
+  cancelButton = lv_btn_create(ui_Calibration_Screen);
+  lv_obj_set_size(cancelButton, w / 2 - 20, 40);
+  lv_obj_align(cancelButton, LV_ALIGN_BOTTOM_MID, 0, -10);
+  lv_obj_add_event_cb(cancelButton, onCancelClicked, LV_EVENT_CLICKED, NULL);
+  lv_obj_t *label = lv_label_create(cancelButton);
+  lv_obj_set_align(label, LV_ALIGN_CENTER);
+  lv_label_set_text_static(label, "Cancel");
+
+  lv_obj_add_event_cb(ui_Calibration_Screen, onScreenEvent, LV_EVENT_ALL,
+                      NULL);
+}
+
+void ui_Calibration_Screen_screen_destroy(void) {
+  if (leaveTimer) lv_timer_del(leaveTimer);
+  if (ui_Calibration_Screen) lv_obj_del(ui_Calibration_Screen);
+
+  ui_Calibration_Screen = NULL;
+  crossH = NULL;
+  crossV = NULL;
+  instructions = NULL;
+  cancelButton = NULL;
+  leaveTimer = NULL;
+}
+
+static void onCalibrateClicked(lv_event_t *e) {
+  (void)e;
+  showScreen(SCREEN_CALIBRATION);
+}
+
+void attachCalibrationButton() {
+  lv_obj_t *button = lv_btn_create(ui_Container1);
+  lv_obj_set_width(button, 200);
+  lv_obj_set_height(button, 50);
+  lv_obj_set_x(button, 10);
+  lv_obj_add_flag(button, LV_OBJ_FLAG_SCROLL_ON_FOCUS);
+  lv_obj_clear_flag(button, LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_add_event_cb(button, onCalibrateClicked, LV_EVENT_CLICKED, NULL);
+
+  lv_obj_t *label = lv_label_create(button);
+  lv_obj_set_align(label, LV_ALIGN_CENTER);
+  lv_label_set_text_static(label, "Calibrate Touch");
+}
@@ -0,0 +1,44 @@
+#ifndef CALIBRATION_SCREEN_H
+#define CALIBRATION_SCREEN_H
+
+#include <lvgl.h>
+#include <stdint.h>
+
+// Touch mapping and the screen that calibrates it. The active calibration
+// (touch_calibration.h) is loaded from NVS at boot, with the old fixed raw
+// bounds as the default for boards that have not been calibrated yet.
+//
+// The calibration screen, reached from Basic Settings, asks for touches on
+// three crosshairs near the corners and a fourth one as a check. The result
+// is saved only if the check touch lands within TOUCH_CAL_VERIFY_MAX_PX of
+// its crosshair; otherwise the user starts over. The Cancel button leaves
+// the screen without changes.
+#define TOUCH_CAL_NAMESPACE "touch"
+#define TOUCH_CAL_VERSION 1
+#define TOUCH_CAL_VERIFY_MAX_PX 6
+
+extern lv_obj_t *ui_Calibration_Screen;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Loads the calibration for the display rotation and its current size.
+// Call from setup() after the rotation has been set.
+void initTouchMapping(uint8_t rotation, int32_t width, int32_t height);
+
+// Raw touch point (touch_sampler.h) to screen coordinates, loop task
+void mapTouchPoint(uint16_t rawX, uint16_t rawY, lv_point_t *point);
+
+// Screen functions for the screen manager
+void ui_Calibration_Screen_screen_init(void);
+void ui_Calibration_Screen_screen_destroy(void);
+
+// Adds the "Calibrate Touch" button; Basic Settings built callback
+void attachCalibrationButton();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALIBRATION_SCREEN_H
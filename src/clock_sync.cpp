@@ -0,0 +1,169 @@
+#include "clock_sync.h"
+#include <string.h>
+
+#define PPB 1000000000LL
+
+// i counts from the oldest entry of the ring
+static const ClockSample &recentAt(const ClockSync *sync, uint32_t i) {
+  return sync->recent[(sync->recentNext + CLOCK_SYNC_RECENT -
+                       sync->recentCount + i) %
+                      CLOCK_SYNC_RECENT];
+}
+
+static const ClockSample &oldestBucket(const ClockSync *sync) {
+  return sync->buckets[(sync->bucketNext + CLOCK_SYNC_BUCKETS -
+                        sync->bucketCount) %
+                       CLOCK_SYNC_BUCKETS];
+}
+
+static uint32_t boundAt(uint32_t errorUs, uint32_t driftErrorPpb,
+                        int64_t elapsedUs) {
+  if (elapsedUs < 0) {
+    elapsedUs = -elapsedUs;
+  }
+  int64_t bound = errorUs + elapsedUs * driftErrorPpb / PPB;
+  return bound > UINT32_MAX ? UINT32_MAX : (uint32_t)bound;
+}
+
+// The recent sample with the smallest error in [from, to)
+static const ClockSample &bestRecent(const ClockSync *sync, uint32_t from,
+                                     uint32_t to) {
+  uint32_t best = from;
+  for (uint32_t i = from + 1; i < to; i++) {
+    if (recentAt(sync, i).errorUs < recentAt(sync, best).errorUs) {
+      best = i;
+    }
+  }
+  return recentAt(sync, best);
+}
+
+static void fit(ClockSync *sync) {
+  const int64_t maxDriftPpb = CLOCK_SYNC_MAX_DRIFT_PPM * 1000LL;
+  int64_t drift = 0;
+  int64_t driftError = maxDriftPpb;
+  const ClockSample *a = NULL;
+  const ClockSample *b = NULL;
+  if (sync->bucketCount > 0 &&
+      oldestBucket(sync).localUs < recentAt(sync, 0).localUs) {
+    a = &oldestBucket(sync);
+    b = &bestRecent(sync, 0, sync->recentCount);
+  } else if (sync->recentCount >= 4) {
+    uint32_t half = sync->recentCount / 2;
+    a = &bestRecent(sync, 0, half);
+    b = &bestRecent(sync, half, sync->recentCount);
+  }
+  if (a != NULL) {
+    int64_t span = b->localUs - a->localUs;
+    if (span > 0) {
+      drift = (b->offsetUs - a->offsetUs) * PPB / span;
+      driftError = ((int64_t)a->errorUs + b->errorUs) * PPB / span;
+    }
+    // The true drift is within +-maxDriftPpb, so is the clamped estimate
+    if (drift > maxDriftPpb) {
+      drift = maxDriftPpb;
+    } else if (drift < -maxDriftPpb) {
+      drift = -maxDriftPpb;
+    }
+    if (driftError > 2 * maxDriftPpb) {
+      driftError = 2 * maxDriftPpb;
+    }
+  }
+
+  // Extrapolate from the sample that is most accurate now
+  int64_t newest = recentAt(sync, sync->recentCount - 1).localUs;
+  uint32_t base = 0;
+  uint32_t baseBound = UINT32_MAX;
+  for (uint32_t i = 0; i < sync->recentCount; i++) {
+    const ClockSample &s = recentAt(sync, i);
+    uint32_t bound =
+        boundAt(s.errorUs, (uint32_t)driftError, newest - s.localUs);
+    if (bound < baseBound) {
+      baseBound = bound;
+      base = i;
+    }
+  }
+  const ClockSample &s = recentAt(sync, base);
+  sync->baseLocalUs = s.localUs;
+  sync->baseOffsetUs = s.offsetUs;
+  sync->baseErrorUs = s.errorUs;
+  sync->driftPpb = (int32_t)drift;
+  sync->driftErrorPpb = (uint32_t)driftError;
+  sync->valid = true;
+}
+
+void clockSyncReset(ClockSync *sync) { memset(sync, 0, sizeof(*sync)); }
+
+void clockSyncAddSample(ClockSync *sync, int64_t sentUs, int64_t receivedUs,
+                        uint32_t deviceMs) {
+  if (receivedUs < sentUs) {
+    return;
+  }
+  if (sync->valid) {
+    sync->deviceMs += (int32_t)(deviceMs - sync->lastDeviceMs);
+  } else {
+    sync->deviceMs = deviceMs;
+  }
+  sync->lastDeviceMs = deviceMs;
+
+  // The device stamped somewhere between sentUs and receivedUs, and its ms
+  // clock truncates. Drift over half a round trip is at most
+  // CLOCK_SYNC_MAX_DRIFT_PPM of it.
+  int64_t halfRtt = (receivedUs - sentUs) / 2;
+  ClockSample sample;
+  sample.localUs = sentUs + halfRtt;
+  sample.offsetUs = sync->deviceMs * 1000 +
+                    CLOCK_SYNC_DEVICE_RESOLUTION_US / 2 - sample.localUs;
+  int64_t error = halfRtt + 1 + halfRtt * CLOCK_SYNC_MAX_DRIFT_PPM / 1000000 +
+                  CLOCK_SYNC_DEVICE_RESOLUTION_US / 2;
+  sample.errorUs = error > UINT32_MAX ? UINT32_MAX : (uint32_t)error;
+
+  // A sample outside the current bound means the device clock jumped (it
+  // restarted): start over from this one
+  if (sync->valid) {
+    int64_t predicted;
+    uint32_t bound;
+    clockSyncDeviceTime(sync, sample.localUs, &predicted, &bound);
+    int64_t diff = predicted - sample.localUs - sample.offsetUs;
+    if (diff < 0) {
+      diff = -diff;
+    }
+    if (diff > (int64_t)bound + sample.errorUs) {
+      sync->recentCount = 0;
+      sync->recentNext = 0;
+      sync->bucketCount = 0;
+      sync->bucketNext = 0;
+      sync->pendingCount = 0;
+      sync->steps++;
+    }
+  }
+
+  sync->recent[sync->recentNext] = sample;
+  sync->recentNext = (sync->recentNext + 1) % CLOCK_SYNC_RECENT;
+  if (sync->recentCount < CLOCK_SYNC_RECENT) {
+    sync->recentCount++;
+  }
+
+  if (sync->pendingCount == 0 || sample.errorUs < sync->pending.errorUs) {
+    sync->pending = sample;
+  }
+  if (++sync->pendingCount == CLOCK_SYNC_BUCKET_SAMPLES) {
+    sync->buckets[sync->bucketNext] = sync->pending;
+    sync->bucketNext = (sync->bucketNext + 1) % CLOCK_SYNC_BUCKETS;
+    if (sync->bucketCount < CLOCK_SYNC_BUCKETS) {
+      sync->bucketCount++;
+    }
+    sync->pendingCount = 0;
+  }
+  fit(sync);
+}
+
+bool clockSyncDeviceTime(const ClockSync *sync, int64_t localUs,
+                         int64_t *deviceUs, uint32_t *errorBoundUs) {
+  if (!sync->valid) {
+    return false;
+  }
+  int64_t elapsed = localUs - sync->baseLocalUs;
+  *deviceUs = localUs + sync->baseOffsetUs + elapsed * sync->driftPpb / PPB;
+  *errorBoundUs = boundAt(sync->baseErrorUs, sync->driftErrorPpb, elapsed);
+  return true;
+}
@@ -0,0 +1,82 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// NTP-style estimate of the scoring device's clock in terms of the local
+// one, so that the bout clock can be extrapolated locally between state
+// datagrams instead of being streamed.
+//
+// Each liveness probe is an exchange: the ping leaves at local time t1, the
+// device stamps its clock D while answering, the echo arrives at t4. The
+// device clock at the midpoint (t1 + t4) / 2 is D, give or take half the
+// round trip, however asymmetric the path. The estimator keeps
+//   - the last CLOCK_SYNC_RECENT samples, and extrapolates from the one
+//     with the smallest error at the newest point in time,
+//   - the best (lowest round trip) sample of each run of
+//     CLOCK_SYNC_BUCKET_SAMPLES for the last CLOCK_SYNC_BUCKETS runs, and
+//     takes the drift from the oldest of those to the best recent sample.
+//     Over a ms-resolution stamp and WiFi jitter, drift only shows over
+//     minutes: at one probe a second the baseline grows to about 2 min
+//     of use (liveness.h takes no samples while the radio sleeps).
+// The error bound is the extrapolated sample's half round trip plus the
+// drift uncertainty over the time since it, so the true device time lies
+// within the bound as long as the drift stays within
+// CLOCK_SYNC_MAX_DRIFT_PPM and does not change over the baseline.
+// Pure computation, no clock reads: the caller passes all timestamps.
+#define CLOCK_SYNC_RECENT 8
+#define CLOCK_SYNC_BUCKET_SAMPLES 16
+#define CLOCK_SYNC_BUCKETS 8
+#define CLOCK_SYNC_MAX_DRIFT_PPM 100 // between the two crystals
+#define CLOCK_SYNC_DEVICE_RESOLUTION_US 1000 // device stamps in ms
+
+typedef struct {
+  int64_t localUs;    // midpoint of the exchange
+  int64_t offsetUs;   // device time - local time at that point
+  uint32_t errorUs;   // half round trip plus device resolution
+} ClockSample;
+
+typedef struct {
+  // Rings, the oldest entry is at next once they are full
+  ClockSample recent[CLOCK_SYNC_RECENT];
+  uint32_t recentCount;
+  uint32_t recentNext;
+  ClockSample buckets[CLOCK_SYNC_BUCKETS]; // best of each completed run
+  uint32_t bucketCount;
+  uint32_t bucketNext;
+  ClockSample pending; // best of the current run so far
+  uint32_t pendingCount;
+  uint32_t lastDeviceMs; // for unwrapping the 32-bit device clock
+  int64_t deviceMs;
+  // Current fit
+  bool valid;
+  int64_t baseLocalUs;
+  int64_t baseOffsetUs;
+  uint32_t baseErrorUs;
+  int32_t driftPpb;      // device runs fast by this much
+  uint32_t driftErrorPpb;
+  uint32_t steps;        // device clock jumps, each restarts the window
+} ClockSync;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void clockSyncReset(ClockSync *sync);
+
+// One exchange: request sent at sentUs, answer received at receivedUs
+// (local clock), device clock deviceMs when it answered
+void clockSyncAddSample(ClockSync *sync, int64_t sentUs, int64_t receivedUs,
+                        uint32_t deviceMs);
+
+// Device time at local time localUs with its error bound, both in us.
+// Returns false before the first sample.
+bool clockSyncDeviceTime(const ClockSync *sync, int64_t localUs,
+                         int64_t *deviceUs, uint32_t *errorBoundUs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLOCK_SYNC_H
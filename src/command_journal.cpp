@@ -0,0 +1,154 @@
+#include "command_journal.h"
+#include "commands.h"
+#include "logger.h"
+#include "wifi_udp.h"
+#include <Arduino.h>
+#include <lvgl.h>
+
+struct JournalEntry {
+  uint32_t word;
+  uint32_t givenMs;
+  JournalPolicy policy;
+};
+
+// Loop task only
+static JournalEntry entries[COMMAND_JOURNAL_CAPACITY];
+static uint32_t entryCount = 0;
+static lv_obj_t *dialog = NULL;
+
+static uint32_t recordedCount = 0;
+static uint32_t replayedCount = 0;
+static uint32_t discardedStaleCount = 0;
+static uint32_t declinedCount = 0;
+static uint32_t overflowCount = 0;
+static uint32_t replayCount = 0;
+static uint32_t replayMaxAgeMs = 0;
+
+static const char *DIALOG_BUTTONS[] = {"Send all", "Skip those", ""};
+enum { DIALOG_SEND_ALL, DIALOG_SKIP };
+
+bool commandJournalActive() { return !wifiConnected || entryCount > 0; }
+
+bool journalCommand(uint32_t word) {
+  if (entryCount == COMMAND_JOURNAL_CAPACITY) {
+    overflowCount++;
+    LOG_WARN("Journal: full, 0x%08X lost\n", word);
+    return false;
+  }
+  JournalEntry &e = entries[entryCount++];
+  e.word = word;
+  e.givenMs = millis();
+  e.policy = commandJournalPolicy(word);
+  recordedCount++;
+  LOG_INFO("Journal: 0x%08X given offline, %d waiting\n", word, entryCount);
+  return true;
+}
+
+// The user's answer applies to the JOURNAL_CONFIRM commands present now
+static void resolveConfirmations(bool send) {
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < entryCount; i++) {
+    JournalEntry &e = entries[i];
+    if (e.policy == JOURNAL_CONFIRM) {
+      if (!send) {
+        declinedCount++;
+        continue;
+      }
+      e.policy = JOURNAL_REPLAY;
+    }
+    entries[kept++] = e;
+  }
+  entryCount = kept;
+}
+
+static void onDialogAnswered(lv_event_t *e) {
+  lv_obj_t *box = lv_event_get_current_target(e);
+  uint16_t button = lv_msgbox_get_active_btn(box);
+  if (button != DIALOG_SEND_ALL && button != DIALOG_SKIP) {
+    return;
+  }
+  resolveConfirmations(button == DIALOG_SEND_ALL);
+  lv_msgbox_close_async(box);
+  dialog = NULL;
+}
+
+static void openDialog(uint32_t toConfirm) {
+  static char text[120];
+  snprintf(text, sizeof(text),
+           "%u commands were given while offline. %u of them reset the "
+           "bout or move it on. Send those too?",
+           (unsigned)entryCount, (unsigned)toConfirm);
+  dialog = lv_msgbox_create(NULL, "Offline commands", text, DIALOG_BUTTONS,
+                            false);
+  lv_obj_center(dialog);
+  lv_obj_add_event_cb(dialog, onDialogAnswered, LV_EVENT_VALUE_CHANGED,
+                      NULL);
+}
+
+// Sends what the policies let through as one batch, in the order given
+static void replay() {
+  uint32_t now = millis();
+  uint32_t words[COMMAND_JOURNAL_CAPACITY];
+  bool alone[COMMAND_JOURNAL_CAPACITY];
+  uint32_t count = 0;
+  uint32_t stale = 0;
+  uint32_t maxAgeMs = 0;
+  for (uint32_t i = 0; i < entryCount; i++) {
+    const JournalEntry &e = entries[i];
+    uint32_t age = now - e.givenMs;
+    if (e.policy == JOURNAL_DISCARD_IF_STALE &&
+        age > COMMAND_JOURNAL_STALE_MS) {
+      stale++;
+      continue;
+    }
+    alone[count] = !commandBatchable(e.word);
+    words[count++] = e.word;
+    if (age > maxAgeMs) {
+      maxAgeMs = age;
+    }
+  }
+  if (count > 0 && !enqueueUDP32Batch(words, alone, count)) {
+    return; // queue busy, next loop pass
+  }
+
+  entryCount = 0;
+  discardedStaleCount += stale;
+  replayedCount += count;
+  if (count > 0) {
+    replayCount++;
+    if (maxAgeMs > replayMaxAgeMs) {
+      replayMaxAgeMs = maxAgeMs;
+    }
+  }
+  LOG_INFO("Journal: replayed %d commands, %d stale, oldest %d ms\n", count,
+           stale, maxAgeMs);
+}
+
+void serviceCommandJournal() {
+  if (entryCount == 0 || !wifiConnected || dialog != NULL) {
+    return;
+  }
+  uint32_t toConfirm = 0;
+  for (uint32_t i = 0; i < entryCount; i++) {
+    if (entries[i].policy == JOURNAL_CONFIRM) {
+      toConfirm++;
+    }
+  }
+  if (toConfirm > 0) {
+    openDialog(toConfirm);
+    return;
+  }
+  replay();
+}
+
+void getCommandJournalStats(CommandJournalStats *stats) {
+  stats->depth = entryCount;
+  stats->oldestAgeMs = entryCount ? millis() - entries[0].givenMs : 0;
+  stats->recorded = recordedCount;
+  stats->replayed = replayedCount;
+  stats->discardedStale = discardedStaleCount;
+  stats->declined = declinedCount;
+  stats->overflows = overflowCount;
+  stats->replays = replayCount;
+  stats->replayMaxAgeMs = replayMaxAgeMs;
+}
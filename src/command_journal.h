@@ -0,0 +1,59 @@
+#ifndef COMMAND_JOURNAL_H
+#define COMMAND_JOURNAL_H
+
+#include "udp_queue.h"
+#include <stdint.h>
+
+// Journal of commands given while offline. Without a WiFi link sendUDP32()
+// and friends record the command word with the time it was given instead of
+// dropping it, so a card given during a short WiFi blip still reaches the
+// scoring device. Once the link is back serviceCommandJournal() applies
+// each command's journal policy (COMMAND_TABLE in commands.h):
+//   - JOURNAL_REPLAY commands are sent,
+//   - JOURNAL_DISCARD_IF_STALE ones only if younger than
+//     COMMAND_JOURNAL_STALE_MS,
+//   - JOURNAL_CONFIRM ones only after the user agreed in a dialog.
+// The survivors go out in order as one urgent batch, which fits a single
+// datagram. Commands given while the journal is not empty are journalled
+// too, so they cannot overtake older ones.
+//
+// Everything runs on the loop task and the journal is a static array: the
+// UI thread never allocates for it (the dialog is an LVGL object, like any
+// screen).
+#define COMMAND_JOURNAL_CAPACITY UDP_MAX_FRAME_WORDS
+#define COMMAND_JOURNAL_STALE_MS 2000
+
+typedef struct {
+  uint32_t depth;          // commands waiting
+  uint32_t oldestAgeMs;    // age of the oldest waiting command
+  uint32_t recorded;       // commands journalled
+  uint32_t replayed;       // ... sent on reconnect
+  uint32_t discardedStale; // ... dropped by JOURNAL_DISCARD_IF_STALE
+  uint32_t declined;       // ... dropped because the user said no
+  uint32_t overflows;      // commands lost because the journal was full
+  uint32_t replays;        // batches sent
+  uint32_t replayMaxAgeMs; // oldest command in a batch
+} CommandJournalStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Whether new commands have to go through the journal: offline, or older
+// commands still waiting
+bool commandJournalActive();
+
+// Records a command word (loop task). Returns false if the journal is full.
+bool journalCommand(uint32_t word);
+
+// Loop task: replays the journal once the link is back, asking first if
+// needed. Call on every loop pass; it returns at once while empty.
+void serviceCommandJournal();
+
+void getCommandJournalStats(CommandJournalStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_JOURNAL_H
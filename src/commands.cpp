@@ -0,0 +1,64 @@
+#include "commands.h"
+#include "wifi_udp.h"
+
+static bool sendCommandWord(const CommandInfo &info, uint32_t word) {
+  if (word == CMD_WORD_NONE) {
+    return false;
+  }
+  // Commands that must not share a datagram go out alone; commands that
+  // must not wait for other commands skip the batching window
+  if (!info.batchable) {
+    return sendUDP32Alone(word);
+  }
+  if (info.priority == CMD_PRIORITY_HIGH) {
+    return sendUDP32Now(word);
+  }
+  return sendUDP32(word);
+}
+
+bool sendCommand(RemoteCommand cmd) {
+  if (cmd >= CMD_COUNT) {
+    return false;
+  }
+  const CommandInfo &info = commandInfo(cmd);
+  return sendCommandWord(info, info.word);
+}
+
+bool sendCommandLong(RemoteCommand cmd) {
+  if (cmd >= CMD_COUNT) {
+    return false;
+  }
+  const CommandInfo &info = commandInfo(cmd);
+  return sendCommandWord(info, info.longWord);
+}
+
+uint32_t commandWordWithArg(RemoteCommand cmd, uint8_t arg) {
+  if (cmd >= CMD_COUNT) {
+    return CMD_WORD_NONE;
+  }
+  return commandInfo(cmd).word | ((uint32_t)arg << 8);
+}
+
+// Row of the command a wire word belongs to (short, long or with argument)
+static const CommandInfo *findCommand(uint32_t word) {
+  // Words with an argument carry it in bits 8-15
+  uint32_t withoutArg = word & 0xFFFF00FF;
+  for (size_t i = 0; i < CMD_COUNT; i++) {
+    const CommandInfo &info = COMMAND_TABLE[i];
+    if (word == info.word || word == info.longWord ||
+        withoutArg == info.word) {
+      return &info;
+    }
+  }
+  return NULL;
+}
+
+JournalPolicy commandJournalPolicy(uint32_t word) {
+  const CommandInfo *info = findCommand(word);
+  return info != NULL ? info->journal : JOURNAL_REPLAY;
+}
+
+bool commandBatchable(uint32_t word) {
+  const CommandInfo *info = findCommand(word);
+  return info == NULL || info->batchable;
+}
@@ -0,0 +1,186 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Commands understood by the scoring device. The wire encoding and the
+// per-command properties live in one table (COMMAND_TABLE below) so that
+// handlers, batching, priority and metrics all look them up in one place.
+typedef enum {
+  CMD_SCORE_LEFT_PLUS,
+  CMD_SCORE_LEFT_MINUS,
+  CMD_SCORE_RIGHT_PLUS,
+  CMD_SCORE_RIGHT_MINUS,
+  CMD_START_STOP,
+  CMD_RESET,
+  CMD_NEXT_PAUSE,
+  CMD_CYCLE_WEAPON,
+  CMD_CYCLE_MATCH_TYPE,
+  CMD_CYCLE_INTENSITY,
+  CMD_YELLOW_CARD_LEFT,
+  CMD_RED_CARD_LEFT,
+  CMD_BLACK_CARD_LEFT,
+  CMD_YELLOW_CARD_RIGHT,
+  CMD_RED_CARD_RIGHT,
+  CMD_BLACK_CARD_RIGHT,
+  CMD_UW2F,
+  CMD_PRIO,
+  CMD_NEXT,
+  CMD_PREV,
+  CMD_BEGIN,
+  CMD_END,
+  CMD_SWAP,
+  CMD_RESERVE_LEFT,
+  CMD_RESERVE_RIGHT,
+  CMD_SET_MINUTES,
+  CMD_SET_SECONDS,
+  CMD_SET_HUNDREDS,
+  CMD_COUNT
+} RemoteCommand;
+
+typedef enum {
+  CMD_PRIORITY_NORMAL, // may wait for the batching window
+  CMD_PRIORITY_HIGH    // flushed to the wire immediately
+} CommandPriority;
+
+// What happens to a command given while offline, see command_journal.h
+typedef enum {
+  JOURNAL_REPLAY,           // sent on reconnect, however old
+  JOURNAL_DISCARD_IF_STALE, // dropped if older than COMMAND_JOURNAL_STALE_MS
+  JOURNAL_CONFIRM           // sent on reconnect only if the user agrees
+} JournalPolicy;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Send the short-press (regular) action of a command
+bool sendCommand(RemoteCommand cmd);
+
+// Send the long-press variant of a command
+bool sendCommandLong(RemoteCommand cmd);
+
+// Wire word of a command carrying an 8-bit argument (e.g. CMD_SET_MINUTES)
+uint32_t commandWordWithArg(RemoteCommand cmd, uint8_t arg);
+
+// Journal policy of the command a wire word belongs to (short, long or
+// with argument); JOURNAL_REPLAY for words not in the table
+JournalPolicy commandJournalPolicy(uint32_t word);
+
+// Whether the command a wire word belongs to may share a datagram; true for
+// words not in the table
+bool commandBatchable(uint32_t word);
+
+#ifdef __cplusplus
+}
+
+#define CMD_WORD_NONE 0u // no action bound
+
+struct CommandInfo {
+  RemoteCommand id;
+  uint32_t word;     ///< Short-press encoding, or CMD_WORD_NONE.
+  uint32_t longWord; ///< Long-press encoding, or CMD_WORD_NONE.
+  bool batchable;    ///< May share a datagram with other commands.
+  CommandPriority priority;
+  JournalPolicy journal; ///< Handling when given offline.
+};
+
+// Journal policies. Score and card words are relative too (one point up or
+// down, one card given or withdrawn). They are replayed however old only
+// because a journalled command never reached the device: replay applies it
+// once, as the user meant. A word that may have been delivered must not be
+// journalled, or replay would apply it twice. Time words set a value and
+// are safe either way. Toggles and cycles (start/stop, priority, weapon)
+// are stale once the user has seen them have no effect and may have given
+// them again. Commands that reset or move the bout on need confirmation.
+constexpr CommandInfo COMMAND_TABLE[] = {
+    // {id, word, longWord, batchable, priority, journal}
+    {CMD_SCORE_LEFT_PLUS, 0x06000005, 0x06000006, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_SCORE_LEFT_MINUS, 0x06000006, CMD_WORD_NONE, true,
+     CMD_PRIORITY_NORMAL, JOURNAL_REPLAY},
+    {CMD_SCORE_RIGHT_PLUS, 0x06000007, 0x06000008, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_SCORE_RIGHT_MINUS, 0x06000008, CMD_WORD_NONE, true,
+     CMD_PRIORITY_NORMAL, JOURNAL_REPLAY},
+    {CMD_START_STOP, 0x06000011, CMD_WORD_NONE, false, CMD_PRIORITY_HIGH,
+     JOURNAL_DISCARD_IF_STALE},
+    {CMD_RESET, CMD_WORD_NONE, 0x06000003, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_NEXT_PAUSE, CMD_WORD_NONE, 0x06000021, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_CYCLE_WEAPON, 0x06000012, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_DISCARD_IF_STALE},
+    {CMD_CYCLE_MATCH_TYPE, 0x0600000a, CMD_WORD_NONE, true,
+     CMD_PRIORITY_NORMAL, JOURNAL_DISCARD_IF_STALE},
+    {CMD_CYCLE_INTENSITY, 0x06000030, CMD_WORD_NONE, true,
+     CMD_PRIORITY_NORMAL, JOURNAL_DISCARD_IF_STALE},
+    {CMD_YELLOW_CARD_LEFT, 0x06000013, 0x0600ff13, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_RED_CARD_LEFT, 0x06000015, 0x0600ff15, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_BLACK_CARD_LEFT, 0x06000051, 0x0600ff51, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_YELLOW_CARD_RIGHT, 0x06000014, 0x0600ff14, true,
+     CMD_PRIORITY_NORMAL, JOURNAL_REPLAY},
+    {CMD_RED_CARD_RIGHT, 0x06000016, 0x0600ff16, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_BLACK_CARD_RIGHT, 0x06000050, 0x0600ff50, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_UW2F, 0x06000017, 0x0600ff17, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_PRIO, 0x06000010, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_DISCARD_IF_STALE},
+    {CMD_NEXT, 0x06000101, CMD_WORD_NONE, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_PREV, 0x06000102, CMD_WORD_NONE, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_BEGIN, CMD_WORD_NONE, 0x06000103, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_END, CMD_WORD_NONE, 0x06000104, false, CMD_PRIORITY_NORMAL,
+     JOURNAL_CONFIRM},
+    {CMD_SWAP, 0x0600001a, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_DISCARD_IF_STALE},
+    {CMD_RESERVE_LEFT, 0x0600001b, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_RESERVE_RIGHT, 0x0600001c, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_SET_MINUTES, 0x06000040, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_SET_SECONDS, 0x06000041, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+    {CMD_SET_HUNDREDS, 0x06000042, CMD_WORD_NONE, true, CMD_PRIORITY_NORMAL,
+     JOURNAL_REPLAY},
+};
+
+// A command word is 0x06 in the top byte, a zero third byte and a non-zero
+// command code in the low byte.
+constexpr bool isValidCommandWord(uint32_t word) {
+  return word == CMD_WORD_NONE ||
+         ((word & 0xFF000000) == 0x06000000 && (word & 0x00FF0000) == 0 &&
+          (word & 0xFF) != 0);
+}
+
+constexpr bool isValidCommandTable(size_t i = 0) {
+  return i == CMD_COUNT ||
+         (COMMAND_TABLE[i].id == (RemoteCommand)i &&
+          isValidCommandWord(COMMAND_TABLE[i].word) &&
+          isValidCommandWord(COMMAND_TABLE[i].longWord) &&
+          (COMMAND_TABLE[i].word != CMD_WORD_NONE ||
+           COMMAND_TABLE[i].longWord != CMD_WORD_NONE) &&
+          isValidCommandTable(i + 1));
+}
+
+static_assert(sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]) == CMD_COUNT,
+              "COMMAND_TABLE must have one entry per RemoteCommand");
+static_assert(isValidCommandTable(),
+              "COMMAND_TABLE entries must be in enum order with valid words");
+
+constexpr const CommandInfo &commandInfo(RemoteCommand cmd) {
+  return COMMAND_TABLE[cmd];
+}
+#endif
+
+#endif // COMMANDS_H
@@ -0,0 +1,255 @@
+#include "connectivity.h"
+#include "logger.h"
+#include "loop_scheduler.h"
+#include <Arduino.h>
+
+static const char *const STATE_NAMES[CONN_STATE_COUNT] = {
+    "idle", "associating", "got-ip", "target-reachable", "degraded", "lost"};
+
+// Events come from the WiFi event task, the UDP receive task and esp_timer
+static portMUX_TYPE connMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile ConnState state = CONN_IDLE;
+static bool hasIp = false;
+static uint32_t enteredMs = 0;
+static uint32_t timeInStateMs[CONN_STATE_COUNT];
+static uint32_t entries[CONN_STATE_COUNT];
+static uint32_t retries = 0;
+static uint8_t backoffExponent = 0;
+
+static void (*reconnectFn)(void) = NULL;
+static void (*listenerFn)(ConnState, ConnState) = NULL;
+static ConnState publishedState = CONN_IDLE;
+
+static esp_timer_handle_t graceTimer = NULL;
+static esp_timer_handle_t retryTimer = NULL;
+static bool retryIsTimeout = false; // retryTimer ends an association attempt
+// Set by retryTimer, the reconnect runs in serviceConnectivity()
+static volatile bool reconnectDue = false;
+
+// What a transition asks of the timers and the loop task. Filled in under
+// connMux and carried out by applyEffects() after it is released, since
+// esp_timer calls and task notifications must not run in a critical
+// section. The timer callbacks re-check the state, so a timer armed by a
+// transition that lost a race to a newer one does no harm.
+typedef struct {
+  bool wake; // state changed, serviceConnectivity() publishes it
+  bool startGrace;
+  bool stopGrace;
+  bool stopRetry;
+  uint32_t retryMs;       // arm retryTimer, 0: leave it alone
+  uint32_t retryJitterMs; // +/- random spread around retryMs
+} ConnEffects;
+
+static void applyEffects(const ConnEffects &fx) {
+  if (fx.stopGrace || fx.startGrace) {
+    esp_timer_stop(graceTimer);
+  }
+  if (fx.startGrace) {
+    esp_timer_start_once(graceTimer, (uint64_t)CONN_GRACE_MS * 1000);
+  }
+  if (fx.stopRetry || fx.retryMs != 0) {
+    esp_timer_stop(retryTimer);
+  }
+  if (fx.retryMs != 0) {
+    uint32_t jitter = fx.retryJitterMs;
+    uint32_t delay = fx.retryMs - jitter + esp_random() % (2 * jitter + 1);
+    esp_timer_start_once(retryTimer, (uint64_t)delay * 1000);
+  }
+  if (fx.wake) {
+    wakeLoop();
+  }
+}
+
+// Call with connMux held
+static void enterState(ConnState next, ConnEffects &fx) {
+  if (next == state) {
+    return;
+  }
+  uint32_t now = millis();
+  timeInStateMs[state] += now - enteredMs;
+  entries[next]++;
+  enteredMs = now;
+  state = next;
+  fx.wake = true;
+}
+
+static uint32_t nominalBackoffMs() {
+  uint32_t delay = CONN_BACKOFF_MIN_MS << backoffExponent;
+  return delay > CONN_BACKOFF_MAX_MS ? CONN_BACKOFF_MAX_MS : delay;
+}
+
+// Call with connMux held
+static void scheduleRetry(ConnEffects &fx) {
+  uint32_t nominal = nominalBackoffMs();
+  if (CONN_BACKOFF_MIN_MS << backoffExponent < CONN_BACKOFF_MAX_MS) {
+    backoffExponent++;
+  }
+  retryIsTimeout = false;
+  fx.retryMs = nominal;
+  fx.retryJitterMs = nominal * CONN_BACKOFF_JITTER_PERCENT / 100;
+}
+
+static void onGraceExpired(void *arg) {
+  (void)arg;
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  if (state == CONN_DEGRADED && !hasIp) {
+    enterState(CONN_LOST, fx);
+  }
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+// Either the backoff delay is over or an association attempt timed out
+static void onRetry(void *arg) {
+  (void)arg;
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  if (!hasIp && retryIsTimeout) {
+    // The driver never reported the attempt as failed; count it as one
+    if (state == CONN_ASSOCIATING) {
+      enterState(CONN_LOST, fx);
+    }
+    scheduleRetry(fx);
+  } else if (!hasIp) {
+    retries++;
+    reconnectDue = true;
+    fx.wake = true;
+  }
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+void initConnectivity(void (*reconnect)(void)) {
+  reconnectFn = reconnect;
+  enteredMs = millis();
+  entries[CONN_IDLE] = 1;
+
+  esp_timer_create_args_t args = {};
+  args.callback = onGraceExpired;
+  args.name = "conn_grace";
+  esp_timer_create(&args, &graceTimer);
+  args.callback = onRetry;
+  args.name = "conn_retry";
+  esp_timer_create(&args, &retryTimer);
+}
+
+void connOnAssociating() {
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  if (state == CONN_IDLE || state == CONN_LOST) {
+    enterState(CONN_ASSOCIATING, fx);
+  }
+  retryIsTimeout = true;
+  fx.retryMs = CONN_ASSOCIATE_TIMEOUT_MS;
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+void connOnGotIp() {
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  hasIp = true;
+  backoffExponent = 0;
+  retryIsTimeout = false;
+  fx.stopGrace = true;
+  fx.stopRetry = true;
+  enterState(CONN_GOT_IP, fx);
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+void connOnLinkDown(bool expected) {
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  bool hadIp = hasIp;
+  hasIp = false;
+  switch (state) {
+  case CONN_GOT_IP:
+  case CONN_TARGET_REACHABLE:
+  case CONN_DEGRADED:
+    if (hadIp) {
+      // Keep the UI for a short drop, reconnect right away
+      enterState(CONN_DEGRADED, fx);
+      fx.startGrace = true;
+    }
+    if (!expected) {
+      scheduleRetry(fx);
+    }
+    break;
+  case CONN_ASSOCIATING:
+  case CONN_LOST:
+    if (!expected) {
+      scheduleRetry(fx);
+    }
+    break;
+  default:
+    break;
+  }
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+void connOnTargetReachable(bool reachable) {
+  ConnEffects fx = {};
+  portENTER_CRITICAL(&connMux);
+  if (hasIp) {
+    enterState(reachable ? CONN_TARGET_REACHABLE : CONN_DEGRADED, fx);
+  }
+  portEXIT_CRITICAL(&connMux);
+  applyEffects(fx);
+}
+
+void setConnectivityListener(void (*listener)(ConnState from, ConnState to)) {
+  listenerFn = listener;
+}
+
+void serviceConnectivity() {
+  // WiFi.begin() may block, which the esp_timer task must not. The new
+  // attempt goes through connOnAssociating().
+  if (reconnectDue) {
+    reconnectDue = false;
+    if (!hasIp && reconnectFn != NULL) {
+      reconnectFn();
+    }
+  }
+
+  ConnState current = state;
+  if (current == publishedState) {
+    return;
+  }
+  ConnState previous = publishedState;
+  publishedState = current;
+  LOG_INFO("Connectivity: %s -> %s\n", STATE_NAMES[previous],
+           STATE_NAMES[current]);
+  if (listenerFn != NULL) {
+    listenerFn(previous, current);
+  }
+}
+
+ConnState connectivityState() { return state; }
+
+bool connectivityDeviceUnreachable() {
+  return state == CONN_DEGRADED && hasIp;
+}
+
+const char *connStateName(ConnState s) {
+  return s < CONN_STATE_COUNT ? STATE_NAMES[s] : "?";
+}
+
+bool connStateIsOnline(ConnState s) {
+  return s == CONN_GOT_IP || s == CONN_TARGET_REACHABLE || s == CONN_DEGRADED;
+}
+
+void getConnectivityStats(ConnStats *stats) {
+  portENTER_CRITICAL(&connMux);
+  stats->state = state;
+  for (int i = 0; i < CONN_STATE_COUNT; i++) {
+    stats->timeInStateMs[i] = timeInStateMs[i];
+    stats->entries[i] = entries[i];
+  }
+  stats->timeInStateMs[state] += millis() - enteredMs;
+  stats->retries = retries;
+  stats->nextBackoffMs = nominalBackoffMs();
+  portEXIT_CRITICAL(&connMux);
+}
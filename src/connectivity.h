@@ -0,0 +1,85 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <stdint.h>
+
+// Connectivity state machine. The WiFi event handler and the reachability
+// check feed it events from their own tasks; the UI is told about state
+// changes on the loop task through serviceConnectivity().
+//
+//   IDLE -> ASSOCIATING -> GOT_IP -> TARGET_REACHABLE
+//                            |  ^          |
+//                 link down  v  | got IP   v target unreachable
+//                          DEGRADED <------+
+//                            | no IP within CONN_GRACE_MS
+//                            v
+//                           LOST <-> ASSOCIATING (retry with backoff)
+//
+// Failed association attempts are retried after an exponential backoff with
+// random jitter, so remotes on a piste that lost its AP do not all retry in
+// the same instant. An attempt that has no IP address after
+// CONN_ASSOCIATE_TIMEOUT_MS counts as failed even if the driver never
+// reports it.
+typedef enum {
+  CONN_IDLE,
+  CONN_ASSOCIATING,
+  CONN_GOT_IP,
+  CONN_TARGET_REACHABLE,
+  CONN_DEGRADED,
+  CONN_LOST,
+  CONN_STATE_COUNT
+} ConnState;
+
+#define CONN_GRACE_MS 3000 // link down this long before the UI says so
+#define CONN_ASSOCIATE_TIMEOUT_MS 15000 // scan, association and DHCP
+#define CONN_BACKOFF_MIN_MS 500
+#define CONN_BACKOFF_MAX_MS 30000
+#define CONN_BACKOFF_JITTER_PERCENT 25 // +/- around the nominal delay
+
+typedef struct {
+  ConnState state;
+  uint32_t timeInStateMs[CONN_STATE_COUNT]; // including the current stay
+  uint32_t entries[CONN_STATE_COUNT];
+  uint32_t retries;        // reconnects started by the backoff timer
+  uint32_t nextBackoffMs;  // nominal delay before the next retry
+} ConnStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// reconnect is called when the backoff delay is over to start a new
+// association, from serviceConnectivity() on the loop task
+void initConnectivity(void (*reconnect)(void));
+
+// Inputs, from any task
+void connOnAssociating();
+void connOnGotIp();
+// expected: our own disconnect (e.g. a piste change) that is already
+// followed by a new association, so no retry is scheduled
+void connOnLinkDown(bool expected);
+void connOnTargetReachable(bool reachable);
+
+// Listener for state changes, called on the loop task only. Intermediate
+// states between two serviceConnectivity() calls are coalesced. Also runs
+// the reconnects.
+void setConnectivityListener(void (*listener)(ConnState from, ConnState to));
+void serviceConnectivity();
+
+ConnState connectivityState();
+const char *connStateName(ConnState state);
+
+// States in which the station has (or briefly lost) a connection
+bool connStateIsOnline(ConnState state);
+
+// Degraded with an IP address: the link is fine but the scoring device
+// does not answer the liveness probe
+bool connectivityDeviceUnreachable();
+
+void getConnectivityStats(ConnStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONNECTIVITY_H
@@ -0,0 +1,199 @@
+#include "cpu_power.h"
+#include "backlight.h"
+#include "logger.h"
+#include "wifi_power.h"
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <hal/gpio_ll.h>
+#include <sdkconfig.h>
+
+static const char *const MODE_NAMES[CPU_POWER_MODE_COUNT] = {
+    "active", "idle", "sleep"};
+
+static const uint32_t ESTIMATED_UA[CPU_POWER_MODE_COUNT] = {
+    CPU_POWER_ACTIVE_UA, CPU_POWER_IDLE_UA,
+    CPU_POWER_LIGHT_SLEEP_UA +
+        (CPU_POWER_IDLE_UA - CPU_POWER_LIGHT_SLEEP_UA) *
+            WIFI_POWER_BEACON_RX_MS / WIFI_POWER_DTIM_PERIOD_MS};
+
+// The mode changes on the loop task; the wake pin interrupts disarm the
+// pins and count wake-ups
+static portMUX_TYPE cpuMux = portMUX_INITIALIZER_UNLOCKED;
+static CpuPowerMode mode = CPU_POWER_ACTIVE; // booting
+static bool scalingEnabled = false;
+static bool lightSleepEnabled = false;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t maxFreqLock = NULL;
+static esp_pm_lock_handle_t noSleepLock = NULL;
+#endif
+
+static uint8_t wakePins[CPU_POWER_MAX_WAKE_PINS];
+static int wakeEdges[CPU_POWER_MAX_WAKE_PINS];
+static uint8_t wakePinCount = 0;
+static volatile bool wakeArmed = false; // pins on level wake-up
+
+static uint32_t enteredMs = 0;
+static uint32_t timeInModeMs[CPU_POWER_MODE_COUNT];
+static uint32_t pinWakeups = 0;
+
+// Level interrupts fire for as long as the pin stays low, so the pins go
+// back to their own edge interrupt on the first one. Under cpuMux.
+static void IRAM_ATTR disarmWakePins() {
+  gpio_dev_t *hw = GPIO_LL_GET_HW(GPIO_PORT_0);
+  for (uint8_t i = 0; i < wakePinCount; i++) {
+    gpio_ll_wakeup_disable(hw, (gpio_num_t)wakePins[i]);
+    gpio_ll_set_intr_type(hw, (gpio_num_t)wakePins[i],
+                          (gpio_int_type_t)wakeEdges[i]);
+  }
+  wakeArmed = false;
+}
+
+static void armWakePins() {
+  portENTER_CRITICAL(&cpuMux);
+  wakeArmed = true; // before a low pin can interrupt
+  for (uint8_t i = 0; i < wakePinCount; i++) {
+    gpio_wakeup_enable((gpio_num_t)wakePins[i], GPIO_INTR_LOW_LEVEL);
+  }
+  portEXIT_CRITICAL(&cpuMux);
+}
+
+void initCpuPower() {
+  enteredMs = millis();
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t config;
+  config.max_freq_mhz = CPU_POWER_MAX_FREQ_MHZ;
+  config.min_freq_mhz = CPU_POWER_MIN_FREQ_MHZ;
+  config.light_sleep_enable = true;
+  esp_err_t err = esp_pm_configure(&config);
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    // No tickless idle, as in the stock Arduino framework: see cpu_power.h
+    config.light_sleep_enable = false;
+    err = esp_pm_configure(&config);
+  }
+  if (err != ESP_OK ||
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cpu_active",
+                         &maxFreqLock) != ESP_OK ||
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "cpu_awake",
+                         &noSleepLock) != ESP_OK) {
+    LOG_WARN("CPU power: esp_pm not available (%d)\n", err);
+    return;
+  }
+  // Held except in the matching modes
+  esp_pm_lock_acquire(maxFreqLock);
+  esp_pm_lock_acquire(noSleepLock);
+  scalingEnabled = true;
+  lightSleepEnabled = config.light_sleep_enable;
+  if (lightSleepEnabled) {
+    esp_sleep_enable_gpio_wakeup();
+  }
+  if (lightSleepEnabled) {
+    LOG_INFO("CPU power: %d-%d MHz, light sleep on\n",
+             CPU_POWER_MIN_FREQ_MHZ, CPU_POWER_MAX_FREQ_MHZ);
+  } else {
+    LOG_WARN("CPU power: %d-%d MHz, no light sleep without tickless idle\n",
+             CPU_POWER_MIN_FREQ_MHZ, CPU_POWER_MAX_FREQ_MHZ);
+  }
+#else
+  LOG_WARN("CPU power: no power management in this build\n");
+#endif
+}
+
+void addCpuPowerWakePin(uint8_t pin, int edgeType) {
+  if (wakePinCount == CPU_POWER_MAX_WAKE_PINS) {
+    return;
+  }
+  wakePins[wakePinCount] = pin;
+  wakeEdges[wakePinCount] = edgeType;
+  wakePinCount++;
+}
+
+void IRAM_ATTR cpuPowerWakeFromISR() {
+  if (!wakeArmed) {
+    return;
+  }
+  portENTER_CRITICAL_ISR(&cpuMux);
+  if (wakeArmed) {
+    disarmWakePins();
+    pinWakeups++;
+  }
+  portEXIT_CRITICAL_ISR(&cpuMux);
+}
+
+static void setMode(CpuPowerMode next) {
+  if (next == mode) {
+    return;
+  }
+#if CONFIG_PM_ENABLE
+  if (scalingEnabled) {
+    if (next == CPU_POWER_ACTIVE) {
+      esp_pm_lock_acquire(maxFreqLock);
+    } else if (mode == CPU_POWER_ACTIVE) {
+      esp_pm_lock_release(maxFreqLock);
+    }
+    if (next == CPU_POWER_SLEEP) {
+      armWakePins();
+      esp_pm_lock_release(noSleepLock);
+    } else if (mode == CPU_POWER_SLEEP) {
+      esp_pm_lock_acquire(noSleepLock);
+    }
+  }
+#endif
+  uint32_t now = millis();
+  portENTER_CRITICAL(&cpuMux);
+  if (mode == CPU_POWER_SLEEP && wakeArmed) {
+    disarmWakePins();
+  }
+  timeInModeMs[mode] += now - enteredMs;
+  enteredMs = now;
+  mode = next;
+  portEXIT_CRITICAL(&cpuMux);
+  LOG_INFO("CPU power: %s\n", MODE_NAMES[next]);
+}
+
+void serviceCpuPower() {
+  CpuPowerMode next = CPU_POWER_IDLE;
+  if (remoteActive()) {
+    next = CPU_POWER_ACTIVE;
+  } else if (lightSleepEnabled && backlightDimmed() &&
+             (backlightLitInLightSleep() || getIdleBrightness() == 0)) {
+    next = CPU_POWER_SLEEP;
+  }
+  setMode(next);
+  if (mode == CPU_POWER_SLEEP && !wakeArmed) {
+    armWakePins(); // woken by a pin without activity, e.g. a bounce
+  }
+}
+
+void getCpuPowerStats(CpuPowerStats *stats) {
+  portENTER_CRITICAL(&cpuMux);
+  stats->mode = mode;
+  stats->pinWakeups = pinWakeups;
+  for (int i = 0; i < CPU_POWER_MODE_COUNT; i++) {
+    stats->timeInModeMs[i] = timeInModeMs[i];
+    stats->estimatedUa[i] = ESTIMATED_UA[i];
+  }
+  stats->timeInModeMs[mode] += millis() - enteredMs;
+  portEXIT_CRITICAL(&cpuMux);
+  stats->scalingEnabled = scalingEnabled;
+  stats->lightSleepEnabled = lightSleepEnabled;
+
+  uint64_t total = 0;
+  uint64_t charge = 0;
+  for (int i = 0; i < CPU_POWER_MODE_COUNT; i++) {
+    total += stats->timeInModeMs[i];
+    charge += (uint64_t)stats->timeInModeMs[i] * ESTIMATED_UA[i];
+  }
+  stats->estimatedAvgUa = total ? (uint32_t)(charge / total) : 0;
+}
+
+void resetCpuPowerStats() {
+  portENTER_CRITICAL(&cpuMux);
+  enteredMs = millis();
+  pinWakeups = 0;
+  for (int i = 0; i < CPU_POWER_MODE_COUNT; i++) {
+    timeInModeMs[i] = 0;
+  }
+  portEXIT_CRITICAL(&cpuMux);
+}
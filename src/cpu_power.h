@@ -0,0 +1,81 @@
+#ifndef CPU_POWER_H
+#define CPU_POWER_H
+
+#include <stdint.h>
+
+// CPU power governor on top of ESP-IDF power management (esp_pm). The
+// clock scales between CPU_POWER_MAX_FREQ_MHZ and CPU_POWER_MIN_FREQ_MHZ
+// and the chip may enter automatic light sleep whenever all tasks block:
+//   active  touch or button within the WiFi active window: 240 MHz held
+//   idle    nobody is using the remote: 80 MHz, light sleep not allowed
+//   sleep   backlight dimmed: automatic light sleep between deadlines
+// In light sleep the chip wakes for the next FreeRTOS timeout (the loop
+// deadline), a pen or button interrupt (wake pins, low level) and the DTIM
+// beacons, which the WiFi driver keeps receiving in modem sleep.
+//
+// Light sleep needs tickless idle (CONFIG_FREERTOS_USE_TICKLESS_IDLE),
+// which the precompiled Arduino-ESP32 framework of env:nodemcu-32s does
+// not have. There esp_pm rejects light_sleep_enable, at most the frequency
+// scales, and CPU_POWER_SLEEP is never entered: the governor stays in idle
+// and CpuPowerStats.lightSleepEnabled is false. Sleep takes a build of the
+// framework with tickless idle, e.g. Arduino as an ESP-IDF component.
+//
+// Sleep waits for the fade to idle brightness. If the backlight PWM could
+// not be put on the RTC clock it stops in light sleep, and sleep is then
+// only entered while the idle brightness is 0. The minimum frequency is
+// 80 MHz because the APB clock, and with it SPI, drops below that.
+#define CPU_POWER_MAX_FREQ_MHZ 240
+#define CPU_POWER_MIN_FREQ_MHZ 80
+#define CPU_POWER_MAX_WAKE_PINS 4
+
+// Current model for the estimate in CpuPowerStats, chip only (radio in
+// modem sleep, backlight excluded), from the ESP32 datasheet typicals.
+// In sleep the chip is awake at the minimum frequency for each beacon
+// (WIFI_POWER_BEACON_RX_MS per WIFI_POWER_DTIM_PERIOD_MS, wifi_power.h).
+#define CPU_POWER_ACTIVE_UA 50000
+#define CPU_POWER_IDLE_UA 25000
+#define CPU_POWER_LIGHT_SLEEP_UA 800
+
+typedef enum {
+  CPU_POWER_ACTIVE,
+  CPU_POWER_IDLE,
+  CPU_POWER_SLEEP,
+  CPU_POWER_MODE_COUNT
+} CpuPowerMode;
+
+typedef struct {
+  CpuPowerMode mode;
+  bool scalingEnabled;    // esp_pm configured
+  bool lightSleepEnabled; // ... with automatic light sleep
+  uint32_t timeInModeMs[CPU_POWER_MODE_COUNT]; // including the current stay
+  uint32_t pinWakeups; // wake pin interrupts while in CPU_POWER_SLEEP
+  uint32_t estimatedUa[CPU_POWER_MODE_COUNT];
+  uint32_t estimatedAvgUa;
+} CpuPowerStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configures esp_pm; falls back to frequency scaling only when the build
+// has no tickless idle. Call from setup() before the wake pins are added.
+void initCpuPower();
+
+// Registers an active-low interrupt pin that ends light sleep. edgeType is
+// the gpio_int_type_t the pin's own interrupt uses, restored on wake-up.
+void addCpuPowerWakePin(uint8_t pin, int edgeType);
+
+// Call first thing from the interrupt handler of every wake pin
+void cpuPowerWakeFromISR();
+
+// Picks the mode from remote activity and the backlight. Call from loop().
+void serviceCpuPower();
+
+void getCpuPowerStats(CpuPowerStats *stats);
+void resetCpuPowerStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPU_POWER_H
@@ -0,0 +1,262 @@
+#include "liveness.h"
+#include "SpscRing.h"
+#include "clock_sync.h"
+#include "connectivity.h"
+#include "logger.h"
+#include "reliable_udp.h"
+#include "udp_queue.h"
+#include "wifi_power.h"
+#include "wifi_udp.h"
+#include <Arduino.h>
+
+enum ProbeState : uint8_t { PROBE_FREE, PROBE_PENDING, PROBE_ECHOED, PROBE_LOST };
+
+struct Probe {
+  uint16_t seq;
+  ProbeState state;
+  uint32_t sentUs;
+  uint32_t rttUs;
+  bool radioActive; // WIFI_POWER_ACTIVE when sent
+};
+
+struct Echo {
+  uint16_t seq;
+  bool hasDeviceTime;
+  uint32_t deviceMs;
+  int64_t receivedUs;
+  bool radioActive; // WIFI_POWER_ACTIVE when received
+};
+
+// Window slots are indexed by seq; the stats reader copies them under the
+// lock, the network task holds it while updating
+static Probe window[LIVENESS_WINDOW];
+static portMUX_TYPE windowMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Echoes arrive on the UDP receive task and are consumed by the network task
+static SpscRing<Echo, 16> echoRing;
+
+// Fed by the network task, read by the loop task
+static ClockSync deviceClock;
+static portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool probing = false;
+static bool reachable = false;
+static bool reachableKnown = false;
+static uint16_t nextSeq = 0;
+static uint32_t nextPingUs = 0;
+static uint32_t periodMs = LIVENESS_PERIOD_MS;
+static uint8_t consecutiveLost = 0;
+static bool echoSeen = false; // since startProbing(): the device answers
+
+static volatile uint32_t sentCount = 0;
+static volatile uint32_t echoedCount = 0;
+static volatile uint32_t lostCount = 0;
+static volatile uint32_t clockSkippedCount = 0;
+
+static bool deadlinePassed(uint32_t deadlineUs, uint32_t now) {
+  return (int32_t)(now - deadlineUs) >= 0;
+}
+
+static void setReachable(bool value) {
+  if (reachableKnown && value == reachable) {
+    return;
+  }
+  reachable = value;
+  reachableKnown = true;
+  LOG_INFO("Liveness: scoring device %s\n",
+           value ? "reachable" : "unreachable");
+  connOnTargetReachable(value);
+}
+
+static void handleEcho(const Echo &echo) {
+  Probe &p = window[echo.seq & (LIVENESS_WINDOW - 1)];
+  if (p.seq != echo.seq || p.state != PROBE_PENDING) {
+    return; // late echo of a probe already counted as lost
+  }
+  uint32_t rttUs = (uint32_t)echo.receivedUs - p.sentUs;
+  portENTER_CRITICAL(&windowMux);
+  p.rttUs = rttUs;
+  p.state = PROBE_ECHOED;
+  portEXIT_CRITICAL(&windowMux);
+  if (echo.hasDeviceTime && p.radioActive && echo.radioActive) {
+    portENTER_CRITICAL(&clockMux);
+    clockSyncAddSample(&deviceClock, echo.receivedUs - rttUs, echo.receivedUs,
+                       echo.deviceMs);
+    portEXIT_CRITICAL(&clockMux);
+  } else if (echo.hasDeviceTime) {
+    clockSkippedCount++; // delayed to a DTIM beacon
+  }
+  echoedCount++;
+  consecutiveLost = 0;
+  echoSeen = true;
+  setReachable(true);
+}
+
+static void startProbing(uint32_t now) {
+  portENTER_CRITICAL(&windowMux);
+  memset(window, 0, sizeof(window));
+  portEXIT_CRITICAL(&windowMux);
+  // Possibly another device after a piste change
+  portENTER_CRITICAL(&clockMux);
+  clockSyncReset(&deviceClock);
+  portEXIT_CRITICAL(&clockMux);
+  Echo stale;
+  while (echoRing.pop(stale)) {
+  }
+  consecutiveLost = 0;
+  echoSeen = false;
+  reachable = false;
+  reachableKnown = false; // until the first echo or timeouts
+  nextPingUs = now;
+  periodMs = LIVENESS_PERIOD_MS;
+  probing = true;
+}
+
+uint32_t serviceLiveness() {
+  if (!wifiConnected) {
+    probing = false;
+    return LIVENESS_IDLE;
+  }
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  if (!probing) {
+    startProbing(now);
+  }
+  // Used again after backing off: probe now, which also brings the
+  // scoreboard back
+  bool active = remoteActive();
+  if (active && periodMs != LIVENESS_PERIOD_MS) {
+    periodMs = LIVENESS_PERIOD_MS;
+    nextPingUs = now;
+  }
+
+  Echo echo;
+  while (echoRing.pop(echo)) {
+    handleEcho(echo);
+  }
+
+  uint32_t nextUs = nextPingUs - now;
+  for (size_t i = 0; i < LIVENESS_WINDOW; i++) {
+    Probe &p = window[i];
+    if (p.state != PROBE_PENDING) {
+      continue;
+    }
+    uint32_t deadline = p.sentUs + LIVENESS_TIMEOUT_MS * 1000;
+    if (deadlinePassed(deadline, now)) {
+      portENTER_CRITICAL(&windowMux);
+      p.state = PROBE_LOST;
+      portEXIT_CRITICAL(&windowMux);
+      lostCount++;
+      if (++consecutiveLost >= LIVENESS_UNREACHABLE_AFTER) {
+        consecutiveLost = LIVENESS_UNREACHABLE_AFTER;
+        if (echoSeen) {
+          setReachable(false); // else older firmware, see liveness.h
+        }
+      }
+    } else if (deadline - now < nextUs) {
+      nextUs = deadline - now;
+    }
+  }
+
+  if (deadlinePassed(nextPingUs, now)) {
+    uint16_t seq = nextSeq++;
+    portENTER_CRITICAL(&windowMux);
+    Probe &p = window[seq & (LIVENESS_WINDOW - 1)];
+    p.seq = seq;
+    p.state = PROBE_PENDING;
+    p.sentUs = now;
+    p.rttUs = 0;
+    p.radioActive = wifiPowerMode() == WIFI_POWER_ACTIVE;
+    portEXIT_CRITICAL(&windowMux);
+    transmitUDP32(LIVENESS_PING_TAG | ((uint32_t)remoteUDPId() << 16) | seq);
+    sentCount++;
+    nextPingUs = now + periodMs * 1000;
+    if (!active && periodMs < LIVENESS_IDLE_PERIOD_MS) {
+      periodMs = periodMs * 2 < LIVENESS_IDLE_PERIOD_MS
+                     ? periodMs * 2
+                     : LIVENESS_IDLE_PERIOD_MS;
+    }
+    if (LIVENESS_TIMEOUT_MS * 1000 < nextUs) {
+      nextUs = LIVENESS_TIMEOUT_MS * 1000; // the new probe's deadline
+    }
+  }
+
+  return (nextUs + 999) / 1000;
+}
+
+static uint32_t readWord(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+void onLivenessEcho(const uint8_t *data, size_t length) {
+  Echo echo;
+  echo.receivedUs = esp_timer_get_time();
+  echo.radioActive = wifiPowerMode() == WIFI_POWER_ACTIVE;
+  uint32_t echoWord = readWord(data);
+  if (((echoWord >> 16) & 0xFF) != remoteUDPId()) {
+    return; // echo for another remote on the same piste
+  }
+  echo.seq = echoWord & 0xFFFF;
+  echo.hasDeviceTime = length >= 8;
+  echo.deviceMs = echo.hasDeviceTime ? readWord(data + 4) : 0;
+  if (echoRing.push(echo)) {
+    notifyUDPQueue();
+  }
+}
+
+bool livenessDeviceTime(int64_t localUs, int64_t *deviceUs,
+                        uint32_t *errorBoundUs) {
+  portENTER_CRITICAL(&clockMux);
+  bool synced =
+      clockSyncDeviceTime(&deviceClock, localUs, deviceUs, errorBoundUs);
+  portEXIT_CRITICAL(&clockMux);
+  return synced;
+}
+
+void getLivenessStats(LivenessStats *stats) {
+  Probe snapshot[LIVENESS_WINDOW];
+  portENTER_CRITICAL(&windowMux);
+  memcpy(snapshot, window, sizeof(snapshot));
+  portEXIT_CRITICAL(&windowMux);
+
+  // Insertion sort of the window RTTs, at most LIVENESS_WINDOW entries
+  uint32_t rtts[LIVENESS_WINDOW];
+  uint32_t count = 0;
+  uint32_t lost = 0;
+  for (size_t i = 0; i < LIVENESS_WINDOW; i++) {
+    if (snapshot[i].state == PROBE_LOST) {
+      lost++;
+    } else if (snapshot[i].state == PROBE_ECHOED) {
+      uint32_t rtt = snapshot[i].rttUs;
+      uint32_t j = count++;
+      while (j > 0 && rtts[j - 1] > rtt) {
+        rtts[j] = rtts[j - 1];
+        j--;
+      }
+      rtts[j] = rtt;
+    }
+  }
+
+  stats->reachable = reachable;
+  stats->sent = sentCount;
+  stats->echoed = echoedCount;
+  stats->lost = lostCount;
+  stats->windowProbes = count + lost;
+  stats->windowLost = lost;
+  stats->rttP50Us = count ? rtts[(count - 1) * 50 / 100] : 0;
+  stats->rttP90Us = count ? rtts[(count - 1) * 90 / 100] : 0;
+  stats->rttP99Us = count ? rtts[(count - 1) * 99 / 100] : 0;
+  stats->rttMaxUs = count ? rtts[count - 1] : 0;
+
+  int64_t deviceUs;
+  portENTER_CRITICAL(&clockMux);
+  stats->clockSynced = clockSyncDeviceTime(
+      &deviceClock, esp_timer_get_time(), &deviceUs, &stats->clockErrorUs);
+  stats->clockDriftPpb = deviceClock.driftPpb;
+  stats->clockSteps = deviceClock.steps;
+  portEXIT_CRITICAL(&clockMux);
+  stats->clockSkipped = clockSkippedCount;
+  if (!stats->clockSynced) {
+    stats->clockErrorUs = 0;
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Liveness probe for the scoring device. Being associated with the piste AP
+// says nothing about the scoring firmware, so the network task sends a small
+// ping on the command socket every LIVENESS_PERIOD_MS and the device echoes
+// it back. Round-trip times and losses over the last LIVENESS_WINDOW probes
+// are kept; LIVENESS_UNREACHABLE_AFTER lost probes in a row mark the device
+// unreachable, the next echo marks it reachable again. Both are reported to
+// the connectivity state machine. A device that has not echoed a single
+// probe since the association is never marked unreachable: firmware that
+// predates the probe does not answer it, and the remote must stay usable
+// with it (the state stays at got-ip).
+//
+// While the remote is idle (remoteActive() in wifi_power.h) the period
+// doubles with each probe up to LIVENESS_IDLE_PERIOD_MS, so that an unused
+// remote does not wake the radio every second. The first touch or button
+// press sends a probe at once and restores the period, which also renews
+// the scoreboard subscription (scoreboard.h).
+//
+// The echo also carries the device's ms clock, which makes each probe a
+// clock sync sample (clock_sync.h): the bout clock on the Central screen is
+// extrapolated with it between state datagrams. Only probes sent and echoed
+// with the radio out of modem sleep (WIFI_POWER_ACTIVE) are used: in modem
+// sleep the echo waits for the next DTIM beacon, which adds up to a DTIM
+// period to the round trip and inflates the error bound.
+//
+// Wire format (little-endian, like command words):
+//   ping: [PING_TAG | remoteId << 16 | seq]
+//   echo: [ECHO_TAG | remoteId << 16 | seq]  (same low 24 bits as the ping)
+//         [device clock in ms]  (optional, older firmware omits it)
+#define LIVENESS_PING_TAG 0x09000000
+#define LIVENESS_ECHO_TAG 0x0A000000
+
+#define LIVENESS_PERIOD_MS 1000
+#define LIVENESS_IDLE_PERIOD_MS 8000
+#define LIVENESS_TIMEOUT_MS 500 // a probe without echo by then is lost
+#define LIVENESS_WINDOW 32      // must be a power of two
+#define LIVENESS_UNREACHABLE_AFTER 3
+
+// Returned by serviceLiveness() while there is no link to probe over
+#define LIVENESS_IDLE UINT32_MAX
+
+typedef struct {
+  bool reachable;
+  uint32_t sent;          // probes since the last reset
+  uint32_t echoed;
+  uint32_t lost;
+  uint32_t windowProbes;  // completed probes in the window
+  uint32_t windowLost;
+  uint32_t rttP50Us;      // percentiles over the echoed probes in the window
+  uint32_t rttP90Us;
+  uint32_t rttP99Us;
+  uint32_t rttMaxUs;
+  bool clockSynced;       // echoes carried the device clock
+  uint32_t clockSkipped;  // ... but were taken in modem sleep, not used
+  int32_t clockDriftPpb;  // device clock runs fast by this much
+  uint32_t clockErrorUs;  // error bound of the device time right now
+  uint32_t clockSteps;    // device clock jumps (device restarted)
+} LivenessStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Network task: handles echoes, times out probes and sends the next one.
+// Returns the time in ms until it needs to run again.
+uint32_t serviceLiveness();
+
+// An echo datagram arrived (UDP receive task, see udp_transport.h)
+void onLivenessEcho(const uint8_t *data, size_t length);
+
+// Scoring device clock at esp_timer time localUs, in us, with its error
+// bound. False until an echo with the device clock has been seen. Any task.
+bool livenessDeviceTime(int64_t localUs, int64_t *deviceUs,
+                        uint32_t *errorBoundUs);
+
+void getLivenessStats(LivenessStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIVENESS_H
@@ -0,0 +1,226 @@
+#include "logger.h"
+#include <Arduino.h>
+#include <atomic>
+#include <stdarg.h>
+
+#ifdef LOG_HTTP_DUMP
+#include <ESPAsyncWebServer.h>
+#endif
+
+struct LogRecord {
+  const char *fmt; // doubles as the format id
+  uint32_t timestampUs;
+  uint8_t level;
+  uint8_t argc;
+  uint32_t args[LOG_MAX_ARGS];
+};
+
+// Bounded multi-producer/single-consumer ring (Vyukov). Any task or the
+// WiFi event handler may log; only the log task consumes. Producers never
+// block: a full ring drops the record.
+struct LogCell {
+  std::atomic<uint32_t> seq;
+  LogRecord record;
+};
+
+static LogCell ring[LOG_RING_CAPACITY];
+static std::atomic<uint32_t> enqueuePos(0);
+static uint32_t dequeuePos = 0;
+
+static TaskHandle_t logTaskHandle = NULL;
+// Set by the log task before it blocks on an empty ring; the producer that
+// clears it sends the wake-up, so a burst costs one notification
+static std::atomic<bool> logTaskWaiting(false);
+static std::atomic<uint32_t> writtenCount(0);
+static std::atomic<uint32_t> droppedCount(0);
+static volatile uint32_t printedCount = 0;
+
+#ifdef LOG_HTTP_DUMP
+static LogRecord history[LOG_HISTORY_RECORDS];
+static uint32_t historyCount = 0;
+static portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+#ifdef LOG_BENCH
+static volatile bool logDeferred = LOG_DEFERRED;
+void setLogDeferred(bool deferred) { logDeferred = deferred; }
+#else
+static const bool logDeferred = LOG_DEFERRED;
+#endif
+
+static const char levelChar[] = {'-', 'E', 'W', 'I', 'D'};
+
+static bool pushRecord(const LogRecord &record) {
+  uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    LogCell &cell = ring[pos & (LOG_RING_CAPACITY - 1)];
+    uint32_t seq = cell.seq.load(std::memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        cell.record = record;
+        cell.seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false; // full
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+static bool popRecord(LogRecord &record) {
+  LogCell &cell = ring[dequeuePos & (LOG_RING_CAPACITY - 1)];
+  uint32_t seq = cell.seq.load(std::memory_order_acquire);
+  if ((int32_t)(seq - (dequeuePos + 1)) < 0) {
+    return false; // empty
+  }
+  record = cell.record;
+  cell.seq.store(dequeuePos + LOG_RING_CAPACITY, std::memory_order_release);
+  dequeuePos++;
+  return true;
+}
+
+static bool ringEmpty() {
+  LogCell &cell = ring[dequeuePos & (LOG_RING_CAPACITY - 1)];
+  uint32_t seq = cell.seq.load(std::memory_order_acquire);
+  return (int32_t)(seq - (dequeuePos + 1)) < 0;
+}
+
+static size_t formatRecord(const LogRecord &record, char *buf, size_t size) {
+  int n = snprintf(buf, size, "[%lu.%03lu %c] ",
+                   (unsigned long)(record.timestampUs / 1000000),
+                   (unsigned long)(record.timestampUs / 1000 % 1000),
+                   levelChar[record.level < sizeof(levelChar) ? record.level
+                                                              : 0]);
+  if (n < 0 || (size_t)n >= size) {
+    return size - 1;
+  }
+  int m = snprintf(buf + n, size - n, record.fmt, record.args[0],
+                   record.args[1], record.args[2], record.args[3]);
+  if (m < 0) {
+    return n;
+  }
+  return (size_t)(n + m) >= size ? size - 1 : n + m;
+}
+
+static void printRecord(const LogRecord &record) {
+  char line[160];
+  size_t len = formatRecord(record, line, sizeof(line));
+  Serial.write((const uint8_t *)line, len);
+  if (len == 0 || line[len - 1] != '\n') {
+    Serial.write((const uint8_t *)"\n", 1);
+  }
+  printedCount++;
+}
+
+// Low-priority task: formats pending records and writes them to the UART
+static void logTask(void *param) {
+  (void)param;
+  LogRecord record;
+  uint32_t reportedDrops = 0;
+
+  for (;;) {
+    while (popRecord(record)) {
+      printRecord(record);
+#ifdef LOG_HTTP_DUMP
+      portENTER_CRITICAL(&historyMux);
+      history[historyCount % LOG_HISTORY_RECORDS] = record;
+      historyCount++;
+      portEXIT_CRITICAL(&historyMux);
+#endif
+    }
+
+    uint32_t drops = droppedCount.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      Serial.printf("[log] %u records dropped\n", drops - reportedDrops);
+      reportedDrops = drops;
+    }
+
+    // Announce the wait before the last look at the ring: a record pushed
+    // after that look sees the flag and notifies
+    logTaskWaiting.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ringEmpty()) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    logTaskWaiting.store(false, std::memory_order_relaxed);
+  }
+}
+
+void initLog() {
+  for (uint32_t i = 0; i < LOG_RING_CAPACITY; i++) {
+    ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  if (logTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK_SIZE, NULL,
+                            LOG_TASK_PRIORITY, &logTaskHandle, LOG_TASK_CORE);
+  }
+}
+
+void logWrite(uint8_t level, const char *fmt, uint8_t argc, ...) {
+  LogRecord record;
+  record.fmt = fmt;
+  record.timestampUs = (uint32_t)esp_timer_get_time();
+  record.level = level;
+  record.argc = argc;
+
+  va_list ap;
+  va_start(ap, argc);
+  for (uint8_t i = 0; i < LOG_MAX_ARGS; i++) {
+    record.args[i] = i < argc ? va_arg(ap, uint32_t) : 0;
+  }
+  va_end(ap);
+
+  if (!logDeferred) {
+    printRecord(record);
+    writtenCount.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (pushRecord(record)) {
+    writtenCount.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (logTaskWaiting.load(std::memory_order_relaxed) &&
+        logTaskWaiting.exchange(false) && logTaskHandle != NULL) {
+      xTaskNotifyGive(logTaskHandle);
+    }
+  } else {
+    droppedCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void getLogStats(LogStats *stats) {
+  stats->written = writtenCount.load(std::memory_order_relaxed);
+  stats->dropped = droppedCount.load(std::memory_order_relaxed);
+  stats->printed = printedCount;
+}
+
+#ifdef LOG_HTTP_DUMP
+void registerLogHttpHandler(AsyncWebServer &server) {
+  server.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+    static LogRecord snapshot[LOG_HISTORY_RECORDS];
+    uint32_t count;
+
+    portENTER_CRITICAL(&historyMux);
+    count = historyCount;
+    memcpy(snapshot, history, sizeof(snapshot));
+    portEXIT_CRITICAL(&historyMux);
+
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    uint32_t first = count > LOG_HISTORY_RECORDS ? count - LOG_HISTORY_RECORDS
+                                                 : 0;
+    char line[160];
+    for (uint32_t i = first; i < count; i++) {
+      size_t len = formatRecord(snapshot[i % LOG_HISTORY_RECORDS], line,
+                                sizeof(line));
+      response->write((const uint8_t *)line, len);
+      if (len == 0 || line[len - 1] != '\n') {
+        response->write((const uint8_t *)"\n", 1);
+      }
+    }
+    request->send(response);
+  });
+}
+#endif
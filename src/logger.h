@@ -0,0 +1,105 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+
+// Deferred, level-filtered logging.
+//
+// LOG_ERROR() .. LOG_DEBUG() store a binary record (format string pointer,
+// timestamp and up to four 32-bit arguments) in a lock-free ring. A
+// low-priority task formats the records and writes them to Serial, so the
+// caller never waits for the UART. The task sleeps while the ring is empty
+// and is notified by the record that makes it non-empty. Restrictions that
+// follow from storing arguments as raw words:
+//   - at most LOG_MAX_ARGS integer or pointer arguments, no floats
+//   - the format string and any %s argument must be string literals or
+//     otherwise outlive the record (never String::c_str())
+// Levels above LOG_LEVEL compile to nothing.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// 1: records go through the ring and the log task
+// 0: records are printed synchronously (old behaviour, for comparison)
+#ifndef LOG_DEFERRED
+#define LOG_DEFERRED 1
+#endif
+
+#define LOG_MAX_ARGS 4
+#define LOG_RING_CAPACITY 64     // must be a power of two
+#define LOG_HISTORY_RECORDS 64   // kept for the HTTP dump
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_CORE 0
+#define LOG_TASK_STACK_SIZE 3072
+
+typedef struct {
+  uint32_t written; // records accepted into the ring
+  uint32_t dropped; // records lost because the ring was full
+  uint32_t printed; // records formatted and written to Serial
+} LogStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start the log task. Call once after Serial.begin().
+void initLog();
+
+// Use the LOG_* macros instead of calling this directly
+void logWrite(uint8_t level, const char *fmt, uint8_t argc, ...);
+
+void getLogStats(LogStats *stats);
+
+#ifdef LOG_BENCH
+// Bench builds (env:log_bench) switch between the deferred and the
+// synchronous path at run time; LOG_DEFERRED is only the starting value
+void setLogDeferred(bool deferred);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+// Counts the arguments after the format string (0..4)
+#define LOG_ARGC_(_fmt, _1, _2, _3, _4, N, ...) N
+#define LOG_ARGC(...) LOG_ARGC_(__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_AT(level, fmt, ...)                                                \
+  logWrite(level, fmt, LOG_ARGC(fmt, ##__VA_ARGS__), ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) ((void)0)
+#endif
+
+#if defined(__cplusplus) && defined(LOG_HTTP_DUMP)
+class AsyncWebServer;
+// Serve the most recent records as text at /log
+void registerLogHttpHandler(AsyncWebServer &server);
+#endif
+
+#endif // LOGGER_H
@@ -0,0 +1,107 @@
+#include "loop_scheduler.h"
+#include <Arduino.h>
+
+static TaskHandle_t loopTaskHandle = NULL;
+
+// Loop task
+static int64_t tickUs = 0;  // esp_timer time up to which LVGL has ticked
+static int64_t awakeSinceUs = 0;
+static int64_t windowStartUs = 0;
+static int64_t busyUs = 0;
+static int64_t sleptUs = 0;
+static uint32_t wakeCount = 0;
+static uint32_t eventWakeCount = 0;
+static bool fastRefresh = false;
+static int64_t fastSinceUs = 0;
+static int64_t fastUs = 0;
+
+void initLoopScheduler() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  int64_t now = esp_timer_get_time();
+  tickUs = now;
+  awakeSinceUs = now;
+  windowStartUs = now;
+}
+
+void wakeLoop() {
+  if (loopTaskHandle != NULL) {
+    xTaskNotifyGive(loopTaskHandle);
+  }
+}
+
+void IRAM_ATTR wakeLoopFromISR() {
+  if (loopTaskHandle == NULL) {
+    return;
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+void updateLvglTick() {
+#if !LV_TICK_CUSTOM
+  int64_t now = esp_timer_get_time();
+  uint32_t ms = (uint32_t)((now - tickUs) / 1000);
+  if (ms > 0) {
+    lv_tick_inc(ms);
+    tickUs += (int64_t)ms * 1000; // the remainder carries over
+  }
+#endif
+}
+
+void adaptDisplayRefresh(lv_disp_t *disp, bool pressed) {
+  bool fast = pressed || lv_anim_count_running() > 0;
+  if (fast != fastRefresh) {
+    int64_t now = esp_timer_get_time();
+    if (fastRefresh) {
+      fastUs += now - fastSinceUs;
+    }
+    fastSinceUs = now;
+    fastRefresh = fast;
+    lv_timer_set_period(disp->refr_timer, fast ? LOOP_REFRESH_FAST_MS
+                                               : LOOP_REFRESH_SLOW_MS);
+  }
+  if (displayDirty(disp)) {
+    lv_timer_ready(disp->refr_timer);
+  }
+}
+
+bool displayDirty(lv_disp_t *disp) { return disp->inv_p > 0; }
+
+void loopSleep(uint32_t ms) {
+  int64_t start = esp_timer_get_time();
+  busyUs += start - awakeSinceUs;
+  TickType_t ticks = ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(ms);
+  if (ticks > 0 && ulTaskNotifyTake(pdTRUE, ticks) > 0) {
+    eventWakeCount++;
+  }
+  awakeSinceUs = esp_timer_get_time();
+  sleptUs += awakeSinceUs - start;
+  wakeCount++;
+}
+
+void getLoopStats(LoopStats *stats) {
+  int64_t now = esp_timer_get_time();
+  int64_t window = now - windowStartUs;
+  int64_t busy = busyUs + (now - awakeSinceUs);
+  int64_t fast = fastUs + (fastRefresh ? now - fastSinceUs : 0);
+  stats->windowMs = (uint32_t)(window / 1000);
+  stats->wakes = wakeCount;
+  stats->eventWakes = eventWakeCount;
+  stats->busyPermille = window > 0 ? (uint32_t)(busy * 1000 / window) : 0;
+  stats->avgSleepUs = wakeCount ? (uint32_t)(sleptUs / wakeCount) : 0;
+  stats->fastRefreshMs = (uint32_t)(fast / 1000);
+}
+
+void resetLoopStats() {
+  int64_t now = esp_timer_get_time();
+  windowStartUs = now;
+  busyUs = -(now - awakeSinceUs); // the current pass counts from here
+  sleptUs = 0;
+  wakeCount = 0;
+  eventWakeCount = 0;
+  fastUs = 0;
+  fastSinceUs = now;
+}
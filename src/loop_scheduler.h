@@ -0,0 +1,64 @@
+#ifndef LOOP_SCHEDULER_H
+#define LOOP_SCHEDULER_H
+
+#include <lvgl.h>
+#include <stdint.h>
+
+// Tickless main loop. Instead of running every 5 ms, loop() sleeps until
+// the earliest deadline of LVGL's timers and the service functions, or
+// until another task has something for it: a touch point, a state
+// datagram, a connectivity change or the button. The LVGL tick follows
+// esp_timer, so time spent in the handler or in WiFi work is not lost.
+//
+// The display refresh timer runs at LOOP_REFRESH_FAST_MS while the screen
+// is pressed or an animation runs, and at LOOP_REFRESH_SLOW_MS otherwise.
+// Invalidated areas are drawn right away in either case: the refresh timer
+// is made ready as soon as something is dirty, so the slow period only
+// stops idle screens from waking the loop.
+#define LOOP_MAX_SLEEP_MS 500 // keeps polled work (e.g. journal) going
+#define LOOP_POLL_MS 5        // button debounce, DMA completion
+#define LOOP_REFRESH_FAST_MS 15
+#define LOOP_REFRESH_SLOW_MS 250
+
+typedef struct {
+  uint32_t windowMs;      // since the last reset
+  uint32_t wakes;         // loop passes
+  uint32_t eventWakes;    // ... started by wakeLoop()
+  uint32_t busyPermille;  // share of the window the loop was awake
+  uint32_t avgSleepUs;
+  uint32_t fastRefreshMs; // time at LOOP_REFRESH_FAST_MS
+} LoopStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Call from setup(), on the loop task
+void initLoopScheduler();
+
+// Ends the loop's sleep early; from any task or from an interrupt
+void wakeLoop();
+void wakeLoopFromISR();
+
+// Advances the LVGL tick by the esp_timer time since the last call. Does
+// nothing when lv_conf.h provides LV_TICK_CUSTOM.
+void updateLvglTick();
+
+// Picks the refresh period and draws dirty areas without waiting for it.
+// Call before lv_timer_handler().
+void adaptDisplayRefresh(lv_disp_t *disp, bool pressed);
+
+// Whether lv_timer_handler() left areas to draw
+bool displayDirty(lv_disp_t *disp);
+
+// Sleeps up to ms or until wakeLoop()
+void loopSleep(uint32_t ms);
+
+void getLoopStats(LoopStats *stats);
+void resetLoopStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOOP_SCHEDULER_H
@@ -2,6 +2,7 @@
 #include "Preferences.h"
 #include <Arduino.h>
 #include <SPI.h>
+#include <driver/gpio.h>
 
 // include the installed LVGL- Light and Versatile Graphics Library -
 // https://github.com/lvgl/lvgl
@@ -11,122 +12,303 @@
 // Display - https://github.com/Bodmer/TFT_eSPI
 #include <TFT_eSPI.h>
 
-// include the installed the "XPT2046_Touchscreen" library by Paul Stoffregen to
-// use the Touchscreen - https://github.com/PaulStoffregen/XPT2046_Touchscreen
 #include "backlight.h"
+#include "boot_profile.h"
+#include "calibration_screen.h"
+#include "command_journal.h"
+#include "cpu_power.h"
+#include "connectivity.h"
+#include "logger.h"
+#include "loop_scheduler.h"
+#include "press_mode.h"
+#include "scoreboard.h"
+#include "screen_manager.h"
+#include "touch_sampler.h"
 #include "ui/ui.h"
+#include "udp_queue.h"
+#include "udp_transport.h"
+#include "wifi_power.h"
 #include "wifi_udp.h"
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <ElegantOTA.h>
-#include <XPT2046_Touchscreen.h>
 
-// Create TFT and touchscreen instances
+// Create TFT instance; the touch controller is read by touch_sampler.cpp
 TFT_eSPI tft = TFT_eSPI();
 
 // Async web server for ElegantOTA
 AsyncWebServer otaServer(80);
 
-// XPT2046 touch pins (your existing settings)
-#define XPT2046_IRQ 36
-#define XPT2046_MOSI 32
-#define XPT2046_MISO 39
-#define XPT2046_CLK 25
-#define XPT2046_CS 33
-
-SPIClass touchscreenSPI = SPIClass(VSPI);
-XPT2046_Touchscreen touchscreen(XPT2046_CS, XPT2046_IRQ);
-
 // Screen management for WiFi connection handling
-static lv_obj_t *lastActiveScreen =
-    NULL; // Store last active screen before No_Connection_Screen
-static bool wasConnected = false; // Track previous connection state
+static ScreenId lastActiveScreen =
+    SCREEN_CENTRAL; // Store last active screen before No_Connection_Screen
+
+// Piste shown on the Central and Specific Settings screens. Kept here
+// because those screens may be destroyed and rebuilt at any time.
+static char pisteLabel[32] = "";
+static char pisteNumberText[4] = "001";
 
 // Declare custom omega font
 LV_FONT_DECLARE(omega_font_14);
 
-// LVGL draw buffer - 1/10 screen (optimal for ESP32 RAM constraints)
-#define DRAW_BUF_PIXELS (320 * 240 / 10)
+// LVGL draw buffers - 1/10 screen each by default (optimal for ESP32 RAM
+// constraints). With two buffers and DMA, LVGL renders the next stripe into
+// one buffer while the other is still being shifted out over SPI.
+#ifndef DISP_BUF_COUNT
+#define DISP_BUF_COUNT 2 // 1 or 2
+#endif
+#ifndef DISP_BUF_DIVISOR
+#define DISP_BUF_DIVISOR 10 // each buffer holds 1/DISP_BUF_DIVISOR screen
+#endif
+#ifndef DISP_USE_DMA
+#define DISP_USE_DMA 1
+#endif
+#define DRAW_BUF_PIXELS (320 * 240 / DISP_BUF_DIVISOR)
 static lv_color_t draw_buf_1[DRAW_BUF_PIXELS];
+#if DISP_BUF_COUNT > 1
+static lv_color_t draw_buf_2[DRAW_BUF_PIXELS];
+#endif
 static lv_disp_draw_buf_t disp_draw_buf;
-
-// Calibration constants from your run
-const int TS_MIN_X = 521;
-const int TS_MAX_X = 3540;
-const int TS_MIN_Y = 379;
-const int TS_MAX_Y = 3624;
+static lv_indev_drv_t indev_drv;
+static bool touchDown = false; // as last reported to LVGL
+
+// Display timing, reported every DISP_STATS_PERIOD_MS
+#define DISP_STATS_PERIOD_MS 10000
+static uint32_t dispFrames = 0;
+static uint32_t dispFrameTimeSumMs = 0;
+static uint32_t dispFrameTimeMaxMs = 0;
+static uint32_t dispPixels = 0;
+static uint32_t dispFlushes = 0;
+static uint32_t dispFlushWaitSumUs = 0; // CPU time spent waiting for SPI
+static uint32_t dispFlushWaitMaxUs = 0;
+static unsigned long lastDispStatsReport = 0;
 
 // Current TFT rotation (0=portrait, 1=landscape, 2=portrait_inverted,
 // 3=landscape_inverted)
 static int tft_rotation = 0;
 
+#if DISP_USE_DMA
+static volatile bool dmaFlushPending = false;
+
+// LVGL v8 display flush: start a DMA transfer and return immediately.
+// lv_disp_flush_ready() is called from pollDisplayFlush() once the
+// transfer has completed.
+static void my_disp_flush(lv_disp_drv_t *drv, const lv_area_t *area,
+                          lv_color_t *color_p) {
+  int32_t w = (area->x2 - area->x1 + 1);
+  int32_t h = (area->y2 - area->y1 + 1);
+
+  tft.dmaWait(); // previous transfer must be finished before re-addressing
+  tft.setAddrWindow(area->x1, area->y1, w, h);
+  tft.pushPixelsDMA((uint16_t *)color_p, w * h);
+  dmaFlushPending = true;
+  dispFlushes++;
+}
+
+// Signal DMA completion to LVGL
+static void pollDisplayFlush(lv_disp_drv_t *drv) {
+  if (dmaFlushPending && !tft.dmaBusy()) {
+    dmaFlushPending = false;
+    lv_disp_flush_ready(drv);
+  }
+}
+
+// Called by LVGL while it has to wait for a buffer to come back
+static void my_disp_wait(lv_disp_drv_t *drv) {
+  uint32_t start = micros();
+  while (dmaFlushPending && tft.dmaBusy()) {
+  }
+  pollDisplayFlush(drv);
+  uint32_t waited = micros() - start;
+  dispFlushWaitSumUs += waited;
+  if (waited > dispFlushWaitMaxUs) {
+    dispFlushWaitMaxUs = waited;
+  }
+}
+#else
 // LVGL v8 display flush: push pixels to TFT_eSPI
 static void my_disp_flush(lv_disp_drv_t *drv, const lv_area_t *area,
                           lv_color_t *color_p) {
   int32_t w = (area->x2 - area->x1 + 1);
   int32_t h = (area->y2 - area->y1 + 1);
 
+  uint32_t start = micros();
   tft.startWrite();
   tft.setAddrWindow(area->x1, area->y1, w, h);
   tft.pushColors((uint16_t *)color_p, w * h, true);
   tft.endWrite();
+  uint32_t waited = micros() - start;
+  dispFlushWaitSumUs += waited;
+  if (waited > dispFlushWaitMaxUs) {
+    dispFlushWaitMaxUs = waited;
+  }
+  dispFlushes++;
 
   lv_disp_flush_ready(drv);
 }
+#endif
 
-// Touch read callback using the calibrated mapping
+// Called by LVGL after every refresh with its duration and pixel count
+static void my_disp_monitor(lv_disp_drv_t *drv, uint32_t time_ms,
+                            uint32_t px) {
+  (void)drv;
+  dispFrames++;
+  dispFrameTimeSumMs += time_ms;
+  if (time_ms > dispFrameTimeMaxMs) {
+    dispFrameTimeMaxMs = time_ms;
+  }
+  dispPixels += px;
+}
+
+static void reportDisplayStats() {
+  unsigned long now = millis();
+  if (now - lastDispStatsReport < DISP_STATS_PERIOD_MS) {
+    return;
+  }
+  lastDispStatsReport = now;
+  LoopStats loopStats;
+  getLoopStats(&loopStats);
+  LOG_INFO("Loop: %u wakes (%u by events), busy %u permille, sleep avg %u us\n",
+           loopStats.wakes, loopStats.eventWakes, loopStats.busyPermille,
+           loopStats.avgSleepUs);
+  resetLoopStats();
+  CpuPowerStats cpuStats;
+  getCpuPowerStats(&cpuStats);
+  LOG_INFO("CPU: %u s active, %u s idle, %u s sleep, est %u uA\n",
+           cpuStats.timeInModeMs[CPU_POWER_ACTIVE] / 1000,
+           cpuStats.timeInModeMs[CPU_POWER_IDLE] / 1000,
+           cpuStats.timeInModeMs[CPU_POWER_SLEEP] / 1000,
+           cpuStats.estimatedAvgUa);
+  if (dispFrames == 0) {
+    return;
+  }
+  LOG_INFO("Display: %u frames, avg %u ms, max %u ms, %u px\n", dispFrames,
+           dispFrameTimeSumMs / dispFrames, dispFrameTimeMaxMs, dispPixels);
+  LOG_INFO("Display: %u flushes, wait avg %u us, max %u us\n", dispFlushes,
+           dispFlushes ? dispFlushWaitSumUs / dispFlushes : 0,
+           dispFlushWaitMaxUs);
+  dispFrames = 0;
+  dispFrameTimeSumMs = 0;
+  dispFrameTimeMaxMs = 0;
+  dispPixels = 0;
+  dispFlushes = 0;
+  dispFlushWaitSumUs = 0;
+  dispFlushWaitMaxUs = 0;
+}
+
+// Touch read callback: drains the points queued by the touch sampler. Each
+// press and release reaches LVGL, even if several arrived since the last
+// read; without new points the last state holds.
 static void touchscreen_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
   (void)drv;
-  // Only check touch if IRQ is triggered - avoids constant polling
-  if (touchscreen.tirqTouched() && touchscreen.touched()) {
-    TS_Point p = touchscreen.getPoint();
+  static lv_point_t lastPoint = {0, 0};
+  TouchPoint p;
+  bool more = false;
+
+  if (popTouchPoint(&p, &more)) {
+    if (p.pressed) {
+      // Wake the radio while the finger is still down, so that it is out of
+      // modem sleep by the time the command goes out on release
+      if (!touchDown) {
+        wifiPowerOnPress();
+      }
+      mapTouchPoint(p.x, p.y, &lastPoint);
+    }
+    touchDown = p.pressed;
+    data->continue_reading = more;
+  }
 
+  if (touchDown) {
     // Wake up backlight on any touch detection
     resetBacklightTimer();
+    wifiPowerOnActivity();
+  }
+  data->state = touchDown ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+  data->point = lastPoint;
+}
+int PisteNr = 1;
 
-    int screen_w = tft.width();
-    int screen_h = tft.height();
-
-    int x, y;
-
-    // Map touch coordinates based on display rotation
-    if (tft_rotation == 0) {
-      // Portrait mode (240x320)
-      x = map(p.x, TS_MIN_X, TS_MAX_X, 0, screen_w - 1);
-      y = map(p.y, TS_MIN_Y, TS_MAX_Y, 0, screen_h - 1);
-    } else if (tft_rotation == 1) {
-      // Landscape mode (320x240)
-      x = map(p.y, TS_MIN_Y, TS_MAX_Y, 0, screen_w - 1);
-      y = map(p.x, TS_MIN_X, TS_MAX_X, 0, screen_h - 1);
-      y = (screen_h - 1) - y;
-    } else if (tft_rotation == 2) {
-      // Portrait inverted mode (240x320)
-      x = map(p.x, TS_MIN_X, TS_MAX_X, screen_w - 1, 0);
-      y = map(p.y, TS_MIN_Y, TS_MAX_Y, screen_h - 1, 0);
-    } else { // tft_rotation == 3
-      // Landscape inverted mode (320x240)
-      x = map(p.y, TS_MIN_Y, TS_MAX_Y, screen_w - 1, 0);
-      y = map(p.x, TS_MIN_X, TS_MAX_X, screen_h - 1, 0);
-      y = (screen_h - 1) - y;
-    }
+static void restorePisteLabel() {
+  lv_label_set_text(ui_LabelPisteID, pisteLabel);
+}
+
+static void restoreCentral() {
+  restorePisteLabel();
+  attachScoreboard();
+  attachPressModes();
+}
+
+static void restorePisteNumber() {
+  lv_textarea_set_text(ui_TextAreaPisteNr, pisteNumberText);
+}
+
+// Text on the No_Connection screen; the generated default covers the case
+// where there is no WiFi link
+static const char *NO_LINK_TEXT = "Waiting for scoring device";
+static const char *DEVICE_UNREACHABLE_TEXT = "Scoring device not responding";
+static const char *connectionText = NO_LINK_TEXT;
+static bool uiOnline = false;
 
-    // Clamp safety
-    x = constrain(x, 0, screen_w - 1);
-    y = constrain(y, 0, screen_h - 1);
+static void restoreConnectionText() {
+  lv_label_set_text_static(ui_Label11, connectionText);
+}
+
+// Connectivity transitions, on the loop task: switch to No_Connection when
+// the connection is lost or the scoring device stops answering, and back to
+// the previous screen when it returns
+static void onConnectivityChanged(ConnState from, ConnState to) {
+  (void)from;
+  bool unreachable = connectivityDeviceUnreachable();
+  bool online = connStateIsOnline(to) && !unreachable;
+
+  connectionText = unreachable ? DEVICE_UNREACHABLE_TEXT : NO_LINK_TEXT;
+  if (ui_Label11 != NULL) {
+    restoreConnectionText();
+  }
 
-    data->state = LV_INDEV_STATE_PRESSED;
-    data->point.x = x;
-    data->point.y = y;
+  if (online == uiOnline) {
+    return;
+  }
+  uiOnline = online;
+  if (online) {
+    // Reconnected - restore last active screen (or Central if none)
+    if (!screenRestoresOnReconnect(lastActiveScreen)) {
+      lastActiveScreen = SCREEN_CENTRAL;
+    }
+    showScreen(lastActiveScreen);
+    if (lastActiveScreen == SCREEN_CENTRAL) {
+      bootMarkCentral(); // the remote is usable, first time only
+    }
   } else {
-    data->state = LV_INDEV_STATE_RELEASED;
+    ScreenId currentScreen = activeScreenId();
+    if (currentScreen != SCREEN_NO_CONNECTION) {
+      lastActiveScreen = currentScreen;
+      showScreen(SCREEN_NO_CONNECTION);
+    }
+  }
+}
+
+// Called by OnPisteIDChanged() when the user enters a new piste number
+extern "C" void setPisteNumberText(const char *number) {
+  snprintf(pisteNumberText, sizeof(pisteNumberText), "%s", number);
+  snprintf(pisteLabel, sizeof(pisteLabel), "Piste %s", number);
+  if (ui_LabelPisteID != NULL) {
+    restorePisteLabel();
   }
 }
-int PisteNr = 1;
 
 #define RGB_PIN_RED 4
 #define RGB_PIN_GREEN 16
 #define RGB_PIN_BLUE 17
+#define BUTTON_PIN 27
 ESP32Button *button;
+
+// Ends the loop's sleep so that doUpdate() sees the edge
+static void IRAM_ATTR onButtonEdge() {
+  cpuPowerWakeFromISR();
+  wakeLoopFromISR();
+}
+
 void setup() {
   pinMode(RGB_PIN_GREEN, OUTPUT);
   digitalWrite(RGB_PIN_GREEN, HIGH); // stop random latch
@@ -134,10 +316,45 @@ void setup() {
   digitalWrite(RGB_PIN_RED, HIGH); // stop random latch
   pinMode(RGB_PIN_BLUE, OUTPUT);
   digitalWrite(RGB_PIN_BLUE, HIGH); // stop random latch
-  button = ESP32Button::getInstance(27, true, 40);
+  button = ESP32Button::getInstance(BUTTON_PIN, true, 40);
   button->begin();
+  initLoopScheduler();
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+  addCpuPowerWakePin(BUTTON_PIN, GPIO_INTR_ANYEDGE);
   // Initialize serial communication
   Serial.begin(115200);
+  initLog();
+  initCpuPower(); // 240 MHz until the UI is up and idle
+  bootMark("serial");
+
+  // Start WiFi first: association and DHCP take far longer than anything
+  // else here and proceed in the background while the UI is built.
+  // The stored piste is read once and shared with the UI.
+  Preferences networkpreferences;
+  networkpreferences.begin("network", true);
+  String storedSSID;
+  storedSSID = networkpreferences.getString("Piste", WIFI_SSID);
+  networkpreferences.end();
+  bootMark("nvs");
+
+  initWiFi(storedSSID.c_str());
+  bootMark("wifi started");
+
+  // Commands from the UI are sent by a network task on core 0
+  startUDPQueue();
+
+  // Extract 3-digit number after "Piste_"
+  int pisteIndex = storedSSID.indexOf("Piste_");
+  if (pisteIndex != -1) {
+    // Extract 3 digits after "Piste_"
+    String pisteNumber = storedSSID.substring(pisteIndex + 6, pisteIndex + 9);
+    snprintf(pisteNumberText, sizeof(pisteNumberText), "%s",
+             pisteNumber.c_str());
+    snprintf(pisteLabel, sizeof(pisteLabel), "Piste %s", pisteNumber.c_str());
+    PisteNr = pisteNumber.toInt();
+  } else {
+    snprintf(pisteLabel, sizeof(pisteLabel), "%s", storedSSID.c_str());
+  }
 
   // Initialize LVGL on Core 1 (default core for Arduino setup/loop)
   lv_init();
@@ -146,126 +363,145 @@ void setup() {
   tft.init();
   tft.setRotation(tft_rotation); // forced to 0
   tft.setSwapBytes(true);        // adjust if colors are wrong
-
-  // Init touchscreen
-  touchscreenSPI.begin(XPT2046_CLK, XPT2046_MISO, XPT2046_MOSI, XPT2046_CS);
-  touchscreen.begin(touchscreenSPI);
-  // Keep touchscreen.setRotation(0) so we get raw values and map them ourselves
-  touchscreen.setRotation(0);
-
-  // Initialize LVGL draw buffer (v8 API)
+  initTouchMapping(tft_rotation, tft.width(), tft.height());
+#if DISP_USE_DMA
+  tft.initDMA();
+  tft.startWrite(); // the display has its own SPI bus, keep CS asserted
+#endif
+  bootMark("tft");
+
+  // Touch controller: sampled by its own task, woken by the pen interrupt
+  startTouchSampler();
+  bootMark("touch");
+
+  // Initialize LVGL draw buffers (v8 API)
+#if DISP_BUF_COUNT > 1
+  lv_disp_draw_buf_init(&disp_draw_buf, draw_buf_1, draw_buf_2,
+                        DRAW_BUF_PIXELS);
+#else
   lv_disp_draw_buf_init(&disp_draw_buf, draw_buf_1, NULL, DRAW_BUF_PIXELS);
+#endif
 
   static lv_disp_drv_t disp_drv;
   lv_disp_drv_init(&disp_drv);
   disp_drv.hor_res = tft.width();
   disp_drv.ver_res = tft.height();
   disp_drv.flush_cb = my_disp_flush;
+#if DISP_USE_DMA
+  disp_drv.wait_cb = my_disp_wait;
+#endif
+  disp_drv.monitor_cb = my_disp_monitor;
   disp_drv.draw_buf = &disp_draw_buf;
   lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
 
   // Register input device (v8 API)
-  static lv_indev_drv_t indev_drv;
   lv_indev_drv_init(&indev_drv);
   indev_drv.type = LV_INDEV_TYPE_POINTER;
   indev_drv.read_cb = touchscreen_read;
   lv_indev_drv_register(&indev_drv);
+  lv_timer_pause(indev_drv.read_timer); // resumed by the first touch point
 
   // Add global touch event handler on top layer to catch all touches
   lv_obj_add_event_cb(lv_layer_top(), onTouchEvent, LV_EVENT_PRESSED, NULL);
+  bootMark("lvgl drivers");
+
+  // Initialize the SquareLine UI; screens are built on first use
+  initScreens();
+  setScreenBuiltCallback(SCREEN_CENTRAL, restoreCentral);
+  setScreenBuiltCallback(SCREEN_BASIC_SETTINGS, attachCalibrationButton);
+  setScreenBuiltCallback(SCREEN_SPECIFIC_SETTINGS, restorePisteNumber);
+  setScreenBuiltCallback(SCREEN_NO_CONNECTION, restoreConnectionText);
+  setScreenBuiltCallback(SCREEN_CARDS, attachPressModes);
+  setScreenBuiltCallback(SCREEN_CYRANO, attachPressModes);
+
+  // Start on No_Connection. WiFi is usually still associating at this
+  // point; the connectivity listener switches to Central once it is online.
+  showScreen(SCREEN_NO_CONNECTION);
+  setConnectivityListener(onConnectivityChanged);
+  bootMark("first screen");
 
-  // Initialize the SquareLine UI (ui_init() from generated files)
-  ui_init();
-  Preferences networkpreferences;
-  networkpreferences.begin("network");
-  String storedSSID;
-  storedSSID = networkpreferences.getString("Piste", WIFI_SSID);
-  networkpreferences.end();
-
-  // Extract 3-digit number after "Piste_"
-  int pisteIndex = storedSSID.indexOf("Piste_");
-  if (pisteIndex != -1) {
-    // Extract 3 digits after "Piste_"
-    String pisteNumber = storedSSID.substring(pisteIndex + 6, pisteIndex + 9);
-    lv_textarea_set_text(ui_TextAreaPisteNr, pisteNumber.c_str());
-    lv_label_set_text_fmt(ui_LabelPisteID, "Piste %s", pisteNumber.c_str());
-    PisteNr = pisteNumber.toInt();
-  } else {
-    lv_label_set_text_fmt(ui_LabelPisteID, storedSSID.c_str());
-    lv_textarea_set_text(ui_TextAreaPisteNr, "001");
-  }
-
-  // Initialize WiFi connection
-  initWiFi();
+  initBacklight();
+  bootMark("backlight");
 
   // Start ElegantOTA (Async) - provides a web UI for OTA updates
   ElegantOTA.begin(&otaServer); // Start ElegantOTA
+#ifdef LOG_HTTP_DUMP
+  registerLogHttpHandler(otaServer); // recent log records at /log
+#endif
   otaServer.begin();
   Serial.println("ElegantOTA: HTTP OTA available (open /update on device IP)");
-
-  // Load appropriate screen based on WiFi state
-  if (wifiConnected) {
-    _ui_screen_change(&ui_Central_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                      ui_Central_Screen_screen_init);
-    lastActiveScreen = ui_Central_Screen;
-    wasConnected = true;
-  } else {
-    _ui_screen_change(&ui_No_Connection_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                      ui_No_Connection_Screen_screen_init);
-    wasConnected = false;
-  }
-
-  initBacklight();
+  bootMark("ota");
 }
 
 void loop() {
+  updateLvglTick();
+  uint32_t sleepMs = LOOP_MAX_SLEEP_MS;
+
   // Update backlight timer (check for inactivity timeout)
-  updateBacklightTimer();
+  sleepMs = min(sleepMs, updateBacklightTimer());
   button->doUpdate();
   if (button->stateHasChanged()) {
     if (button->isPressed()) {
+      wifiPowerOnPress();
       OnStartStopClicked(NULL);
     }
   }
-  // Handle screen switching based on WiFi state
-  if (wifiConnected && !wasConnected) {
-    // WiFi reconnected - restore last active screen (or Central if none)
-    if (lastActiveScreen == ui_Central_Screen) {
-      _ui_screen_change(&ui_Central_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                        ui_Central_Screen_screen_init);
-    } else if (lastActiveScreen == ui_Basic_Settings_Screen) {
-      _ui_screen_change(&ui_Basic_Settings_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                        ui_Basic_Settings_Screen_screen_init);
-    } else if (lastActiveScreen == ui_Cards_Screen) {
-      _ui_screen_change(&ui_Cards_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                        ui_Cards_Screen_screen_init);
-    } else {
-      // Default to Central Screen if no valid last screen
-      _ui_screen_change(&ui_Central_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                        ui_Central_Screen_screen_init);
-      lastActiveScreen = ui_Central_Screen;
-    }
-    wasConnected = true;
-  } else if (!wifiConnected && wasConnected) {
-    // WiFi disconnected - switch to No Connection screen
-    lv_obj_t *currentScreen = lv_scr_act();
-    if (currentScreen != ui_No_Connection_Screen) {
-      lastActiveScreen = currentScreen;
-      _ui_screen_change(&ui_No_Connection_Screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
-                        ui_No_Connection_Screen_screen_init);
-    }
-    wasConnected = false;
+  if (digitalRead(BUTTON_PIN) != button->currentState()) {
+    sleepMs = min(sleepMs, (uint32_t)LOOP_POLL_MS); // still debouncing
   }
-
-  // Update lastActiveScreen when user navigates while connected
-  if (wifiConnected) {
-    lv_obj_t *currentScreen = lv_scr_act();
-    if (currentScreen != ui_No_Connection_Screen) {
-      lastActiveScreen = currentScreen;
-    }
+  // Full connect after a failed fast connect
+  serviceWiFiConnect();
+  // Screen switching on connection loss / recovery
+  serviceConnectivity();
+
+  // Commands given while offline go out once the link is back
+  serviceCommandJournal();
+
+  // Back to modem sleep once the remote has been idle for the active window
+  sleepMs = min(sleepMs, serviceWiFiPower());
+#ifdef UDP_BENCH
+  serviceUDPBench(); // once, after the first IP address
+#endif
+#ifdef LOG_BENCH
+  serviceLogBench(); // once, after the first IP address
+#endif
+
+  // Mirror the scoring device's state on the Central screen
+  sleepMs = min(sleepMs, serviceScoreboard());
+
+  // Track navigation and free cold screens if the LVGL heap runs low
+  serviceScreens();
+
+#if DISP_USE_DMA
+  pollDisplayFlush(lv_disp_get_default()->driver);
+#endif
+  reportDisplayStats();
+
+  // A touch queued by the sampler is read now, not at the next read
+  // period. Between touches the read timer is paused, so that an untouched
+  // screen does not wake the loop.
+  if (touchPointPending()) {
+    lv_timer_resume(indev_drv.read_timer);
+    lv_timer_ready(indev_drv.read_timer);
   }
+  adaptDisplayRefresh(lv_disp_get_default(), touchDown);
 
-  lv_task_handler(); // let the GUI do its work
-  lv_tick_inc(5);    // tell LVGL how much time has passed
-  delay(5);          // let this time pass
-}
\ No newline at end of file
+  sleepMs = min(sleepMs, lv_timer_handler()); // let the GUI do its work
+  if (dispFrames > 0) {
+    bootReport(); // first frame is on the glass, once only
+  }
+  // Clock and light sleep follow the touch just read
+  serviceCpuPower();
+  if (!touchDown && !touchPointPending()) {
+    lv_timer_pause(indev_drv.read_timer);
+  }
+  if (displayDirty(lv_disp_get_default())) {
+    sleepMs = 0; // drawing was cut short, e.g. by an invalidation
+  }
+#if DISP_USE_DMA
+  if (dmaFlushPending) {
+    sleepMs = min(sleepMs, (uint32_t)LOOP_POLL_MS); // hand the buffer back
+  }
+#endif
+  loopSleep(sleepMs);
+}
@@ -0,0 +1,236 @@
+#include "press_mode.h"
+#include "command_journal.h"
+#include "commands.h"
+#include "ui/ui.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+struct StoredModes {
+  uint32_t version;
+  uint8_t modes[PRESS_BUTTON_COUNT];
+};
+
+struct PressBinding {
+  lv_obj_t **button;
+  lv_event_cb_t generated;
+  lv_event_code_t releaseEvent; // the one the generated handler sends on
+  RemoteCommand cmd;
+};
+
+static const PressBinding BINDINGS[PRESS_BUTTON_COUNT] = {
+    {&ui_ButtonLeftScorePlus, ui_event_ButtonLeftScorePlus,
+     LV_EVENT_SHORT_CLICKED, CMD_SCORE_LEFT_PLUS},
+    {&ui_ButtonRightScorePlus, ui_event_ButtonRightScorePlus,
+     LV_EVENT_SHORT_CLICKED, CMD_SCORE_RIGHT_PLUS},
+    {&ui_ButtonStartStop, ui_event_ButtonStartStop, LV_EVENT_CLICKED,
+     CMD_START_STOP},
+    {&ui_ButtonYLeft, ui_event_ButtonYLeft, LV_EVENT_SHORT_CLICKED,
+     CMD_YELLOW_CARD_LEFT},
+    {&ui_ButtonRLeft, ui_event_ButtonRLeft, LV_EVENT_SHORT_CLICKED,
+     CMD_RED_CARD_LEFT},
+    {&ui_ButtonBLeft, ui_event_ButtonBLeft, LV_EVENT_SHORT_CLICKED,
+     CMD_BLACK_CARD_LEFT},
+    {&ui_ButtonYRight, ui_event_ButtonYRight, LV_EVENT_SHORT_CLICKED,
+     CMD_YELLOW_CARD_RIGHT},
+    {&ui_ButtonRRight, ui_event_ButtonRRight, LV_EVENT_SHORT_CLICKED,
+     CMD_RED_CARD_RIGHT},
+    {&ui_ButtonBRight, ui_event_ButtonBRight, LV_EVENT_SHORT_CLICKED,
+     CMD_BLACK_CARD_RIGHT},
+    {&ui_ButtonUW2F, ui_event_ButtonUW2F, LV_EVENT_SHORT_CLICKED, CMD_UW2F},
+    {&ui_ButtonPRIO, ui_event_ButtonPRIO, LV_EVENT_SHORT_CLICKED, CMD_PRIO},
+    {&ui_ButtonNext, ui_event_ButtonNext, LV_EVENT_SHORT_CLICKED, CMD_NEXT},
+    {&ui_ButtonPrev, ui_event_ButtonPrev, LV_EVENT_SHORT_CLICKED, CMD_PREV},
+    {&ui_ButtonSwap, ui_event_ButtonSwap, LV_EVENT_SHORT_CLICKED, CMD_SWAP},
+    {&ui_ButtonSwapResLeft, ui_event_ButtonSwapResLeft,
+     LV_EVENT_SHORT_CLICKED, CMD_RESERVE_LEFT},
+    {&ui_ButtonSwapResRight, ui_event_ButtonSwapResRight,
+     LV_EVENT_SHORT_CLICKED, CMD_RESERVE_RIGHT},
+};
+
+static const uint32_t LATENCY_EDGES_MS[PRESS_LATENCY_BUCKETS - 1] =
+    PRESS_LATENCY_EDGES_MS;
+
+// Loop task
+static PressMode modes[PRESS_BUTTON_COUNT];
+static bool modesInitialized = false;
+static bool speculating[PRESS_BUTTON_COUNT];
+static uint32_t touchUs[PRESS_BUTTON_COUNT]; // LV_EVENT_PRESSED
+static uint32_t speculativeCount = 0;
+static uint32_t correctionCount = 0;
+
+// The press whose command is on its way to the wire; the network task
+// completes it
+static portMUX_TYPE latencyMux = portMUX_INITIALIZER_UNLOCKED;
+static bool pending = false;
+static uint32_t pendingTouchUs = 0;
+static PressMode pendingMode = PRESS_MODE_RELEASE;
+static uint32_t histogram[PRESS_MODE_COUNT][PRESS_LATENCY_BUCKETS];
+static uint32_t samples[PRESS_MODE_COUNT];
+static uint64_t sumUs[PRESS_MODE_COUNT];
+static uint32_t maxUs[PRESS_MODE_COUNT];
+
+static bool hasLongAction(RemoteCommand cmd) {
+  return commandInfo(cmd).longWord != CMD_WORD_NONE;
+}
+
+static void initModes() {
+  StoredModes stored;
+  bool loaded = false;
+  Preferences prefs;
+  if (prefs.begin(PRESS_MODE_NAMESPACE, true)) {
+    loaded = prefs.getBytes("modes", &stored, sizeof(stored)) ==
+                 sizeof(stored) &&
+             stored.version == PRESS_MODE_VERSION;
+    prefs.end();
+  }
+  for (size_t i = 0; i < PRESS_BUTTON_COUNT; i++) {
+    if (loaded && stored.modes[i] < PRESS_MODE_COUNT) {
+      modes[i] = (PressMode)stored.modes[i];
+    } else {
+      // A slip can only be taken back with the inverse long command
+      modes[i] = hasLongAction(BINDINGS[i].cmd) ? PRESS_MODE_FIRE
+                                                : PRESS_MODE_RELEASE;
+    }
+  }
+  modesInitialized = true;
+}
+
+static void saveModes() {
+  StoredModes stored;
+  stored.version = PRESS_MODE_VERSION;
+  for (size_t i = 0; i < PRESS_BUTTON_COUNT; i++) {
+    stored.modes[i] = (uint8_t)modes[i];
+  }
+  Preferences prefs;
+  prefs.begin(PRESS_MODE_NAMESPACE, false);
+  prefs.putBytes("modes", &stored, sizeof(stored));
+  prefs.end();
+}
+
+// Called right before the button's command is handed to sendCommand()
+static void armLatency(size_t i, PressMode mode) {
+  if (commandJournalActive()) {
+    return; // will not reach the wire now
+  }
+  portENTER_CRITICAL(&latencyMux);
+  pending = true;
+  pendingTouchUs = touchUs[i];
+  pendingMode = mode;
+  portEXIT_CRITICAL(&latencyMux);
+}
+
+static void onButtonEvent(lv_event_t *e) {
+  const PressBinding *b = (const PressBinding *)lv_event_get_user_data(e);
+  size_t i = b - BINDINGS;
+  lv_event_code_t code = lv_event_get_code(e);
+
+  if (code == LV_EVENT_PRESSED) {
+    touchUs[i] = (uint32_t)esp_timer_get_time();
+    speculating[i] = false;
+    if (modes[i] == PRESS_MODE_FIRE) {
+      armLatency(i, PRESS_MODE_FIRE);
+      sendCommand(b->cmd);
+      if (hasLongAction(b->cmd)) {
+        speculating[i] = true;
+        speculativeCount++;
+      }
+    }
+  } else if (code == b->releaseEvent) {
+    if (modes[i] == PRESS_MODE_FIRE) {
+      return; // sent on press
+    }
+    armLatency(i, PRESS_MODE_RELEASE);
+  } else if (code == LV_EVENT_LONG_PRESSED && speculating[i]) {
+    speculating[i] = false;
+    sendCommandLong(b->cmd); // undoes the short command
+    correctionCount++;
+  } else if (code == LV_EVENT_PRESS_LOST && speculating[i]) {
+    speculating[i] = false;
+    sendCommandLong(b->cmd); // undoes the short command, nothing else
+    correctionCount++;
+    return;
+  }
+  b->generated(e);
+}
+
+void attachPressModes() {
+  if (!modesInitialized) {
+    initModes();
+  }
+  for (size_t i = 0; i < PRESS_BUTTON_COUNT; i++) {
+    lv_obj_t *button = *BINDINGS[i].button;
+    // Only a freshly built button still has the generated handler
+    if (button != NULL &&
+        lv_obj_remove_event_cb(button, BINDINGS[i].generated)) {
+      lv_obj_add_event_cb(button, onButtonEvent, LV_EVENT_ALL,
+                          (void *)&BINDINGS[i]);
+    }
+  }
+}
+
+void setPressMode(PressButton button, PressMode mode) {
+  if (!modesInitialized) {
+    initModes();
+  }
+  if (button < PRESS_BUTTON_COUNT && mode < PRESS_MODE_COUNT &&
+      modes[button] != mode) {
+    modes[button] = mode;
+    speculating[button] = false;
+    saveModes();
+  }
+}
+
+PressMode pressMode(PressButton button) {
+  if (!modesInitialized) {
+    initModes();
+  }
+  return button < PRESS_BUTTON_COUNT ? modes[button] : PRESS_MODE_RELEASE;
+}
+
+void pressModeOnTransmit() {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  portENTER_CRITICAL(&latencyMux);
+  if (pending) {
+    pending = false;
+    uint32_t latency = now - pendingTouchUs;
+    if (latency < (uint32_t)PRESS_LATENCY_EXPIRY_MS * 1000) {
+      size_t bucket = 0;
+      while (bucket < PRESS_LATENCY_BUCKETS - 1 &&
+             latency > LATENCY_EDGES_MS[bucket] * 1000) {
+        bucket++;
+      }
+      histogram[pendingMode][bucket]++;
+      samples[pendingMode]++;
+      sumUs[pendingMode] += latency;
+      if (latency > maxUs[pendingMode]) {
+        maxUs[pendingMode] = latency;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&latencyMux);
+}
+
+void getPressModeStats(PressModeStats *stats) {
+  portENTER_CRITICAL(&latencyMux);
+  memcpy(stats->histogram, histogram, sizeof(histogram));
+  for (size_t m = 0; m < PRESS_MODE_COUNT; m++) {
+    stats->samples[m] = samples[m];
+    stats->avgUs[m] = samples[m] ? (uint32_t)(sumUs[m] / samples[m]) : 0;
+    stats->maxUs[m] = maxUs[m];
+  }
+  portEXIT_CRITICAL(&latencyMux);
+  stats->speculative = speculativeCount;
+  stats->corrections = correctionCount;
+}
+
+void resetPressModeStats() {
+  portENTER_CRITICAL(&latencyMux);
+  pending = false;
+  memset(histogram, 0, sizeof(histogram));
+  memset(samples, 0, sizeof(samples));
+  memset(sumUs, 0, sizeof(sumUs));
+  memset(maxUs, 0, sizeof(maxUs));
+  portEXIT_CRITICAL(&latencyMux);
+  speculativeCount = 0;
+  correctionCount = 0;
+}
@@ -0,0 +1,103 @@
+#ifndef PRESS_MODE_H
+#define PRESS_MODE_H
+
+#include <stdint.h>
+
+// When a command button sends its command. The SquareLine handlers act on
+// release (LV_EVENT_SHORT_CLICKED or LV_EVENT_CLICKED), so every tap carries
+// the time the finger rests on the glass as latency. In PRESS_MODE_FIRE the
+// command goes out on LV_EVENT_PRESSED instead.
+//
+// In PRESS_MODE_FIRE, buttons with a long-press action fire speculatively:
+// the short command is sent on press, and if the press turns into a long
+// press the long command is sent twice, once to undo the short one and once
+// for itself. On every such button the long command is the inverse of the
+// short one (score minus one, card withdrawn), which is what makes this
+// work. The scoring device shows the short action for the long-press time
+// (about 400 ms) before it is undone. A press that slides off the button,
+// e.g. the start of a swipe to another screen, is undone the same way with
+// the long command sent once.
+//
+// Buttons without a long-press action cannot take back a press that should
+// not have sent: a swipe that starts on PRIO would toggle priority. So the
+// buttons with an inverse (scores, cards, UW2F) default to PRESS_MODE_FIRE
+// and the others to PRESS_MODE_RELEASE, where a lost press sends nothing.
+// setPressMode() changes a button's mode and keeps it in NVS.
+//
+// attachPressModes() puts a dispatcher in front of the generated event
+// handler of every button in the table, after each build of its screen.
+//
+// Touch-to-wire latency (LV_EVENT_PRESSED to the datagram handed to the
+// stack) is kept as a histogram per mode.
+typedef enum {
+  PRESS_MODE_RELEASE, // generated behaviour
+  PRESS_MODE_FIRE,
+  PRESS_MODE_COUNT
+} PressMode;
+
+typedef enum {
+  PRESS_BUTTON_SCORE_LEFT_PLUS, // Central
+  PRESS_BUTTON_SCORE_RIGHT_PLUS,
+  PRESS_BUTTON_START_STOP,
+  PRESS_BUTTON_YELLOW_LEFT, // Cards
+  PRESS_BUTTON_RED_LEFT,
+  PRESS_BUTTON_BLACK_LEFT,
+  PRESS_BUTTON_YELLOW_RIGHT,
+  PRESS_BUTTON_RED_RIGHT,
+  PRESS_BUTTON_BLACK_RIGHT,
+  PRESS_BUTTON_UW2F,
+  PRESS_BUTTON_PRIO,
+  PRESS_BUTTON_NEXT, // Cyrano
+  PRESS_BUTTON_PREV,
+  PRESS_BUTTON_SWAP,
+  PRESS_BUTTON_RESERVE_LEFT,
+  PRESS_BUTTON_RESERVE_RIGHT,
+  PRESS_BUTTON_COUNT
+} PressButton;
+
+// Upper bucket edges in ms; the last bucket takes everything above
+#define PRESS_LATENCY_EDGES_MS {2, 5, 10, 20, 50, 100, 200, 500}
+#define PRESS_LATENCY_BUCKETS 9
+
+// A press whose command did not reach the wire within this time (e.g. it
+// went to the offline journal) is not counted
+#define PRESS_LATENCY_EXPIRY_MS 1000
+
+// Modes set through setPressMode(); bump the version when PressButton
+// changes
+#define PRESS_MODE_NAMESPACE "press"
+#define PRESS_MODE_VERSION 1
+
+typedef struct {
+  uint32_t histogram[PRESS_MODE_COUNT][PRESS_LATENCY_BUCKETS];
+  uint32_t samples[PRESS_MODE_COUNT];
+  uint32_t avgUs[PRESS_MODE_COUNT];
+  uint32_t maxUs[PRESS_MODE_COUNT];
+  uint32_t speculative; // short commands sent on press by long-press buttons
+  uint32_t corrections; // ... undone by a long press or a lost press
+} PressModeStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wraps the buttons of the screens that are built. Call from the screen
+// build callbacks of Central, Cards and Cyrano; repeated calls are harmless.
+void attachPressModes();
+
+// Persistent; loop task. PRESS_MODE_FIRE on a button without a long-press
+// action sends on every slip and swipe that starts on it.
+void setPressMode(PressButton button, PressMode mode);
+PressMode pressMode(PressButton button);
+
+// Called by the network task after each command datagram
+void pressModeOnTransmit();
+
+void getPressModeStats(PressModeStats *stats);
+void resetPressModeStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PRESS_MODE_H
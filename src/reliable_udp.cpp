@@ -0,0 +1,225 @@
+#include "reliable_udp.h"
+#include "SpscRing.h"
+#include "logger.h"
+#include "udp_queue.h"
+#include "wifi_udp.h"
+#include <Arduino.h>
+#include <string.h>
+
+struct InFlightFrame {
+  bool used;
+  uint8_t retries;
+  uint16_t seq;
+  size_t count; // words including the header
+  uint32_t firstSentUs;
+  uint32_t deadlineUs;
+  uint32_t words[UDP_MAX_DATAGRAM_WORDS];
+};
+
+static volatile bool reliableEnabled = RELIABLE_UDP_DEFAULT;
+static uint8_t remoteId = 0; // see remoteUDPId()
+static uint32_t bootEpoch = 0; // 0 until the first frame
+static uint16_t nextSeq = 0;
+static InFlightFrame window[RELIABLE_UDP_WINDOW];
+
+// ACKs arrive on the UDP receive task and are consumed by the network task
+static SpscRing<uint16_t, 16> ackRing;
+
+// RTT estimation (RFC 6298), all in microseconds
+static bool haveRttSample = false;
+static uint32_t srttUs = 0;
+static uint32_t rttvarUs = 0;
+static uint32_t rtoUs = RELIABLE_UDP_RTO_INITIAL_MS * 1000;
+
+static volatile uint32_t framesSent = 0;
+static volatile uint32_t retransmits = 0;
+static volatile uint32_t ackedCount = 0;
+static volatile uint32_t lostCount = 0;
+static volatile uint32_t duplicateAcks = 0;
+static volatile uint32_t deliveryMaxUs = 0;
+static uint64_t deliverySumUs = 0;
+
+static uint32_t nowUs() { return (uint32_t)esp_timer_get_time(); }
+
+static bool deadlinePassed(uint32_t deadlineUs, uint32_t now) {
+  return (int32_t)(now - deadlineUs) >= 0;
+}
+
+static void updateRtt(uint32_t sampleUs) {
+  if (!haveRttSample) {
+    srttUs = sampleUs;
+    rttvarUs = sampleUs / 2;
+    haveRttSample = true;
+  } else {
+    uint32_t err = srttUs > sampleUs ? srttUs - sampleUs : sampleUs - srttUs;
+    rttvarUs = (3 * rttvarUs + err) / 4;
+    srttUs = (7 * srttUs + sampleUs) / 8;
+  }
+  rtoUs = constrain(srttUs + 4 * rttvarUs, RELIABLE_UDP_RTO_MIN_MS * 1000,
+                    RELIABLE_UDP_RTO_MAX_MS * 1000);
+}
+
+// Exponential backoff per retransmission of the same frame
+static uint32_t backoffRto(uint8_t retries) {
+  uint32_t rto = rtoUs << retries;
+  if (rto > RELIABLE_UDP_RTO_MAX_MS * 1000 || rto < rtoUs) {
+    rto = RELIABLE_UDP_RTO_MAX_MS * 1000;
+  }
+  return rto;
+}
+
+static void handleAck(uint16_t seq, uint32_t now) {
+  for (size_t i = 0; i < RELIABLE_UDP_WINDOW; i++) {
+    InFlightFrame &f = window[i];
+    if (f.used && f.seq == seq) {
+      uint32_t delivery = now - f.firstSentUs;
+      // Karn's rule: only frames sent once give an unambiguous RTT sample
+      if (f.retries == 0) {
+        updateRtt(delivery);
+      }
+      if (delivery > deliveryMaxUs) {
+        deliveryMaxUs = delivery;
+      }
+      deliverySumUs += delivery;
+      ackedCount++;
+      f.used = false;
+      return;
+    }
+  }
+  duplicateAcks++;
+}
+
+uint8_t remoteUDPId() {
+  if (remoteId == 0) {
+    // Last byte of the factory MAC identifies this remote to the device
+    remoteId = (uint8_t)(ESP.getEfuseMac() >> 40);
+  }
+  return remoteId;
+}
+
+void setReliableUDP(bool enabled) {
+  reliableEnabled = enabled;
+  LOG_INFO("UDP: Reliable delivery %s\n", enabled ? "enabled" : "disabled");
+}
+
+bool isReliableUDPEnabled() { return reliableEnabled; }
+
+size_t reliableUDPWindowFree() {
+  size_t free = 0;
+  for (size_t i = 0; i < RELIABLE_UDP_WINDOW; i++) {
+    if (!window[i].used) {
+      free++;
+    }
+  }
+  return free;
+}
+
+bool sendReliableUDP(const uint32_t *words, size_t count) {
+  if (count == 0 || count > UDP_MAX_FRAME_WORDS) {
+    return false;
+  }
+
+  InFlightFrame *f = NULL;
+  for (size_t i = 0; i < RELIABLE_UDP_WINDOW; i++) {
+    if (!window[i].used) {
+      f = &window[i];
+      break;
+    }
+  }
+  if (f == NULL) {
+    return false;
+  }
+
+  if (bootEpoch == 0) {
+    // Drawn once the radio is on and esp_random() has real entropy
+    bootEpoch = esp_random() | 1;
+    nextSeq = (uint16_t)esp_random();
+  }
+  f->seq = nextSeq++;
+  f->words[0] =
+      RELIABLE_UDP_FRAME_TAG | ((uint32_t)remoteUDPId() << 16) | f->seq;
+  f->words[1] = bootEpoch;
+  memcpy(&f->words[RELIABLE_UDP_HEADER_WORDS], words,
+         count * sizeof(uint32_t));
+  f->count = count + RELIABLE_UDP_HEADER_WORDS;
+  f->retries = 0;
+  f->firstSentUs = nowUs();
+  f->deadlineUs = f->firstSentUs + rtoUs;
+  f->used = true;
+  framesSent++;
+
+  // A failed first transmission is simply retried on timeout
+  transmitUDP32Array(f->words, f->count);
+  return true;
+}
+
+uint32_t serviceReliableUDP() {
+  uint32_t now = nowUs();
+
+  uint16_t seq;
+  while (ackRing.pop(seq)) {
+    handleAck(seq, now);
+  }
+
+  uint32_t nextUs = RELIABLE_UDP_IDLE;
+  for (size_t i = 0; i < RELIABLE_UDP_WINDOW; i++) {
+    InFlightFrame &f = window[i];
+    if (!f.used) {
+      continue;
+    }
+    if (deadlinePassed(f.deadlineUs, now)) {
+      if (f.retries >= RELIABLE_UDP_MAX_RETRIES) {
+        LOG_WARN("UDP: Frame %u lost after %d retries\n", f.seq, f.retries);
+        lostCount++;
+        f.used = false;
+        continue;
+      }
+      f.retries++;
+      retransmits++;
+      transmitUDP32Array(f.words, f.count);
+      f.deadlineUs = now + backoffRto(f.retries);
+    }
+    uint32_t remaining = f.deadlineUs - now;
+    if (remaining < nextUs) {
+      nextUs = remaining;
+    }
+  }
+
+  return nextUs == RELIABLE_UDP_IDLE ? RELIABLE_UDP_IDLE
+                                     : (nextUs + 999) / 1000;
+}
+
+void onReliableUDPAck(uint32_t ackWord) {
+  uint8_t id = (ackWord >> 16) & 0xFF;
+  if (id != remoteUDPId()) {
+    return; // ACK for another remote on the same piste
+  }
+  if (ackRing.push(ackWord & 0xFFFF)) {
+    notifyUDPQueue();
+  }
+}
+
+void getReliableUDPStats(ReliableUdpStats *stats) {
+  stats->framesSent = framesSent;
+  stats->retransmits = retransmits;
+  stats->acked = ackedCount;
+  stats->lost = lostCount;
+  stats->duplicateAcks = duplicateAcks;
+  stats->inFlight = RELIABLE_UDP_WINDOW - reliableUDPWindowFree();
+  stats->srttUs = srttUs;
+  stats->rttvarUs = rttvarUs;
+  stats->rtoUs = rtoUs;
+  stats->deliveryAvgUs =
+      ackedCount ? (uint32_t)(deliverySumUs / ackedCount) : 0;
+  stats->deliveryMaxUs = deliveryMaxUs;
+}
+
+void resetReliableUDPStats() {
+  framesSent = 0;
+  retransmits = 0;
+  ackedCount = 0;
+  lostCount = 0;
+  duplicateAcks = 0;
+  deliveryMaxUs = 0;
+  deliverySumUs = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef RELIABLE_UDP_H
+#define RELIABLE_UDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Optional reliable delivery of command frames.
+//
+// Wire format (all words little-endian, like plain command frames):
+//   frame: [FRAME_TAG | remoteId << 16 | seq] [epoch] [command word] ...
+//   ack:   [ACK_TAG   | remoteId << 16 | seq]
+// The scoring device acknowledges every frame it receives and drops frames
+// whose (remoteId, seq) it has already applied. The remote keeps at most
+// RELIABLE_UDP_WINDOW frames in flight and retransmits them on an adaptive
+// timeout derived from the measured round-trip time.
+//
+// The epoch is a random non-zero word chosen at boot, and the sequence
+// numbers start at a random value. A device that sees a new epoch for a
+// remote forgets the sequence numbers it has applied for it, so frames sent
+// after a reboot are never mistaken for retransmissions.
+#define RELIABLE_UDP_DEFAULT false // plain fire-and-forget unless enabled
+#define RELIABLE_UDP_FRAME_TAG 0x07000000
+#define RELIABLE_UDP_ACK_TAG 0x08000000
+#define RELIABLE_UDP_TAG_MASK 0xFF000000
+#define RELIABLE_UDP_HEADER_WORDS 2
+
+#define RELIABLE_UDP_WINDOW 4
+#define RELIABLE_UDP_MAX_RETRIES 6
+#define RELIABLE_UDP_RTO_INITIAL_MS 100
+#define RELIABLE_UDP_RTO_MIN_MS 20
+#define RELIABLE_UDP_RTO_MAX_MS 1000
+
+// Returned by serviceReliableUDP() when nothing is waiting for an ACK
+#define RELIABLE_UDP_IDLE UINT32_MAX
+
+typedef struct {
+  uint32_t framesSent;     // new frames put on the wire
+  uint32_t retransmits;    // repeated transmissions after a timeout
+  uint32_t acked;          // frames confirmed by the scoring device
+  uint32_t lost;           // frames abandoned after RELIABLE_UDP_MAX_RETRIES
+  uint32_t duplicateAcks;  // ACKs for frames no longer in flight
+  uint32_t inFlight;       // frames currently waiting for an ACK
+  uint32_t srttUs;         // smoothed round-trip time
+  uint32_t rttvarUs;       // round-trip time variation
+  uint32_t rtoUs;          // current retransmission timeout
+  uint32_t deliveryAvgUs;  // first transmission to ACK, retransmits included
+  uint32_t deliveryMaxUs;
+} ReliableUdpStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void setReliableUDP(bool enabled);
+bool isReliableUDPEnabled();
+
+// Identifies this remote in frame headers, ACKs and liveness probes
+uint8_t remoteUDPId();
+
+// Network task side
+size_t reliableUDPWindowFree();
+bool sendReliableUDP(const uint32_t *words, size_t count);
+// Processes received ACKs and due retransmissions. Returns the number of
+// milliseconds until the next retransmission deadline, or RELIABLE_UDP_IDLE.
+uint32_t serviceReliableUDP();
+
+// Receive side (UDP receive task): hand over an ACK word
+void onReliableUDPAck(uint32_t ackWord);
+
+void getReliableUDPStats(ReliableUdpStats *stats);
+void resetReliableUDPStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RELIABLE_UDP_H
@@ -0,0 +1,359 @@
+#include "scoreboard.h"
+#include "SpscRing.h"
+#include "liveness.h"
+#include "loop_scheduler.h"
+#include "ui/ui.h"
+#include <Arduino.h>
+
+static const char *const WEAPON_NAMES[] = {"Foil", "Epee", "Sabre"};
+static const char *const MATCH_TYPE_NAMES[] = {"Indiv", "Team"};
+
+#define SCOREBOARD_REORDER_WINDOW 64
+
+// "m:ss", or "s.cc" in the last ten seconds; up to "99:59"
+#define TIMER_SLOTS 5
+#define TIMER_SLOT_WIDTH 9
+
+// Snapshots arrive on the receive task and are consumed by the loop task
+static SpscRing<ScoreboardState, 8> stateRing;
+
+// Last snapshot shown on the labels
+static ScoreboardState shown;
+static bool haveShown = false;
+
+// Labels on the Central screen, NULL while it is not built. Their text
+// lives in these buffers (lv_label_set_text_static), so updating a label
+// does not allocate either.
+static lv_obj_t *scoreLeftLabel = NULL;
+static lv_obj_t *scoreRightLabel = NULL;
+static lv_obj_t *cardsLeftLabel = NULL;
+static lv_obj_t *cardsRightLabel = NULL;
+static lv_obj_t *timerSlots[TIMER_SLOTS] = {};
+static lv_obj_t *infoLabel = NULL;
+static char scoreLeftText[4] = "";
+static char scoreRightText[4] = "";
+static char cardsLeftText[40] = "";
+static char cardsRightText[40] = "";
+static char timerSlotText[TIMER_SLOTS][2] = {};
+static bool timerStale = true; // redraw every slot
+static char infoText[40] = "";
+
+// Receive-task counters
+static volatile uint32_t receivedCount = 0;
+static volatile uint32_t malformedCount = 0;
+static volatile uint32_t droppedCount = 0;
+static uint64_t parseSumCycles = 0;
+static volatile uint32_t parseMaxCycles = 0;
+
+// Loop-task counters
+static uint32_t supersededCount = 0;
+static uint32_t staleCount = 0;
+static uint32_t appliedCount = 0;
+static uint32_t labelUpdateCount = 0;
+static bool timerSynced = false;
+static uint32_t timerErrorUs = 0;
+static uint64_t applySumUs = 0;
+static uint32_t applyMaxUs = 0;
+
+static uint32_t readWord(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+bool parseScoreboardState(const uint8_t *data, size_t length,
+                          ScoreboardState *state) {
+  // Longer datagrams may carry fields from a newer version at the end
+  if (length < SCOREBOARD_STATE_WORDS_V1 * 4) {
+    return false;
+  }
+  uint32_t header = readWord(data);
+  uint32_t version = (header >> 16) & 0xFF;
+  if ((header & 0xFF000000) != SCOREBOARD_STATE_TAG || version < 1 ||
+      version > SCOREBOARD_VERSION) {
+    return false;
+  }
+  state->hasDeviceTime = version >= 2;
+  if (state->hasDeviceTime && length < SCOREBOARD_STATE_WORDS * 4) {
+    return false;
+  }
+  uint32_t scores = readWord(data + 4);
+  uint32_t timer = readWord(data + 8);
+  uint32_t info = readWord(data + 12);
+
+  state->seq = header & 0xFFFF;
+  state->scoreLeft = scores & 0xFF;
+  state->scoreRight = (scores >> 8) & 0xFF;
+  state->cardsLeft = (scores >> 16) & 0xFF;
+  state->cardsRight = scores >> 24;
+  state->remainingCs = timer & 0x00FFFFFF;
+  state->flags = timer >> 24;
+  state->weapon = info & 0x0F;
+  state->matchType = (info >> 4) & 0x0F;
+  state->priority = (info >> 8) & 0x0F;
+  state->period = (info >> 12) & 0x0F;
+  state->deviceMs = state->hasDeviceTime ? readWord(data + 16) : 0;
+  return true;
+}
+
+void onScoreboardState(const uint8_t *data, size_t length) {
+  uint32_t start = ESP.getCycleCount();
+  receivedCount++;
+  ScoreboardState state;
+  if (!parseScoreboardState(data, length, &state)) {
+    malformedCount++;
+    return;
+  }
+  state.receivedUs = (uint32_t)esp_timer_get_time();
+  if (!stateRing.push(state)) {
+    droppedCount++;
+  }
+  wakeLoop();
+  uint32_t spent = ESP.getCycleCount() - start;
+  parseSumCycles += spent;
+  if (spent > parseMaxCycles) {
+    parseMaxCycles = spent;
+  }
+}
+
+static void setLabel(lv_obj_t *label, const char *text) {
+  if (label != NULL) {
+    lv_label_set_text_static(label, text);
+    labelUpdateCount++;
+  }
+}
+
+// Recoloured card text, e.g. "#e8c000 Y# #e00000 R2#"
+static void formatCards(char *out, size_t size, uint8_t cards) {
+  uint8_t reds =
+      (cards & SCOREBOARD_CARD_RED_MASK) >> SCOREBOARD_CARD_RED_SHIFT;
+  size_t n = 0;
+  out[0] = '\0';
+  if (cards & SCOREBOARD_CARD_YELLOW) {
+    n += snprintf(out + n, size - n, "#e8c000 Y# ");
+  }
+  if (reds == 1) {
+    n += snprintf(out + n, size - n, "#e00000 R# ");
+  } else if (reds > 1) {
+    n += snprintf(out + n, size - n, "#e00000 R%u# ", reds);
+  }
+  if (cards & SCOREBOARD_CARD_BLACK) {
+    snprintf(out + n, size - n, "B");
+  }
+}
+
+// Remaining time of the snapshot at esp_timer time nowUs
+static int64_t remainingUs(const ScoreboardState &s, int64_t nowUs) {
+  int64_t remaining = (int64_t)s.remainingCs * 10000;
+  if (!(s.flags & SCOREBOARD_FLAG_RUNNING)) {
+    timerSynced = false;
+    timerErrorUs = 0;
+    return remaining;
+  }
+  int64_t elapsed;
+  int64_t deviceUs;
+  uint32_t errorUs;
+  timerSynced = s.hasDeviceTime &&
+                livenessDeviceTime(nowUs, &deviceUs, &errorUs);
+  if (timerSynced) {
+    // The stamp truncates to ms. Both clocks are unwrapped from the same
+    // 32-bit ms counter, so the low bits line up.
+    uint32_t deviceMs = (uint32_t)(deviceUs / 1000);
+    elapsed = (int64_t)(int32_t)(deviceMs - s.deviceMs) * 1000 +
+              deviceUs % 1000 - 500;
+    timerErrorUs = errorUs + 500;
+  } else {
+    // Without sync the snapshot is as old as its one-way delay
+    elapsed = (uint32_t)nowUs - s.receivedUs;
+    timerErrorUs = 0;
+  }
+  if (elapsed <= 0) {
+    return remaining;
+  }
+  return elapsed >= remaining ? 0 : remaining - elapsed;
+}
+
+// Rounds up like the scoring device: "2:59" until 2:58 is reached, and
+// "9.99" right after "0:10"
+static void formatTimer(char *out, size_t size, int64_t us) {
+  uint32_t cs = (uint32_t)((us + 9999) / 10000);
+  if (cs >= 1000) {
+    uint32_t seconds = (cs + 99) / 100;
+    snprintf(out, size, "%u:%02u", seconds / 60 % 100, seconds % 60);
+  } else {
+    snprintf(out, size, "%u.%02u", cs / 100, cs % 100);
+  }
+}
+
+// Right-aligns the text on the slots and redraws the slots whose character
+// changed: while the timer runs that is usually only the last one
+static void drawTimer(int64_t us) {
+  char text[TIMER_SLOTS + 1];
+  formatTimer(text, sizeof(text), us);
+  size_t length = strlen(text);
+  for (size_t i = 0; i < TIMER_SLOTS; i++) {
+    size_t pad = TIMER_SLOTS - length;
+    char c = i < pad ? '\0' : text[i - pad];
+    if (!timerStale && timerSlotText[i][0] == c) {
+      continue;
+    }
+    timerSlotText[i][0] = c;
+    setLabel(timerSlots[i], timerSlotText[i]);
+  }
+  timerStale = false;
+}
+
+static void formatInfo(const ScoreboardState &s) {
+  const char *weapon = s.weapon < 3 ? WEAPON_NAMES[s.weapon] : "?";
+  const char *matchType =
+      s.matchType < 2 ? MATCH_TYPE_NAMES[s.matchType] : "?";
+  const char *priority = s.priority == PRIORITY_LEFT    ? "  < Prio"
+                         : s.priority == PRIORITY_RIGHT ? "  Prio >"
+                                                        : "";
+  snprintf(infoText, sizeof(infoText), "%s  %s  P%u%s", weapon, matchType,
+           s.period, priority);
+}
+
+// Updates the labels whose inputs differ from the shown snapshot, or all
+// of them after the screen has been (re)built
+static void applyState(const ScoreboardState &s, bool all) {
+  if (all || s.scoreLeft != shown.scoreLeft) {
+    snprintf(scoreLeftText, sizeof(scoreLeftText), "%u", s.scoreLeft);
+    setLabel(scoreLeftLabel, scoreLeftText);
+  }
+  if (all || s.scoreRight != shown.scoreRight) {
+    snprintf(scoreRightText, sizeof(scoreRightText), "%u", s.scoreRight);
+    setLabel(scoreRightLabel, scoreRightText);
+  }
+  if (all || s.cardsLeft != shown.cardsLeft) {
+    formatCards(cardsLeftText, sizeof(cardsLeftText), s.cardsLeft);
+    setLabel(cardsLeftLabel, cardsLeftText);
+  }
+  if (all || s.cardsRight != shown.cardsRight) {
+    formatCards(cardsRightText, sizeof(cardsRightText), s.cardsRight);
+    setLabel(cardsRightLabel, cardsRightText);
+  }
+  if (all || s.weapon != shown.weapon || s.matchType != shown.matchType ||
+      s.priority != shown.priority || s.period != shown.period) {
+    formatInfo(s);
+    setLabel(infoLabel, infoText);
+  }
+  shown = s;
+}
+
+static void onLabelsDeleted(lv_event_t *e) {
+  (void)e;
+  scoreLeftLabel = NULL;
+  scoreRightLabel = NULL;
+  cardsLeftLabel = NULL;
+  cardsRightLabel = NULL;
+  for (size_t i = 0; i < TIMER_SLOTS; i++) {
+    timerSlots[i] = NULL;
+  }
+  infoLabel = NULL;
+}
+
+static lv_obj_t *createLabel(lv_coord_t x, lv_coord_t y, lv_coord_t width,
+                             lv_text_align_t align, const char *text) {
+  lv_obj_t *label = lv_label_create(ui_Central_Screen);
+  lv_obj_set_pos(label, x, y);
+  lv_obj_set_width(label, width);
+  lv_obj_set_style_text_align(label, align, 0);
+  lv_label_set_text_static(label, text);
+  return label;
+}
+
+void attachScoreboard() {
+  if (ui_Central_Screen == NULL) {
+    return;
+  }
+  // Score and cards under each "+" button, timer and match info between
+  // them above the piste label (screen is 240 x 320)
+  scoreLeftLabel =
+      createLabel(20, 102, 36, LV_TEXT_ALIGN_RIGHT, scoreLeftText);
+  cardsLeftLabel =
+      createLabel(60, 102, 40, LV_TEXT_ALIGN_LEFT, cardsLeftText);
+  scoreRightLabel =
+      createLabel(140, 102, 36, LV_TEXT_ALIGN_RIGHT, scoreRightText);
+  cardsRightLabel =
+      createLabel(180, 102, 40, LV_TEXT_ALIGN_LEFT, cardsRightText);
+  lv_label_set_recolor(cardsLeftLabel, true);
+  lv_label_set_recolor(cardsRightLabel, true);
+  for (size_t i = 0; i < TIMER_SLOTS; i++) {
+    timerSlots[i] = createLabel(0, 0, TIMER_SLOT_WIDTH, LV_TEXT_ALIGN_CENTER,
+                                timerSlotText[i]);
+    lv_obj_align(timerSlots[i], LV_ALIGN_CENTER,
+                 (2 * i + 1 - TIMER_SLOTS) * TIMER_SLOT_WIDTH / 2, -46);
+  }
+  infoLabel =
+      createLabel(0, 0, LV_SIZE_CONTENT, LV_TEXT_ALIGN_CENTER, infoText);
+  lv_obj_align(infoLabel, LV_ALIGN_CENTER, 0, -28);
+
+  // All labels go with the screen
+  lv_obj_add_event_cb(scoreLeftLabel, onLabelsDeleted, LV_EVENT_DELETE, NULL);
+
+  timerStale = true;
+  if (haveShown) {
+    applyState(shown, true);
+    drawTimer(remainingUs(shown, esp_timer_get_time()));
+  }
+}
+
+uint32_t serviceScoreboard() {
+  ScoreboardState next;
+  bool haveNext = false;
+  ScoreboardState state;
+  while (stateRing.pop(state)) {
+    // seq is a 16-bit counter. A datagram slightly behind the newest one
+    // was reordered; a large step back means the device restarted.
+    const ScoreboardState &reference = haveNext ? next : shown;
+    int16_t ahead = (int16_t)(state.seq - reference.seq);
+    if ((haveNext || haveShown) && ahead <= 0 &&
+        ahead > -SCOREBOARD_REORDER_WINDOW) {
+      staleCount++;
+      continue;
+    }
+    if (haveNext) {
+      supersededCount++;
+    }
+    next = state;
+    haveNext = true;
+  }
+  if (haveNext) {
+    uint32_t start = micros();
+    applyState(next, !haveShown);
+    haveShown = true;
+    uint32_t spent = micros() - start;
+    appliedCount++;
+    applySumUs += spent;
+    if (spent > applyMaxUs) {
+      applyMaxUs = spent;
+    }
+  }
+  if (!haveShown) {
+    return UINT32_MAX;
+  }
+  int64_t us = remainingUs(shown, esp_timer_get_time());
+  drawTimer(us);
+  if (!(shown.flags & SCOREBOARD_FLAG_RUNNING) || us <= 0) {
+    return UINT32_MAX;
+  }
+  // formatTimer() shows whole seconds from 10 s up, 1/100 s below
+  int64_t step = us > 9990000 ? 1000000 : 10000;
+  return (uint32_t)((((us - 1) % step) + 1 + 999) / 1000);
+}
+
+void getScoreboardStats(ScoreboardStats *stats) {
+  stats->received = receivedCount;
+  stats->malformed = malformedCount;
+  stats->dropped = droppedCount + supersededCount;
+  stats->stale = staleCount;
+  stats->applied = appliedCount;
+  stats->labelUpdates = labelUpdateCount;
+  stats->timerSynced = timerSynced;
+  stats->timerErrorUs = timerErrorUs;
+  uint32_t parsed = receivedCount - malformedCount;
+  stats->parseAvgCycles = parsed ? (uint32_t)(parseSumCycles / parsed) : 0;
+  stats->parseMaxCycles = parseMaxCycles;
+  stats->applyAvgUs = appliedCount ? (uint32_t)(applySumUs / appliedCount) : 0;
+  stats->applyMaxUs = applyMaxUs;
+}
@@ -0,0 +1,103 @@
+#ifndef SCOREBOARD_H
+#define SCOREBOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Mirror of the scoring device's state on the Central screen. The device
+// sends a state datagram to every remote that has pinged it within the
+// last liveness period (the ping doubles as the subscription), on each
+// change and once a second. While the remote is idle the pings back off
+// (liveness.h) and the subscription lapses; the first touch renews it.
+//
+// Wire format (five little-endian words, like command words):
+//   [STATE_TAG | version << 16 | seq]
+//   [scoreLeft | scoreRight << 8 | cardsLeft << 16 | cardsRight << 24]
+//   [remaining time in 1/100 s (24 bits) | flags << 24]
+//   [weapon | matchType << 4 | priority << 8 | period << 12]
+//   [device clock in ms when the remaining time was read]  (version 2)
+// cards: bit 0 yellow, bits 1-3 number of red cards, bit 4 black
+// flags: bit 0 timer running
+// priority: 0 none, 1 left, 2 right
+//
+// Datagrams are parsed in place on the receive task and handed to the loop
+// task, which compares them with the last snapshot and only touches the
+// labels whose text changes. While the timer runs the loop task counts it
+// down itself: the device clock stamp and the clock sync of the liveness
+// probes (liveness.h) give the time elapsed on the device since the
+// snapshot, so datagrams are only needed for corrections. The timer is one
+// label per character and only the characters that change are redrawn.
+#define SCOREBOARD_STATE_TAG 0x0B000000
+#define SCOREBOARD_VERSION 2
+#define SCOREBOARD_STATE_WORDS 5
+#define SCOREBOARD_STATE_WORDS_V1 4
+
+#define SCOREBOARD_CARD_YELLOW 0x01
+#define SCOREBOARD_CARD_RED_MASK 0x0E
+#define SCOREBOARD_CARD_RED_SHIFT 1
+#define SCOREBOARD_CARD_BLACK 0x10
+
+#define SCOREBOARD_FLAG_RUNNING 0x01
+
+typedef enum { PRIORITY_NONE, PRIORITY_LEFT, PRIORITY_RIGHT } Priority;
+
+typedef struct {
+  uint16_t seq;
+  uint8_t scoreLeft;
+  uint8_t scoreRight;
+  uint8_t cardsLeft;
+  uint8_t cardsRight;
+  uint8_t flags;
+  uint8_t weapon;
+  uint8_t matchType;
+  uint8_t priority;
+  uint8_t period;
+  uint32_t remainingCs;
+  bool hasDeviceTime;  // version 2
+  uint32_t deviceMs;   // device clock when remainingCs was read
+  uint32_t receivedUs; // esp_timer time of arrival
+} ScoreboardState;
+
+typedef struct {
+  uint32_t received;       // state datagrams seen by the receive task
+  uint32_t malformed;      // wrong size or version
+  uint32_t dropped;        // ring full, superseded before the loop saw them
+  uint32_t stale;          // older than the last applied snapshot
+  uint32_t applied;        // snapshots compared with the previous one
+  uint32_t labelUpdates;   // labels whose text changed
+  bool timerSynced;        // counted down on the device clock, else from
+                           // the arrival time of the snapshot
+  uint32_t timerErrorUs;   // error bound of the shown time, 0 if unsynced
+  uint32_t parseAvgCycles; // receive task, per datagram
+  uint32_t parseMaxCycles;
+  uint32_t applyAvgUs;     // loop task, per applied snapshot
+  uint32_t applyMaxUs;
+} ScoreboardStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Receive task: parse a state datagram (without allocating) and queue it
+void onScoreboardState(const uint8_t *data, size_t length);
+
+// Parser behind onScoreboardState(); false for a malformed datagram
+bool parseScoreboardState(const uint8_t *data, size_t length,
+                          ScoreboardState *state);
+
+// Creates the scoreboard labels on the Central screen. Call from its
+// build callback; the labels show the last snapshot right away.
+void attachScoreboard();
+
+// Loop task: apply the newest queued snapshot to the labels and advance
+// the running timer. Call on every loop pass; returns the ms until the
+// timer text changes next (UINT32_MAX if it is stopped).
+uint32_t serviceScoreboard();
+
+void getScoreboardStats(ScoreboardStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCOREBOARD_H
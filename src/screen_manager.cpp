@@ -0,0 +1,211 @@
+#include "screen_manager.h"
+#include "calibration_screen.h"
+#include "logger.h"
+#include "ui/ui.h"
+#include <Arduino.h>
+
+struct ScreenEntry {
+  const char *name;
+  lv_obj_t **screen;
+  void (*init)(void);
+  void (*destroy)(void);
+  bool restoreOnReconnect;
+};
+
+static const ScreenEntry SCREENS[SCREEN_COUNT] = {
+    {"Central", &ui_Central_Screen, ui_Central_Screen_screen_init,
+     ui_Central_Screen_screen_destroy, true},
+    {"Basic_Settings", &ui_Basic_Settings_Screen,
+     ui_Basic_Settings_Screen_screen_init,
+     ui_Basic_Settings_Screen_screen_destroy, true},
+    {"No_Connection", &ui_No_Connection_Screen,
+     ui_No_Connection_Screen_screen_init,
+     ui_No_Connection_Screen_screen_destroy, false},
+    {"Cards", &ui_Cards_Screen, ui_Cards_Screen_screen_init,
+     ui_Cards_Screen_screen_destroy, true},
+    {"SpecificSettings", &ui_SpecificSettingsScreen,
+     ui_SpecificSettingsScreen_screen_init,
+     ui_SpecificSettingsScreen_screen_destroy, false},
+    {"Cyrano", &ui_Cyrano_Screen, ui_Cyrano_Screen_screen_init,
+     ui_Cyrano_Screen_screen_destroy, false},
+    {"Set_Time", &ui_Set_Time_Screen, ui_Set_Time_Screen_screen_init,
+     ui_Set_Time_Screen_screen_destroy, false},
+    {"Power_Settings", &ui_Power_Settings_Screen,
+     ui_Power_Settings_Screen_screen_init,
+     ui_Power_Settings_Screen_screen_destroy, false},
+    {"Calibration", &ui_Calibration_Screen, ui_Calibration_Screen_screen_init,
+     ui_Calibration_Screen_screen_destroy, false},
+};
+
+static void (*builtCallbacks[SCREEN_COUNT])(void);
+static ScreenStats stats[SCREEN_COUNT];
+static uint32_t lastUsed[SCREEN_COUNT]; // 0 = never shown
+static uint32_t useCounter = 0;
+static bool evictionCheckPending = false;
+
+static uint32_t freeHeap() {
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  return mon.free_size;
+}
+
+static ScreenId findScreen(lv_obj_t **target) {
+  for (int i = 0; i < SCREEN_COUNT; i++) {
+    if (SCREENS[i].screen == target) {
+      return (ScreenId)i;
+    }
+  }
+  return SCREEN_NONE;
+}
+
+// LV_EVENT_SCREEN_LOADED on every managed screen: recency for the hot set
+static void onScreenLoaded(lv_event_t *e) {
+  ScreenId id = (ScreenId)(intptr_t)lv_event_get_user_data(e);
+  lastUsed[id] = ++useCounter;
+  evictionCheckPending = true;
+}
+
+static void buildScreen(ScreenId id) {
+  const ScreenEntry &entry = SCREENS[id];
+  uint32_t heapBefore = freeHeap();
+  uint32_t start = micros();
+  entry.init();
+  if (builtCallbacks[id] != NULL) {
+    builtCallbacks[id]();
+  }
+  uint32_t spent = micros() - start;
+  uint32_t heapAfter = freeHeap();
+  lv_obj_add_event_cb(*entry.screen, onScreenLoaded, LV_EVENT_SCREEN_LOADED,
+                      (void *)(intptr_t)id);
+
+  ScreenStats &s = stats[id];
+  s.builds++;
+  s.buildLastUs = spent;
+  if (spent > s.buildMaxUs) {
+    s.buildMaxUs = spent;
+  }
+  s.heapCostBytes = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+  LOG_INFO("Screens: built %s in %u us, %u bytes, %u free\n", entry.name,
+           spent, s.heapCostBytes, heapAfter);
+}
+
+static void destroyScreen(ScreenId id) {
+  const ScreenEntry &entry = SCREENS[id];
+  uint32_t start = micros();
+  entry.destroy();
+  uint32_t spent = micros() - start;
+
+  ScreenStats &s = stats[id];
+  s.destroys++;
+  s.destroyLastUs = spent;
+  LOG_INFO("Screens: evicted %s in %u us, %u free\n", entry.name, spent,
+           freeHeap());
+}
+
+// Installed as _ui_screen_build_hook so navigation from SquareLine events
+// is measured as well
+static void buildHook(lv_obj_t **target, void (*target_init)(void)) {
+  ScreenId id = findScreen(target);
+  if (id == SCREEN_NONE) {
+    target_init();
+    return;
+  }
+  buildScreen(id);
+}
+
+// Rank of the screen by recency: 0 = most recently shown
+static int recencyRank(ScreenId id) {
+  int rank = 0;
+  for (int i = 0; i < SCREEN_COUNT; i++) {
+    if (lastUsed[i] > lastUsed[id]) {
+      rank++;
+    }
+  }
+  return rank;
+}
+
+static ScreenId coldestEvictable() {
+  lv_disp_t *disp = lv_disp_get_default();
+  ScreenId coldest = SCREEN_NONE;
+  for (int i = 0; i < SCREEN_COUNT; i++) {
+    lv_obj_t *obj = *SCREENS[i].screen;
+    if (obj == NULL || obj == lv_scr_act() || obj == disp->prev_scr) {
+      continue; // not built, shown, or still animating out
+    }
+    if (lastUsed[i] != 0 && recencyRank((ScreenId)i) < SCREEN_HOT_SET) {
+      continue;
+    }
+    if (coldest == SCREEN_NONE || lastUsed[i] < lastUsed[coldest]) {
+      coldest = (ScreenId)i;
+    }
+  }
+  return coldest;
+}
+
+void initScreens() {
+  // Same setup as ui_init(), minus the eager *_screen_init() calls
+  LV_EVENT_GET_COMP_CHILD = lv_event_register_id();
+
+  lv_disp_t *dispp = lv_disp_get_default();
+  lv_theme_t *theme = lv_theme_default_init(
+      dispp, lv_palette_main(LV_PALETTE_BLUE), lv_palette_main(LV_PALETTE_RED),
+      false, LV_FONT_DEFAULT);
+  lv_disp_set_theme(dispp, theme);
+  ui____initial_actions0 = lv_obj_create(NULL);
+
+  _ui_screen_build_hook = buildHook;
+}
+
+void showScreen(ScreenId id) {
+  if (id >= SCREEN_COUNT) {
+    return;
+  }
+  _ui_screen_change(SCREENS[id].screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
+                    SCREENS[id].init);
+}
+
+ScreenId activeScreenId() {
+  lv_obj_t *active = lv_scr_act();
+  for (int i = 0; i < SCREEN_COUNT; i++) {
+    if (*SCREENS[i].screen == active) {
+      return (ScreenId)i;
+    }
+  }
+  return SCREEN_NONE;
+}
+
+bool screenRestoresOnReconnect(ScreenId id) {
+  return id < SCREEN_COUNT && SCREENS[id].restoreOnReconnect;
+}
+
+const char *screenName(ScreenId id) {
+  return id < SCREEN_COUNT ? SCREENS[id].name : "none";
+}
+
+void setScreenBuiltCallback(ScreenId id, void (*callback)(void)) {
+  if (id < SCREEN_COUNT) {
+    builtCallbacks[id] = callback;
+  }
+}
+
+void serviceScreens() {
+  // Screens only grow the heap when they are built, i.e. on navigation
+  if (!evictionCheckPending) {
+    return;
+  }
+  evictionCheckPending = false;
+
+  while (freeHeap() < SCREEN_EVICT_FREE_BYTES) {
+    ScreenId victim = coldestEvictable();
+    if (victim == SCREEN_NONE) {
+      break;
+    }
+    destroyScreen(victim);
+  }
+}
+
+void getScreenStats(ScreenId id, ScreenStats *out) {
+  if (id < SCREEN_COUNT) {
+    *out = stats[id];
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef SCREEN_MANAGER_H
+#define SCREEN_MANAGER_H
+
+#include <lvgl.h>
+#include <stdint.h>
+
+// Lazy screen construction. Screens are built on first navigation (through
+// _ui_screen_change() or showScreen()) instead of all at boot by ui_init().
+// The SCREEN_HOT_SET most recently shown screens stay resident; older ones
+// are destroyed with their *_screen_destroy() function when the free LVGL
+// heap drops below SCREEN_EVICT_FREE_BYTES, and rebuilt on next use.
+#ifndef SCREEN_HOT_SET
+#define SCREEN_HOT_SET 3
+#endif
+#ifndef SCREEN_EVICT_FREE_BYTES
+#define SCREEN_EVICT_FREE_BYTES 8192
+#endif
+
+typedef enum {
+  SCREEN_CENTRAL,
+  SCREEN_BASIC_SETTINGS,
+  SCREEN_NO_CONNECTION,
+  SCREEN_CARDS,
+  SCREEN_SPECIFIC_SETTINGS,
+  SCREEN_CYRANO,
+  SCREEN_SET_TIME,
+  SCREEN_POWER_SETTINGS,
+  SCREEN_CALIBRATION, // touch calibration, not from SquareLine
+  SCREEN_COUNT,
+  SCREEN_NONE = SCREEN_COUNT
+} ScreenId;
+
+typedef struct {
+  uint32_t builds;
+  uint32_t destroys;
+  uint32_t buildLastUs;
+  uint32_t buildMaxUs;
+  uint32_t destroyLastUs;
+  uint32_t heapCostBytes; // LVGL heap used by the last build
+} ScreenStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Replaces ui_init(): sets up the theme but builds no screens
+void initScreens();
+
+// Builds the screen if needed and loads it without animation
+void showScreen(ScreenId id);
+
+// Screen currently loaded, or SCREEN_NONE
+ScreenId activeScreenId();
+
+// Whether the screen is brought back after a connection loss
+bool screenRestoresOnReconnect(ScreenId id);
+
+const char *screenName(ScreenId id);
+
+// Called after every (re)build of the screen, to restore widget state that
+// is not part of the SquareLine export (e.g. the piste number)
+void setScreenBuiltCallback(ScreenId id, void (*callback)(void));
+
+// Evicts cold screens under memory pressure after a screen change. Call
+// from loop(), outside lv_task_handler().
+void serviceScreens();
+
+void getScreenStats(ScreenId id, ScreenStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCREEN_MANAGER_H
@@ -0,0 +1,23 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// The few Arduino core functions the shared network modules use
+// (reliable_udp.cpp), for the host build. Time and randomness come from the
+// running check, see sim_reliable.cpp.
+
+#include <stdint.h>
+#include <string.h>
+
+int64_t esp_timer_get_time();
+uint32_t esp_random();
+
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : (x) > (hi) ? (hi) : (x))
+
+class SimEsp {
+public:
+  uint64_t getEfuseMac() { return 0x0000A5C3D2E1F0B4ULL; }
+};
+
+static SimEsp ESP;
+
+#endif // SIM_ARDUINO_H
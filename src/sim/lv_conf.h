@@ -0,0 +1,29 @@
+// LVGL configuration for the host simulator build (env:simulator).
+// Only the settings that must match the device are listed here; everything
+// else falls back to the defaults in lv_conf_internal.h.
+
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#include <stdint.h>
+
+// Must match SquareLine Studio's export settings (checked in ui.c)
+#define LV_COLOR_DEPTH 16
+#define LV_COLOR_16_SWAP 0
+
+// Ticks are driven by the simulator so runs are reproducible
+#define LV_TICK_CUSTOM 0
+
+#define LV_DPI_DEF 130
+
+#define LV_FONT_MONTSERRAT_14 1
+#ifndef LV_FONT_MONTSERRAT_36
+#define LV_FONT_MONTSERRAT_36 1
+#endif
+#define LV_FONT_DEFAULT &lv_font_montserrat_14
+
+#define LV_USE_LOG 0
+#define LV_USE_PERF_MONITOR 0
+#define LV_USE_MEM_MONITOR 0
+
+#endif // LV_CONF_H
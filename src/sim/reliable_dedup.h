@@ -0,0 +1,63 @@
+#ifndef RELIABLE_DEDUP_H
+#define RELIABLE_DEDUP_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @class ReliableUdpDedup
+ * @brief Receiver-side duplicate filter for reliable frames.
+ *
+ * Keeps a 64-entry sliding window of recently seen sequence numbers per
+ * remote. This is the logic the scoring device (or any stand-in receiver)
+ * runs before applying a frame; it ACKs duplicates again but does not apply
+ * them. A new boot epoch from a remote starts its window over.
+ */
+class ReliableUdpDedup {
+public:
+  ReliableUdpDedup() { memset(remotes, 0, sizeof(remotes)); }
+
+  /**
+   * @brief Records a frame header.
+   * @param[in] header First word of a reliable frame.
+   * @param[in] epoch Second word of the frame.
+   * @return True if the frame is new and should be applied.
+   */
+  bool accept(uint32_t header, uint32_t epoch) {
+    Remote &r = remotes[(header >> 16) & 0xFF];
+    uint16_t seq = header & 0xFFFF;
+    if (!r.seen || r.epoch != epoch) {
+      r.seen = true; // first frame since the remote booted
+      r.epoch = epoch;
+      r.highest = seq;
+      r.mask = 1;
+      return true;
+    }
+    int16_t ahead = (int16_t)(seq - r.highest);
+    if (ahead > 0) {
+      r.mask = ahead >= 64 ? 1 : (r.mask << ahead) | 1;
+      r.highest = seq;
+      return true;
+    }
+    if (-ahead >= 64) {
+      return false; // too old to tell, treat as already applied
+    }
+    uint64_t bit = (uint64_t)1 << -ahead;
+    if (r.mask & bit) {
+      return false;
+    }
+    r.mask |= bit;
+    return true;
+  }
+
+private:
+  struct Remote {
+    bool seen;
+    uint32_t epoch;   ///< Boot epoch the window belongs to.
+    uint16_t highest; ///< Highest sequence number seen.
+    uint64_t mask;    ///< Bit n set: highest - n has been seen.
+  };
+  Remote remotes[256];
+};
+
+#endif // RELIABLE_DEDUP_H
@@ -0,0 +1,88 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <lvgl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host-side simulator of the RemoteControl UI. The SquareLine screens and
+// ui_events.c are compiled unchanged; the network and backlight functions
+// they call are replaced by the stubs in sim_stubs.cpp.
+
+#define SIM_HOR_RES 240
+#define SIM_VER_RES 320
+#define SIM_TICK_MS 5 // same step as loop() on the device
+#ifndef SIM_DRAW_BUF_DIVISOR
+#define SIM_DRAW_BUF_DIVISOR 10 // draw buffer = 1/10 screen, as on the device
+#endif
+
+typedef struct {
+  uint32_t frames;     // completed LVGL refreshes
+  uint64_t renderUs;   // wall time spent in lv_timer_handler() for them
+  uint32_t renderMaxUs;
+  uint32_t pixels;     // pixels rendered (sum of refreshed areas)
+  uint32_t flushes;    // flush_cb calls
+  uint32_t flushBytes; // bytes that would go over SPI
+} SimFrameStats;
+
+// Display: headless framebuffer, or an SDL window when built with
+// SIM_USE_SDL and started with sdl = true
+void simDisplayInit(bool sdl);
+const lv_color_t *simFramebuffer();
+void simGetFrameStats(SimFrameStats *stats);
+void simResetFrameStats();
+// Writes the framebuffer as a binary PPM image
+bool simSaveFramebuffer(const char *path);
+
+// Input: scripted pointer (headless) or the mouse (SDL)
+void simPointerSet(int16_t x, int16_t y, bool pressed);
+
+// Renders all invalidated areas immediately. Returns the wall time in us.
+uint32_t simRefreshNow();
+
+// Advances LVGL time by ms in SIM_TICK_MS steps. Returns false when the SDL
+// window has been closed.
+bool simRunFor(uint32_t ms);
+
+// Command words the UI handed to sendUDP32() and friends, with how each
+// was handed over
+#define SIM_COMMAND_URGENT 0x01 // sendUDP32Now(): ends the batching window
+#define SIM_COMMAND_ALONE 0x02  // sendUDP32Alone(): a datagram of its own
+size_t simCommandCount();
+uint32_t simCommandAt(size_t index);
+uint8_t simCommandFlags(size_t index);
+// First word of a sendUDP32Array() call: the number of words that must
+// share a datagram; 1 otherwise
+uint8_t simCommandUnitWords(size_t index);
+void simClearCommands();
+
+// Screens by name, for scripts and benchmarks
+typedef struct {
+  const char *name;
+  lv_obj_t **screen;
+  void (*init)(void);
+  void (*destroy)(void);
+} SimScreen;
+
+extern const SimScreen SIM_SCREENS[];
+extern const size_t SIM_SCREEN_COUNT;
+const SimScreen *simFindScreen(const char *name);
+void simShowScreen(const SimScreen *screen);
+
+// Per-screen render benchmark, see sim_bench.cpp
+int simRunBench(int argc, char **argv);
+
+// Clock sync against simulated drifting clocks, see sim_clock.cpp
+int simRunClock(int argc, char **argv);
+
+// Touch calibration against synthetic boards, see sim_touchcal.cpp
+int simRunTouchCal(int argc, char **argv);
+
+// Reliable delivery over a lossy link, see sim_reliable.cpp
+int simRunReliable(int argc, char **argv);
+
+// Datagrams per UI interaction with and without batching, see
+// sim_batch.cpp
+int simRunBatch(int argc, char **argv);
+
+#endif // SIM_H
@@ -0,0 +1,261 @@
+// Datagram count check for command batching.
+//
+// Usage: remote_sim --batch
+// Plays scripted interactions through commands.cpp and the send functions
+// the UI calls, then cuts the commands into datagrams the way the network
+// task does: it wakes for the first command, waits for the batching window
+// (cut short by an urgent command) and packs the ring with takeFrame() from
+// udp_batch.h. Each scenario prints one JSON line with the datagrams sent
+// with a frame of one word (before batching; a sendUDP32Array() unit still
+// goes out whole) and with the default window and frame size, the longest
+// a command waited for the window, and the number of non-batchable
+// commands that shared a datagram and of sendUDP32Array() units split over
+// two. A datagram count other than the expected one, a shared non-batchable
+// command or a split unit makes the run exit with status 1.
+
+#include "../SpscRing.h"
+#include "../commands.h"
+#include "../udp_batch.h"
+#include "../udp_queue.h"
+#include "../wifi_udp.h"
+#include "sim.h"
+#include <stdio.h>
+#include <vector>
+
+typedef enum {
+  BATCH_TAP,        // sendCommand(cmd)
+  BATCH_TIME_ENTRY, // the three words of the Set Time screen
+  BATCH_JOURNAL,    // cmd given offline, replayed on reconnect at atMs
+} BatchAction;
+
+typedef struct {
+  uint32_t atMs;
+  BatchAction action;
+  RemoteCommand cmd;
+  uint8_t times; // repeated within the same UI frame
+} BatchStep;
+
+typedef struct {
+  const char *name;
+  const BatchStep *steps;
+  size_t stepCount;
+  uint32_t expectedPackets; // with the default window and frame size
+} BatchScenario;
+
+// A command as the network task sees it
+typedef struct {
+  uint32_t atUs;
+  uint32_t value;
+  uint8_t flags;     // SIM_COMMAND_*
+  uint8_t unitWords; // see simCommandUnitWords()
+} Issued;
+
+typedef struct {
+  uint32_t packets;
+  uint32_t maxWaitUs;   // for the batching window
+  uint32_t aloneShared; // non-batchable commands sharing a datagram
+  uint32_t unitsSplit;  // sendUDP32Array() words over two datagrams
+} BatchResult;
+
+static const BatchStep SINGLE_TAPS[] = {
+    {0, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {500, BATCH_TAP, CMD_SCORE_RIGHT_PLUS, 1},
+    {1000, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {1500, BATCH_TAP, CMD_UW2F, 1},
+    {2000, BATCH_TAP, CMD_PRIO, 1},
+};
+
+// Same UI frame: a card and the touch it was given for
+static const BatchStep CARD_AND_SCORE[] = {
+    {0, BATCH_TAP, CMD_YELLOW_CARD_LEFT, 1},
+    {1, BATCH_TAP, CMD_SCORE_RIGHT_PLUS, 1},
+    {1000, BATCH_TAP, CMD_RED_CARD_RIGHT, 1},
+    {1001, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {2000, BATCH_TAP, CMD_YELLOW_CARD_RIGHT, 1},
+    {2001, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+};
+
+// Two taps within the window go out together
+static const BatchStep DOUBLE_TAP[] = {
+    {0, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {3, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {1000, BATCH_TAP, CMD_SCORE_RIGHT_PLUS, 1},
+    {1003, BATCH_TAP, CMD_SCORE_RIGHT_PLUS, 1},
+};
+
+static const BatchStep TIME_ENTRY[] = {
+    {0, BATCH_TIME_ENTRY, CMD_SET_MINUTES, 1},
+    {2000, BATCH_TIME_ENTRY, CMD_SET_MINUTES, 1},
+};
+
+// The time entry does not fit behind the taps and must not be cut
+static const BatchStep TIME_ENTRY_AFTER_TAPS[] = {
+    {0, BATCH_TAP, CMD_SCORE_LEFT_PLUS, UDP_MAX_FRAME_WORDS - 2},
+    {1, BATCH_TIME_ENTRY, CMD_SET_MINUTES, 1},
+};
+
+static const BatchStep START_STOP[] = {
+    {0, BATCH_TAP, CMD_START_STOP, 1},
+    {2000, BATCH_TAP, CMD_START_STOP, 1},
+    {4000, BATCH_TAP, CMD_START_STOP, 1},
+};
+
+// Non-batchable commands within the window of a batchable one
+static const BatchStep MIXED[] = {
+    {0, BATCH_TAP, CMD_SCORE_LEFT_PLUS, 1},
+    {1, BATCH_TAP, CMD_START_STOP, 1},
+    {1000, BATCH_TAP, CMD_YELLOW_CARD_RIGHT, 1},
+    {1001, BATCH_TAP, CMD_NEXT, 1},
+    {1002, BATCH_TAP, CMD_SCORE_RIGHT_PLUS, 1},
+};
+
+static const BatchStep JOURNAL_REPLAY_STEPS[] = {
+    {0, BATCH_JOURNAL, CMD_SCORE_LEFT_PLUS, 12},
+    {0, BATCH_JOURNAL, CMD_NEXT, 1},
+    {0, BATCH_JOURNAL, CMD_SCORE_RIGHT_PLUS, 7},
+};
+
+#define STEPS(a) a, sizeof(a) / sizeof(a[0])
+
+static const BatchScenario SCENARIOS[] = {
+    {"single_taps", STEPS(SINGLE_TAPS), 5},
+    {"card_and_score", STEPS(CARD_AND_SCORE), 3},
+    {"double_tap", STEPS(DOUBLE_TAP), 2},
+    {"time_entry", STEPS(TIME_ENTRY), 2},
+    {"time_entry_after_taps", STEPS(TIME_ENTRY_AFTER_TAPS), 2},
+    {"start_stop", STEPS(START_STOP), 3},
+    {"mixed", STEPS(MIXED), 5},
+    {"journal_replay", STEPS(JOURNAL_REPLAY_STEPS), 3},
+};
+
+// Mirrors the time entry handler in ui_events.c
+static void sendTimeEntry() {
+  uint32_t words[3] = {commandWordWithArg(CMD_SET_MINUTES, 3),
+                       commandWordWithArg(CMD_SET_SECONDS, 0),
+                       commandWordWithArg(CMD_SET_HUNDREDS, 0)};
+  sendUDP32Array(words, 3);
+}
+
+static std::vector<Issued> play(const BatchScenario &s) {
+  std::vector<Issued> issued;
+  for (size_t i = 0; i < s.stepCount; i++) {
+    const BatchStep &step = s.steps[i];
+    uint32_t atUs = step.atMs * 1000;
+    for (uint8_t n = 0; n < step.times; n++) {
+      if (step.action == BATCH_JOURNAL) {
+        // enqueueUDP32Batch() queues the replay and flushes it at once
+        uint32_t word = commandInfo(step.cmd).word;
+        uint8_t flags = SIM_COMMAND_URGENT;
+        if (!commandBatchable(word)) {
+          flags |= SIM_COMMAND_ALONE;
+        }
+        Issued cmd = {atUs, word, flags, 1};
+        issued.push_back(cmd);
+        continue;
+      }
+      simClearCommands();
+      if (step.action == BATCH_TIME_ENTRY) {
+        sendTimeEntry();
+      } else {
+        sendCommand(step.cmd);
+      }
+      for (size_t c = 0; c < simCommandCount(); c++) {
+        Issued cmd = {atUs, simCommandAt(c), simCommandFlags(c),
+                      simCommandUnitWords(c)};
+        issued.push_back(cmd);
+      }
+    }
+  }
+  simClearCommands();
+  return issued;
+}
+
+// The network task of udp_queue.cpp on a perfect link
+static BatchResult runNetworkTask(const std::vector<Issued> &issued,
+                                  uint32_t windowMs, uint32_t frameWords) {
+  static SpscRing<QueuedCommand, UDP_QUEUE_CAPACITY> ring;
+  uint32_t frame[UDP_MAX_FRAME_WORDS];
+  uint32_t enqueuedUs[UDP_MAX_FRAME_WORDS];
+  std::vector<uint32_t> packetOf(issued.size()); // by command
+  BatchResult result = {};
+
+  size_t next = 0;  // next command to queue
+  size_t taken = 0; // commands packed; the ring keeps their order
+  while (next < issued.size()) {
+    // Woken by the first command; the window ends early on an urgent one
+    uint32_t sendUs = issued[next].atUs;
+    if (windowMs > 0 && frameWords > 1) {
+      sendUs += windowMs * 1000;
+      for (size_t i = next; i < issued.size() && issued[i].atUs <= sendUs;
+           i++) {
+        if (issued[i].flags & SIM_COMMAND_URGENT) {
+          sendUs = issued[i].atUs;
+          break;
+        }
+      }
+    }
+    while (next < issued.size() && issued[next].atUs <= sendUs) {
+      // A unit is pushed in one step, as udp_queue.cpp does
+      size_t words = issued[next].unitWords > 1 ? issued[next].unitWords : 1;
+      QueuedCommand cmds[UDP_MAX_FRAME_WORDS];
+      for (size_t w = 0; w < words; w++) {
+        const Issued &c = issued[next + w];
+        cmds[w].value = c.value;
+        cmds[w].enqueuedUs = c.atUs;
+        cmds[w].flags = (c.flags & SIM_COMMAND_ALONE) ? QUEUED_ALONE : 0;
+        cmds[w].unitWords = c.unitWords;
+      }
+      if (!ring.push(cmds, words)) {
+        break; // drained below, the rest queues up behind it
+      }
+      next += words;
+    }
+
+    size_t count;
+    while ((count = takeFrame(ring, frameWords, frame, enqueuedUs)) > 0) {
+      for (size_t i = 0; i < count; i++) {
+        uint32_t waitUs = sendUs - enqueuedUs[i];
+        if (waitUs > result.maxWaitUs) {
+          result.maxWaitUs = waitUs;
+        }
+        if (count > 1 && (issued[taken].flags & SIM_COMMAND_ALONE)) {
+          result.aloneShared++;
+        }
+        packetOf[taken++] = result.packets;
+      }
+      result.packets++;
+    }
+  }
+
+  for (size_t i = 0; i < issued.size(); i++) {
+    for (size_t w = 1; w < issued[i].unitWords; w++) {
+      if (packetOf[i + w] != packetOf[i]) {
+        result.unitsSplit++;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+int simRunBatch(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+    const BatchScenario &s = SCENARIOS[i];
+    std::vector<Issued> issued = play(s);
+    BatchResult unbatched = runNetworkTask(issued, 0, 1);
+    BatchResult batched = runNetworkTask(issued, UDP_BATCH_WINDOW_MS_DEFAULT,
+                                         UDP_MAX_FRAME_WORDS);
+    printf("{\"scenario\":\"%s\",\"commands\":%u,\"packets_unbatched\":%u,"
+           "\"packets_batched\":%u,\"expected\":%u,\"max_wait_ms\":%.1f,"
+           "\"alone_shared\":%u,\"units_split\":%u}\n",
+           s.name, (unsigned)issued.size(), unbatched.packets,
+           batched.packets, s.expectedPackets, batched.maxWaitUs / 1000.0,
+           batched.aloneShared, batched.unitsSplit);
+    ok &= batched.packets == s.expectedPackets && batched.aloneShared == 0 &&
+          batched.unitsSplit == 0;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// Per-screen render benchmark.
+//
+// Usage: remote_sim --bench [--golden DIR] [--update-golden]
+// For every screen: build it, force a full refresh, then a pressed button and
+// a changed label as typical partial refreshes. Each case prints one JSON
+// line with build time, render time, invalidated area and flush bytes. The
+// full refresh is compared against DIR/<screen>.ppm; any mismatch makes the
+// run exit with status 1. Build with -D SIM_DRAW_BUF_DIVISOR=N to compare
+// draw buffer sizes.
+
+#include "../ui/ui.h"
+#include "sim.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_GOLDEN_DIR_DEFAULT "sim_golden"
+#define BENCH_MAX_PATH 256
+
+static uint64_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Depth-first search for the first descendant of the given class
+static lv_obj_t *findChild(lv_obj_t *parent, const lv_obj_class_t *cls) {
+  uint32_t count = lv_obj_get_child_cnt(parent);
+  for (uint32_t i = 0; i < count; i++) {
+    lv_obj_t *child = lv_obj_get_child(parent, i);
+    if (lv_obj_check_type(child, cls)) {
+      return child;
+    }
+    lv_obj_t *found = findChild(child, cls);
+    if (found != NULL) {
+      return found;
+    }
+  }
+  return NULL;
+}
+
+// Compares the framebuffer with a PPM written by simSaveFramebuffer().
+// Returns the number of differing pixels, or -1 if the file is unusable.
+static long compareGolden(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return -1;
+  }
+  int w = 0, h = 0, max = 0;
+  if (fscanf(f, "P6 %d %d %d", &w, &h, &max) != 3 || w != SIM_HOR_RES ||
+      h != SIM_VER_RES || fgetc(f) == EOF) {
+    fclose(f);
+    return -1;
+  }
+
+  const lv_color_t *fb = simFramebuffer();
+  long diff = 0;
+  for (size_t i = 0; i < SIM_HOR_RES * SIM_VER_RES; i++) {
+    uint8_t rgb[3];
+    if (fread(rgb, 1, sizeof(rgb), f) != sizeof(rgb)) {
+      fclose(f);
+      return -1;
+    }
+    if (rgb[0] != (uint8_t)(fb[i].ch.red << 3) ||
+        rgb[1] != (uint8_t)(fb[i].ch.green << 2) ||
+        rgb[2] != (uint8_t)(fb[i].ch.blue << 3)) {
+      diff++;
+    }
+  }
+  fclose(f);
+  return diff;
+}
+
+static void printCase(const char *screen, const char *name, uint32_t buildUs,
+                      const char *golden) {
+  SimFrameStats stats;
+  simGetFrameStats(&stats);
+  printf("{\"screen\":\"%s\",\"case\":\"%s\",\"draw_buf_divisor\":%d,"
+         "\"build_us\":%u,\"render_us\":%llu,\"pixels\":%u,\"flushes\":%u,"
+         "\"flush_bytes\":%u,\"golden\":\"%s\"}\n",
+         screen, name, SIM_DRAW_BUF_DIVISOR, buildUs,
+         (unsigned long long)stats.renderUs, stats.pixels, stats.flushes,
+         stats.flushBytes, golden);
+  simResetFrameStats();
+}
+
+int simRunBench(int argc, char **argv) {
+  const char *goldenDir = BENCH_GOLDEN_DIR_DEFAULT;
+  bool updateGolden = false;
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      goldenDir = argv[++i];
+    } else if (strcmp(argv[i], "--update-golden") == 0) {
+      updateGolden = true;
+    }
+  }
+
+  int mismatches = 0;
+  for (size_t s = 0; s < SIM_SCREEN_COUNT; s++) {
+    const SimScreen *screen = &SIM_SCREENS[s];
+
+    // Build from scratch
+    if (*screen->screen != NULL) {
+      screen->destroy();
+    }
+    uint64_t start = nowUs();
+    screen->init();
+    uint32_t buildUs = (uint32_t)(nowUs() - start);
+    lv_disp_load_scr(*screen->screen);
+
+    // Full refresh
+    simRefreshNow();
+    simResetFrameStats();
+    lv_obj_invalidate(*screen->screen);
+    simRefreshNow();
+
+    char path[BENCH_MAX_PATH];
+    char golden[32];
+    snprintf(path, sizeof(path), "%s/%s.ppm", goldenDir, screen->name);
+    if (updateGolden) {
+      snprintf(golden, sizeof(golden), "%s",
+               simSaveFramebuffer(path) ? "updated" : "write-failed");
+    } else {
+      long diff = compareGolden(path);
+      if (diff < 0) {
+        snprintf(golden, sizeof(golden), "missing");
+      } else if (diff == 0) {
+        snprintf(golden, sizeof(golden), "match");
+      } else {
+        snprintf(golden, sizeof(golden), "mismatch:%ld", diff);
+        mismatches++;
+      }
+    }
+    printCase(screen->name, "full", buildUs, golden);
+
+    // Pressed button
+    lv_obj_t *button = findChild(*screen->screen, &lv_btn_class);
+    if (button == NULL) {
+      button = findChild(*screen->screen, &lv_imgbtn_class);
+    }
+    if (button != NULL) {
+      lv_obj_add_state(button, LV_STATE_PRESSED);
+      simRefreshNow();
+      printCase(screen->name, "button_pressed", 0, "-");
+      lv_obj_clear_state(button, LV_STATE_PRESSED);
+      simRefreshNow();
+      simResetFrameStats();
+    }
+
+    // Changed label
+    lv_obj_t *label = findChild(*screen->screen, &lv_label_class);
+    if (label != NULL) {
+      lv_label_set_text(label, "88");
+      simRefreshNow();
+      printCase(screen->name, "label_changed", 0, "-");
+    }
+  }
+
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Clock sync check against simulated drifting clocks.
+//
+// Usage: remote_sim --clock [--seed N]
+// Runs the estimator of clock_sync.h the way liveness.cpp feeds it: one
+// probe a second over a path with jitter, loss and asymmetry, against a
+// device clock with a fixed drift that starts just before its 32-bit ms
+// counter wraps. The device time is queried every 10 ms, as the scoreboard
+// timer does. Each scenario prints one JSON line with the largest error,
+// the largest error bound once the drift baseline is complete, and the
+// number of queries whose error exceeded their bound; any violation makes
+// the run exit with status 1.
+
+#include "../clock_sync.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLOCK_RUN_S 600
+#define CLOCK_PROBE_US 1000000
+#define CLOCK_QUERY_US 10000
+#define CLOCK_TIMEOUT_US 500000 // LIVENESS_TIMEOUT_MS: later echoes are lost
+#define CLOCK_WARMUP_US \
+  ((int64_t)CLOCK_SYNC_BUCKETS * CLOCK_SYNC_BUCKET_SAMPLES * CLOCK_PROBE_US)
+
+typedef struct {
+  const char *name;
+  int32_t driftPpm;
+  uint32_t upUs;     // one-way delay floor, ping
+  uint32_t downUs;   // one-way delay floor, echo
+  uint32_t jitterUs; // largest extra delay, heavy-tailed
+  uint32_t lossPct;  // per direction
+  int64_t restartUs; // device restarts (clock jumps) here, 0 for never
+} ClockScenario;
+
+static const ClockScenario SCENARIOS[] = {
+    {"lan", 30, 1000, 1000, 4000, 1, 0},
+    {"fast_crystal", CLOCK_SYNC_MAX_DRIFT_PPM, 2000, 2000, 20000, 5, 0},
+    {"slow_asymmetric", -80, 1000, 15000, 30000, 10, 0},
+    {"busy_ap", 50, 3000, 3000, 150000, 20, 0},
+    {"device_restart", 50, 1000, 1000, 4000, 1, 300000000},
+};
+
+static uint64_t rngState;
+
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState >> 16);
+}
+
+// Uniform in [0, 1)
+static double uniform() { return (rng() & 0xFFFFFF) / 16777216.0; }
+
+// Most packets are fast, a few take up to the full jitter
+static uint32_t delayUs(uint32_t floorUs, uint32_t jitterUs) {
+  double u = uniform();
+  return floorUs + (uint32_t)(jitterUs * u * u * u);
+}
+
+// True device clock in us at local time t, not wrapped
+static int64_t deviceUsAt(const ClockScenario &s, int64_t t) {
+  // Starts 30 s before the ms counter wraps, 0 again after a restart
+  int64_t origin = ((int64_t)UINT32_MAX + 1 - 30000) * 1000;
+  if (s.restartUs > 0 && t >= s.restartUs) {
+    origin = 0;
+    t -= s.restartUs;
+  }
+  return origin + t + t * s.driftPpm / 1000000;
+}
+
+static bool runScenario(const ClockScenario &s) {
+  ClockSync sync;
+  clockSyncReset(&sync);
+  uint32_t probes = 0, samples = 0, queries = 0, blind = 0, violations = 0;
+  uint32_t maxBound = 0;
+  int64_t maxError = 0, restartSeen = -1;
+  double sumError = 0;
+
+  for (int64_t probe = 0; probe < (int64_t)CLOCK_RUN_S * 1000000;
+       probe += CLOCK_PROBE_US) {
+    // The echo of this probe, if any, arrives before the next one
+    probes++;
+    uint32_t up = delayUs(s.upUs, s.jitterUs);
+    uint32_t down = delayUs(s.downUs, s.jitterUs);
+    bool echoed = rng() % 100 >= s.lossPct && rng() % 100 >= s.lossPct &&
+                  up + down <= CLOCK_TIMEOUT_US;
+    int64_t received = probe + up + down;
+
+    for (int64_t t = probe; t < probe + CLOCK_PROBE_US; t += CLOCK_QUERY_US) {
+      if (echoed && received <= t && received > t - CLOCK_QUERY_US) {
+        int64_t device = deviceUsAt(s, probe + up);
+        clockSyncAddSample(&sync, probe, received,
+                           (uint32_t)(device / 1000));
+        samples++;
+        if (s.restartUs > 0 && probe >= s.restartUs && restartSeen < 0) {
+          restartSeen = received;
+        }
+      }
+      int64_t estimate;
+      uint32_t bound;
+      if (!clockSyncDeviceTime(&sync, t, &estimate, &bound)) {
+        continue;
+      }
+      // Between the jump and the first echo after it nothing can tell
+      if (s.restartUs > 0 && t >= s.restartUs && restartSeen < 0) {
+        blind++;
+        continue;
+      }
+      int64_t truth = deviceUsAt(s, t);
+      if (s.restartUs > 0 && t >= s.restartUs) {
+        // The estimator unwraps from its first sample, i.e. modulo 2^32 ms
+        const int64_t wrapUs = ((int64_t)UINT32_MAX + 1) * 1000;
+        truth += (estimate - truth + wrapUs / 2) / wrapUs * wrapUs;
+      }
+      int64_t error = estimate > truth ? estimate - truth : truth - estimate;
+      queries++;
+      sumError += error;
+      if (error > maxError) {
+        maxError = error;
+      }
+      if (error > bound) {
+        violations++;
+      }
+      bool warm = t >= CLOCK_WARMUP_US &&
+                  (restartSeen < 0 || t >= restartSeen + CLOCK_WARMUP_US);
+      if (warm && bound > maxBound) {
+        maxBound = bound;
+      }
+    }
+  }
+
+  printf("{\"scenario\":\"%s\",\"drift_ppm\":%d,\"probes\":%u,"
+         "\"samples\":%u,\"queries\":%u,\"blind_queries\":%u,"
+         "\"avg_error_us\":%.0f,\"max_error_us\":%lld,"
+         "\"max_bound_us\":%u,\"est_drift_ppb\":%d,"
+         "\"drift_error_ppb\":%u,\"steps\":%u,\"violations\":%u}\n",
+         s.name, s.driftPpm, probes, samples, queries, blind,
+         queries ? sumError / queries : 0.0, (long long)maxError, maxBound,
+         sync.driftPpb, sync.driftErrorPpb, sync.steps, violations);
+  return violations == 0;
+}
+
+int simRunClock(int argc, char **argv) {
+  rngState = 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--seed") == 0) {
+      rngState ^= strtoull(argv[++i], NULL, 0);
+    }
+  }
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+    ok &= runScenario(SCENARIOS[i]);
+  }
+  return ok ? 0 : 1;
+}
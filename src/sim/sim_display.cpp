@@ -0,0 +1,224 @@
+#include "sim.h"
+#include "../ui/ui.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef SIM_USE_SDL
+#include <SDL2/SDL.h>
+#endif
+
+static lv_color_t framebuffer[SIM_HOR_RES * SIM_VER_RES];
+static lv_color_t draw_buf_1[SIM_HOR_RES * SIM_VER_RES / SIM_DRAW_BUF_DIVISOR];
+static lv_disp_draw_buf_t disp_draw_buf;
+static lv_disp_drv_t disp_drv;
+static lv_indev_drv_t indev_drv;
+
+static SimFrameStats frameStats;
+
+static int16_t pointerX = 0;
+static int16_t pointerY = 0;
+static bool pointerPressed = false;
+
+#ifdef SIM_USE_SDL
+static bool useSdl = false;
+static SDL_Window *window = NULL;
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *texture = NULL;
+#endif
+
+static uint64_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sim_disp_flush(lv_disp_drv_t *drv, const lv_area_t *area,
+                           lv_color_t *color_p) {
+  int32_t w = area->x2 - area->x1 + 1;
+  for (int32_t y = area->y1; y <= area->y2; y++) {
+    memcpy(&framebuffer[y * SIM_HOR_RES + area->x1],
+           &color_p[(y - area->y1) * w], w * sizeof(lv_color_t));
+  }
+  frameStats.flushes++;
+  frameStats.flushBytes += lv_area_get_size(area) * sizeof(lv_color_t);
+
+#ifdef SIM_USE_SDL
+  if (useSdl && lv_disp_flush_is_last(drv)) {
+    SDL_UpdateTexture(texture, NULL, framebuffer,
+                      SIM_HOR_RES * sizeof(lv_color_t));
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+  }
+#endif
+
+  lv_disp_flush_ready(drv);
+}
+
+static void sim_disp_monitor(lv_disp_drv_t *drv, uint32_t time_ms,
+                             uint32_t px) {
+  (void)drv;
+  (void)time_ms; // LVGL ticks do not advance while rendering here
+  frameStats.frames++;
+  frameStats.pixels += px;
+}
+
+static void sim_pointer_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+  (void)drv;
+  data->point.x = pointerX;
+  data->point.y = pointerY;
+  data->state = pointerPressed ? LV_INDEV_STATE_PRESSED
+                               : LV_INDEV_STATE_RELEASED;
+}
+
+void simDisplayInit(bool sdl) {
+  lv_init();
+
+#ifdef SIM_USE_SDL
+  useSdl = sdl;
+  if (useSdl) {
+    SDL_Init(SDL_INIT_VIDEO);
+    window = SDL_CreateWindow("RemoteControl", SDL_WINDOWPOS_UNDEFINED,
+                              SDL_WINDOWPOS_UNDEFINED, SIM_HOR_RES * 2,
+                              SIM_VER_RES * 2, 0);
+    renderer = SDL_CreateRenderer(window, -1, 0);
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565,
+                                SDL_TEXTUREACCESS_STATIC, SIM_HOR_RES,
+                                SIM_VER_RES);
+  }
+#else
+  if (sdl) {
+    fprintf(stderr, "sim: built without SIM_USE_SDL, running headless\n");
+  }
+#endif
+
+  lv_disp_draw_buf_init(&disp_draw_buf, draw_buf_1, NULL,
+                        SIM_HOR_RES * SIM_VER_RES / SIM_DRAW_BUF_DIVISOR);
+  lv_disp_drv_init(&disp_drv);
+  disp_drv.hor_res = SIM_HOR_RES;
+  disp_drv.ver_res = SIM_VER_RES;
+  disp_drv.flush_cb = sim_disp_flush;
+  disp_drv.monitor_cb = sim_disp_monitor;
+  disp_drv.draw_buf = &disp_draw_buf;
+  lv_disp_drv_register(&disp_drv);
+
+  lv_indev_drv_init(&indev_drv);
+  indev_drv.type = LV_INDEV_TYPE_POINTER;
+  indev_drv.read_cb = sim_pointer_read;
+  lv_indev_drv_register(&indev_drv);
+}
+
+const lv_color_t *simFramebuffer() { return framebuffer; }
+
+void simGetFrameStats(SimFrameStats *stats) { *stats = frameStats; }
+
+void simResetFrameStats() { memset(&frameStats, 0, sizeof(frameStats)); }
+
+bool simSaveFramebuffer(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", SIM_HOR_RES, SIM_VER_RES);
+  for (size_t i = 0; i < SIM_HOR_RES * SIM_VER_RES; i++) {
+    uint8_t rgb[3] = {(uint8_t)(framebuffer[i].ch.red << 3),
+                      (uint8_t)(framebuffer[i].ch.green << 2),
+                      (uint8_t)(framebuffer[i].ch.blue << 3)};
+    fwrite(rgb, 1, sizeof(rgb), f);
+  }
+  fclose(f);
+  return true;
+}
+
+void simPointerSet(int16_t x, int16_t y, bool pressed) {
+  pointerX = x;
+  pointerY = y;
+  pointerPressed = pressed;
+}
+
+uint32_t simRefreshNow() {
+  uint64_t start = nowUs();
+  lv_refr_now(NULL);
+  uint32_t spent = (uint32_t)(nowUs() - start);
+  frameStats.renderUs += spent;
+  if (spent > frameStats.renderMaxUs) {
+    frameStats.renderMaxUs = spent;
+  }
+  return spent;
+}
+
+bool simRunFor(uint32_t ms) {
+  for (uint32_t elapsed = 0; elapsed < ms; elapsed += SIM_TICK_MS) {
+#ifdef SIM_USE_SDL
+    if (useSdl) {
+      SDL_Event event;
+      while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+          return false;
+        }
+      }
+      int x, y;
+      uint32_t buttons = SDL_GetMouseState(&x, &y);
+      simPointerSet(x / 2, y / 2, buttons & SDL_BUTTON(SDL_BUTTON_LEFT));
+    }
+#endif
+
+    uint32_t framesBeforeStep = frameStats.frames;
+    uint64_t start = nowUs();
+    lv_timer_handler();
+    uint32_t spent = (uint32_t)(nowUs() - start);
+    if (frameStats.frames != framesBeforeStep) {
+      frameStats.renderUs += spent;
+      if (spent > frameStats.renderMaxUs) {
+        frameStats.renderMaxUs = spent;
+      }
+    }
+    lv_tick_inc(SIM_TICK_MS);
+
+#ifdef SIM_USE_SDL
+    if (useSdl) {
+      SDL_Delay(SIM_TICK_MS);
+    }
+#endif
+  }
+  return true;
+}
+
+const SimScreen SIM_SCREENS[] = {
+    {"Central", &ui_Central_Screen, ui_Central_Screen_screen_init,
+     ui_Central_Screen_screen_destroy},
+    {"Basic_Settings", &ui_Basic_Settings_Screen,
+     ui_Basic_Settings_Screen_screen_init,
+     ui_Basic_Settings_Screen_screen_destroy},
+    {"No_Connection", &ui_No_Connection_Screen,
+     ui_No_Connection_Screen_screen_init,
+     ui_No_Connection_Screen_screen_destroy},
+    {"Cards", &ui_Cards_Screen, ui_Cards_Screen_screen_init,
+     ui_Cards_Screen_screen_destroy},
+    {"SpecificSettings", &ui_SpecificSettingsScreen,
+     ui_SpecificSettingsScreen_screen_init,
+     ui_SpecificSettingsScreen_screen_destroy},
+    {"Cyrano", &ui_Cyrano_Screen, ui_Cyrano_Screen_screen_init,
+     ui_Cyrano_Screen_screen_destroy},
+    {"Set_Time", &ui_Set_Time_Screen, ui_Set_Time_Screen_screen_init,
+     ui_Set_Time_Screen_screen_destroy},
+    {"Power_Settings", &ui_Power_Settings_Screen,
+     ui_Power_Settings_Screen_screen_init,
+     ui_Power_Settings_Screen_screen_destroy},
+};
+const size_t SIM_SCREEN_COUNT = sizeof(SIM_SCREENS) / sizeof(SIM_SCREENS[0]);
+
+const SimScreen *simFindScreen(const char *name) {
+  for (size_t i = 0; i < SIM_SCREEN_COUNT; i++) {
+    if (strcmp(SIM_SCREENS[i].name, name) == 0) {
+      return &SIM_SCREENS[i];
+    }
+  }
+  return NULL;
+}
+
+void simShowScreen(const SimScreen *screen) {
+  _ui_screen_change(screen->screen, LV_SCR_LOAD_ANIM_NONE, 0, 0,
+                    screen->init);
+}
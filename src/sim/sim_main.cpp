@@ -0,0 +1,129 @@
+// Host simulator entry point.
+//
+// Usage: remote_sim [--sdl] [step ...]
+//        remote_sim --bench [--golden DIR] [--update-golden]
+//        remote_sim --clock [--seed N]
+//        remote_sim --touchcal [--seed N]
+//        remote_sim --reliable [--seed N]
+//        remote_sim --batch
+//   screen:NAME   load a screen (Central, Cards, Cyrano, Set_Time, ...)
+//   tap:X,Y       press for 60 ms and release
+//   long:X,Y      press for 800 ms and release
+//   wait:MS       let LVGL run
+//   dump:FILE     write the framebuffer as a PPM image
+// Every step prints one JSON line with the frames rendered, render time,
+// rendered pixels, flush bytes and the command words the UI emitted.
+// Without steps and with --sdl the UI runs interactively until the window
+// is closed. --bench runs the per-screen render benchmark instead, --clock
+// the clock sync check, --touchcal the touch calibration check,
+// --reliable the lossy link check and --batch the datagram count check
+// (no display needed).
+
+#include "../ui/ui.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_TAP_MS 60
+#define SIM_LONG_PRESS_MS 800
+#define SIM_SETTLE_MS 100
+
+static void printStep(const char *step) {
+  SimFrameStats stats;
+  simGetFrameStats(&stats);
+  printf("{\"step\":\"%s\",\"frames\":%u,\"render_us\":%llu,"
+         "\"render_max_us\":%u,\"pixels\":%u,\"flushes\":%u,"
+         "\"flush_bytes\":%u,\"commands\":[",
+         step, stats.frames, (unsigned long long)stats.renderUs,
+         stats.renderMaxUs, stats.pixels, stats.flushes, stats.flushBytes);
+  for (size_t i = 0; i < simCommandCount(); i++) {
+    printf("%s\"0x%08X\"", i ? "," : "", simCommandAt(i));
+  }
+  printf("]}\n");
+  simResetFrameStats();
+  simClearCommands();
+}
+
+static void press(int16_t x, int16_t y, uint32_t holdMs) {
+  simPointerSet(x, y, true);
+  simRunFor(holdMs);
+  simPointerSet(x, y, false);
+  simRunFor(SIM_SETTLE_MS);
+}
+
+static bool runStep(const char *step) {
+  int x, y;
+  if (strncmp(step, "screen:", 7) == 0) {
+    const SimScreen *screen = simFindScreen(step + 7);
+    if (screen == NULL) {
+      fprintf(stderr, "sim: unknown screen '%s'\n", step + 7);
+      return false;
+    }
+    simShowScreen(screen);
+    simRunFor(SIM_SETTLE_MS);
+  } else if (sscanf(step, "tap:%d,%d", &x, &y) == 2) {
+    press(x, y, SIM_TAP_MS);
+  } else if (sscanf(step, "long:%d,%d", &x, &y) == 2) {
+    press(x, y, SIM_LONG_PRESS_MS);
+  } else if (strncmp(step, "wait:", 5) == 0) {
+    simRunFor(atoi(step + 5));
+  } else if (strncmp(step, "dump:", 5) == 0) {
+    if (!simSaveFramebuffer(step + 5)) {
+      fprintf(stderr, "sim: cannot write '%s'\n", step + 5);
+      return false;
+    }
+  } else {
+    fprintf(stderr, "sim: unknown step '%s'\n", step);
+    return false;
+  }
+  printStep(step);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--clock") == 0) {
+    return simRunClock(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--touchcal") == 0) {
+    return simRunTouchCal(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--reliable") == 0) {
+    return simRunReliable(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+    return simRunBatch(argc - 2, argv + 2);
+  }
+
+  bool sdl = false;
+  int first = 1;
+  if (argc > 1 && strcmp(argv[1], "--sdl") == 0) {
+    sdl = true;
+    first = 2;
+  }
+
+  bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+  simDisplayInit(sdl);
+  ui_init();
+  simRunFor(SIM_SETTLE_MS);
+  if (bench) {
+    return simRunBench(argc - 2, argv + 2);
+  }
+  printStep("boot");
+
+  for (int i = first; i < argc; i++) {
+    if (!runStep(argv[i])) {
+      return 1;
+    }
+  }
+
+  if (sdl && first == argc) {
+    while (simRunFor(SIM_TICK_MS)) {
+      if (simCommandCount() > 0) {
+        printStep("interactive");
+      }
+    }
+  }
+  return 0;
+}
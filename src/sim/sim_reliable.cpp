@@ -0,0 +1,235 @@
+// Reliable delivery check over a lossy link.
+//
+// Usage: remote_sim --reliable [--seed N]
+// Runs the sender of reliable_udp.cpp, unchanged, against a stand-in
+// scoring device that filters duplicates with ReliableUdpDedup and ACKs
+// every frame. Each direction of the link loses packets at the scenario's
+// rate and delays them by a heavy-tailed amount. Commands are given at UI
+// pace, one per frame. Each scenario prints one JSON line with the share
+// of commands applied and the command-to-apply latency (p50, p99, max);
+// a command applied twice, a delivery rate under the scenario's minimum,
+// or a remote reboot that the device mistakes for retransmissions makes
+// the run exit with status 1.
+
+#include "../reliable_udp.h"
+#include "../udp_queue.h"
+#include "../wifi_udp.h"
+#include "reliable_dedup.h"
+#include "sim.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define RELIABLE_COMMANDS 1000
+#define RELIABLE_GAP_MIN_US 20000 // between commands
+#define RELIABLE_GAP_MAX_US 200000
+#define RELIABLE_DELAY_US 2000   // one-way delay floor
+#define RELIABLE_JITTER_US 30000 // largest extra delay
+#define RELIABLE_COMMAND_TAG 0x06000000
+
+typedef struct {
+  const char *name;
+  uint32_t lossPct;          // per direction
+  uint32_t minDeliveryPermille;
+} ReliableScenario;
+
+static const ReliableScenario SCENARIOS[] = {
+    {"loss_5", 5, 995},
+    {"loss_20", 20, 990},
+    {"loss_50", 50, 800},
+};
+
+typedef struct {
+  int64_t atUs;
+  bool toDevice;
+  size_t count;
+  uint32_t words[UDP_MAX_DATAGRAM_WORDS];
+} SimPacket;
+
+static uint64_t rngState;
+static int64_t nowUs = 0;
+static const ReliableScenario *link = NULL;
+static std::vector<SimPacket> inFlight;
+
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState >> 16);
+}
+
+// Uniform in [0, 1)
+static double uniform() { return (rng() & 0xFFFFFF) / 16777216.0; }
+
+int64_t esp_timer_get_time() { return nowUs; }
+
+uint32_t esp_random() { return rng() ^ (rng() << 16); }
+
+// Puts a packet on the link, or loses it
+static void sendPacket(bool toDevice, const uint32_t *words, size_t count) {
+  if (rng() % 100 < link->lossPct) {
+    return;
+  }
+  SimPacket p;
+  double u = uniform();
+  p.atUs = nowUs + RELIABLE_DELAY_US +
+           (int64_t)(RELIABLE_JITTER_US * u * u * u);
+  p.toDevice = toDevice;
+  p.count = count;
+  memcpy(p.words, words, count * sizeof(uint32_t));
+  inFlight.push_back(p);
+}
+
+// The remote's side of the link, called by reliable_udp.cpp
+bool transmitUDP32Array(const uint32_t *values, size_t count) {
+  sendPacket(true, values, count);
+  return true;
+}
+
+static bool popDuePacket(SimPacket *packet) {
+  for (size_t i = 0; i < inFlight.size(); i++) {
+    if (inFlight[i].atUs <= nowUs) {
+      *packet = inFlight[i];
+      inFlight.erase(inFlight.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+static int64_t nextPacketUs() {
+  int64_t next = INT64_MAX;
+  for (size_t i = 0; i < inFlight.size(); i++) {
+    next = std::min(next, inFlight[i].atUs);
+  }
+  return next;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, uint32_t pct) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * pct / 100];
+}
+
+static bool runScenario(const ReliableScenario &s, ReliableUdpDedup &device) {
+  link = &s;
+  inFlight.clear();
+  resetReliableUDPStats();
+
+  std::vector<int64_t> issuedUs(RELIABLE_COMMANDS);
+  std::vector<uint32_t> applyCount(RELIABLE_COMMANDS, 0);
+  std::vector<uint32_t> latencies;
+  int64_t t = nowUs;
+  for (size_t i = 0; i < RELIABLE_COMMANDS; i++) {
+    t += RELIABLE_GAP_MIN_US +
+         rng() % (RELIABLE_GAP_MAX_US - RELIABLE_GAP_MIN_US);
+    issuedUs[i] = t;
+  }
+
+  size_t issued = 0; // commands given by the user so far
+  size_t queued = 0; // ... handed to sendReliableUDP()
+  for (;;) {
+    SimPacket p;
+    while (popDuePacket(&p)) {
+      if (!p.toDevice) {
+        onReliableUDPAck(p.words[0]);
+        continue;
+      }
+      uint32_t ack = RELIABLE_UDP_ACK_TAG | (p.words[0] & 0x00FFFFFF);
+      sendPacket(false, &ack, 1);
+      if (!device.accept(p.words[0], p.words[1])) {
+        continue;
+      }
+      for (size_t w = RELIABLE_UDP_HEADER_WORDS; w < p.count; w++) {
+        uint32_t index = p.words[w] & 0xFFFF;
+        if (applyCount[index]++ == 0) {
+          latencies.push_back((uint32_t)(nowUs - issuedUs[index]));
+        }
+      }
+    }
+    while (issued < RELIABLE_COMMANDS && issuedUs[issued] <= nowUs) {
+      issued++;
+    }
+
+    // The network task: ACKs and retransmissions first, then new frames
+    // while the window has room
+    uint32_t nextMs = serviceReliableUDP();
+    while (queued < issued && reliableUDPWindowFree() > 0) {
+      uint32_t word = RELIABLE_COMMAND_TAG | (uint32_t)queued;
+      sendReliableUDP(&word, 1);
+      queued++;
+      nextMs = serviceReliableUDP();
+    }
+
+    int64_t next = nextPacketUs();
+    if (issued < RELIABLE_COMMANDS) {
+      next = std::min(next, issuedUs[issued]);
+    }
+    if (nextMs != RELIABLE_UDP_IDLE) {
+      next = std::min(next, nowUs + (int64_t)nextMs * 1000);
+    }
+    if (next == INT64_MAX) {
+      break; // everything given, delivered or abandoned
+    }
+    nowUs = std::max(next, nowUs + 1);
+  }
+
+  uint32_t delivered = 0;
+  uint32_t doubles = 0;
+  for (size_t i = 0; i < RELIABLE_COMMANDS; i++) {
+    delivered += applyCount[i] > 0;
+    doubles += applyCount[i] > 1;
+  }
+  ReliableUdpStats stats;
+  getReliableUDPStats(&stats);
+  uint32_t permille = delivered * 1000 / RELIABLE_COMMANDS;
+  uint32_t maxUs = latencies.empty() ? 0 : percentile(latencies, 100);
+  printf("{\"scenario\":\"%s\",\"loss_pct\":%u,\"commands\":%d,"
+         "\"delivered_permille\":%u,\"min_permille\":%u,\"applied_twice\":%u,"
+         "\"retransmits\":%u,\"lost\":%u,\"p50_ms\":%.1f,\"p99_ms\":%.1f,"
+         "\"max_ms\":%.1f}\n",
+         s.name, s.lossPct, RELIABLE_COMMANDS, permille,
+         s.minDeliveryPermille, doubles, stats.retransmits, stats.lost,
+         percentile(latencies, 50) / 1000.0,
+         percentile(latencies, 99) / 1000.0, maxUs / 1000.0);
+  return doubles == 0 && permille >= s.minDeliveryPermille;
+}
+
+// Frames from a rebooted remote repeat sequence numbers the device has
+// already applied; the new epoch must make them count as new
+static bool checkReboot() {
+  ReliableUdpDedup device;
+  const uint32_t header = RELIABLE_UDP_FRAME_TAG | 0x2A0000;
+  uint32_t applied = 0;
+  uint32_t duplicatesApplied = 0;
+  for (uint32_t epoch = 1; epoch <= 2; epoch++) {
+    for (uint32_t seq = 0; seq < 10; seq++) {
+      applied += device.accept(header | seq, epoch * 0x9E3779B1);
+      duplicatesApplied += device.accept(header | seq, epoch * 0x9E3779B1);
+    }
+  }
+  printf("{\"scenario\":\"remote_reboot\",\"applied\":%u,\"expected\":20,"
+         "\"duplicates_applied\":%u}\n",
+         applied, duplicatesApplied);
+  return applied == 20 && duplicatesApplied == 0;
+}
+
+int simRunReliable(int argc, char **argv) {
+  rngState = 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--seed") == 0) {
+      rngState ^= strtoull(argv[++i], NULL, 0);
+    }
+  }
+  setReliableUDP(true);
+  ReliableUdpDedup device; // one device for the whole run, like a piste
+  bool ok = checkReboot();
+  for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+    ok &= runScenario(SCENARIOS[i], device);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Stand-ins for the device-only functions the UI calls. Commands are
+// recorded instead of sent so that scripts can check what each interaction
+// emits.
+
+#include "../backlight.h"
+#include "../logger.h"
+#include "../ui/ui.h"
+#include "../udp_queue.h"
+#include "../wifi_udp.h"
+#include "sim.h"
+#include <stdio.h>
+#include <vector>
+
+int PisteNr = 1;
+
+struct SimCommand {
+  uint32_t value;
+  uint8_t flags;     // SIM_COMMAND_*
+  uint8_t unitWords; // see simCommandUnitWords()
+};
+
+static std::vector<SimCommand> commands;
+
+static bool recordCommand(uint32_t value, uint8_t flags, uint8_t unitWords) {
+  SimCommand cmd = {value, flags, unitWords};
+  commands.push_back(cmd);
+  return true;
+}
+
+bool sendUDP32(uint32_t value) { return recordCommand(value, 0, 1); }
+
+bool sendUDP32Now(uint32_t value) {
+  return recordCommand(value, SIM_COMMAND_URGENT, 1);
+}
+
+bool sendUDP32Alone(uint32_t value) {
+  return recordCommand(value, SIM_COMMAND_URGENT | SIM_COMMAND_ALONE, 1);
+}
+
+bool sendUDP32Array(uint32_t *values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    recordCommand(values[i], 0, i == 0 ? (uint8_t)count : 1);
+  }
+  return true;
+}
+
+// reliable_udp.cpp: nothing to wake, the checks drive the sender directly
+void notifyUDPQueue() {}
+void logWrite(uint8_t level, const char *fmt, uint8_t argc, ...) {
+  (void)level;
+  (void)fmt;
+  (void)argc;
+}
+
+void SetPiste(int pisteNr) { printf("sim: SetPiste(%d)\n", pisteNr); }
+
+// Lives in main.cpp on the device
+extern "C" void setPisteNumberText(const char *number) {
+  if (ui_LabelPisteID != NULL) {
+    lv_label_set_text_fmt(ui_LabelPisteID, "Piste %s", number);
+  }
+}
+
+size_t simCommandCount() { return commands.size(); }
+
+uint32_t simCommandAt(size_t index) { return commands[index].value; }
+
+uint8_t simCommandFlags(size_t index) { return commands[index].flags; }
+
+uint8_t simCommandUnitWords(size_t index) {
+  return commands[index].unitWords;
+}
+
+void simClearCommands() { commands.clear(); }
+
+// Backlight
+static uint8_t defaultBrightness = DEFAULT_BRIGHTNESS_DEFAULT;
+static uint8_t idleBrightness = IDLE_BRIGHTNESS_DEFAULT;
+static uint32_t backlightTimeoutMs = BACKLIGHT_TIMEOUT_MS_DEFAULT;
+
+void setBrightness(uint8_t value) { (void)value; }
+void initBacklight() {}
+uint32_t updateBacklightTimer() { return UINT32_MAX; }
+void resetBacklightTimer() {}
+bool backlightDimmed() { return false; }
+bool backlightLitInLightSleep() { return false; }
+void onTouchEvent(lv_event_t *e) { (void)e; }
+void setDefaultBrightness(uint8_t brightness) { defaultBrightness = brightness; }
+void setIdleBrightness(uint8_t brightness) { idleBrightness = brightness; }
+void setBacklightTimeout(uint32_t timeoutMs) { backlightTimeoutMs = timeoutMs; }
+uint8_t getDefaultBrightness() { return defaultBrightness; }
+uint8_t getIdleBrightness() { return idleBrightness; }
+uint32_t getBacklightTimeout() { return backlightTimeoutMs; }
@@ -0,0 +1,251 @@
+// Touch calibration check against synthetic boards.
+//
+// Usage: remote_sim --touchcal [--seed N]
+// Each board is a random affine panel model (gain, offset, rotation and
+// skew of the touch panel against the display, as CYD boards vary). For
+// every display rotation the calibration is solved from three touches on
+// the crosshairs of the calibration screen, with noise on the raw samples,
+// and the mapping error is measured over a grid covering the whole screen,
+// edges included. Each scenario prints one JSON line with the largest and
+// average error; a scenario over its limit, or a default calibration that
+// differs from the old map() chain by more than a pixel, makes the run exit
+// with status 1.
+
+#include "../touch_calibration.h"
+#include "sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOUCHCAL_BOARDS 200
+#define TOUCHCAL_GRID_PX 4
+#define TOUCHCAL_NATIVE_W SIM_HOR_RES
+#define TOUCHCAL_NATIVE_H SIM_VER_RES
+
+typedef struct {
+  const char *name;
+  double gainSpread;   // relative, around the nominal raw range
+  double offsetSpread; // raw units
+  double angleDeg;     // panel rotation against the display
+  double skewDeg;
+  int32_t noiseRaw; // largest error of a calibration touch, raw units
+  double maxErrorPx;
+} TouchCalScenario;
+
+static const TouchCalScenario SCENARIOS[] = {
+    {"exact", 0.0, 0.0, 0.0, 0.0, 0, 1.0},
+    {"board_spread", 0.15, 250.0, 1.0, 0.5, 0, 1.0},
+    {"rotated_panel", 0.15, 250.0, 4.0, 2.0, 0, 1.0},
+    {"typical_touch", 0.15, 250.0, 1.0, 0.5, 6, 4.0},
+    {"shaky_touch", 0.15, 250.0, 1.0, 0.5, 16, 8.0},
+};
+
+// Raw = panel model applied to native display coordinates
+typedef struct {
+  double xx, xy, x0;
+  double yx, yy, y0;
+} PanelModel;
+
+static uint64_t rngState;
+
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState >> 16);
+}
+
+// Uniform in [-1, 1]
+static double symmetric() { return (rng() & 0xFFFFFF) / 8388607.5 - 1.0; }
+
+static PanelModel randomPanel(const TouchCalScenario &s) {
+  // Nominal: the raw bounds of the default calibration
+  double gainX = (TOUCH_CAL_DEFAULT_MAX_X - TOUCH_CAL_DEFAULT_MIN_X) /
+                 (double)(TOUCHCAL_NATIVE_W - 1);
+  double gainY = (TOUCH_CAL_DEFAULT_MAX_Y - TOUCH_CAL_DEFAULT_MIN_Y) /
+                 (double)(TOUCHCAL_NATIVE_H - 1);
+  gainX *= 1.0 + s.gainSpread * symmetric();
+  gainY *= 1.0 + s.gainSpread * symmetric();
+  double angle = s.angleDeg * symmetric() * M_PI / 180.0;
+  double skew = tan(s.skewDeg * symmetric() * M_PI / 180.0);
+
+  PanelModel m;
+  m.xx = gainX * cos(angle);
+  m.xy = -gainX * sin(angle) + gainX * skew;
+  m.yx = gainY * sin(angle);
+  m.yy = gainY * cos(angle);
+  // Centre the panel on the raw range, then shift it
+  double cx = (TOUCHCAL_NATIVE_W - 1) / 2.0;
+  double cy = (TOUCHCAL_NATIVE_H - 1) / 2.0;
+  m.x0 = 2048 - (m.xx * cx + m.xy * cy) + s.offsetSpread * symmetric();
+  m.y0 = 2048 - (m.yx * cx + m.yy * cy) + s.offsetSpread * symmetric();
+  return m;
+}
+
+static int32_t clampRaw(double v) {
+  long r = lround(v);
+  return r < 0 ? 0 : r > 4095 ? 4095 : (int32_t)r;
+}
+
+// Returns false if the point is beyond the panel's 12-bit range, i.e. the
+// board cannot report it at all
+static bool panelRaw(const PanelModel &m, double nx, double ny,
+                     int32_t noise, int32_t *rawX, int32_t *rawY) {
+  double jx = noise ? (int32_t)(rng() % (2 * noise + 1)) - noise : 0;
+  double jy = noise ? (int32_t)(rng() % (2 * noise + 1)) - noise : 0;
+  double x = m.xx * nx + m.xy * ny + m.x0 + jx;
+  double y = m.yx * nx + m.yy * ny + m.y0 + jy;
+  *rawX = clampRaw(x);
+  *rawY = clampRaw(y);
+  return *rawX == lround(x) && *rawY == lround(y);
+}
+
+static void screenSize(uint8_t rotation, int32_t *w, int32_t *h) {
+  *w = rotation & 1 ? TOUCHCAL_NATIVE_H : TOUCHCAL_NATIVE_W;
+  *h = rotation & 1 ? TOUCHCAL_NATIVE_W : TOUCHCAL_NATIVE_H;
+}
+
+// Calibrates one board in one rotation as calibration_screen.cpp does and
+// returns the largest grid error; sum and count accumulate the average
+static double calibrateBoard(const TouchCalScenario &s, const PanelModel &m,
+                             uint8_t rotation, double *sum, uint32_t *count,
+                             bool *solved) {
+  int32_t w, h;
+  screenSize(rotation, &w, &h);
+  const int32_t targets[3][2] = {
+      {w / 8, h / 8}, {w * 7 / 8, h / 8}, {w / 8, h * 7 / 8}};
+  int32_t raw[3][2];
+  int32_t native[3][2];
+  for (int i = 0; i < 3; i++) {
+    touchScreenToNative(rotation, TOUCHCAL_NATIVE_W, TOUCHCAL_NATIVE_H,
+                        targets[i][0], targets[i][1], &native[i][0],
+                        &native[i][1]);
+    panelRaw(m, native[i][0], native[i][1], s.noiseRaw, &raw[i][0],
+             &raw[i][1]);
+  }
+  TouchCalibration cal;
+  TouchCalibration rotated;
+  *solved = touchCalibrationSolve(raw, native, &cal);
+  if (!*solved) {
+    return 0;
+  }
+  touchCalibrationRotate(&cal, rotation, TOUCHCAL_NATIVE_W,
+                         TOUCHCAL_NATIVE_H, &rotated);
+
+  double worst = 0;
+  for (int32_t y = 0; y < h; y += TOUCHCAL_GRID_PX) {
+    for (int32_t x = 0; x < w; x += TOUCHCAL_GRID_PX) {
+      int32_t nx, ny, rawX, rawY, mx, my;
+      touchScreenToNative(rotation, TOUCHCAL_NATIVE_W, TOUCHCAL_NATIVE_H, x,
+                          y, &nx, &ny);
+      if (!panelRaw(m, nx, ny, 0, &rawX, &rawY)) {
+        continue;
+      }
+      touchCalibrationApply(&rotated, rawX, rawY, w, h, &mx, &my);
+      double error = hypot(mx - x, my - y);
+      *sum += error;
+      (*count)++;
+      if (error > worst) {
+        worst = error;
+      }
+    }
+  }
+  return worst;
+}
+
+static bool runScenario(const TouchCalScenario &s) {
+  double worst = 0, sum = 0;
+  uint32_t count = 0, failedSolves = 0, overLimit = 0;
+  for (int board = 0; board < TOUCHCAL_BOARDS; board++) {
+    PanelModel m = randomPanel(s);
+    for (uint8_t rotation = 0; rotation < 4; rotation++) {
+      bool solved;
+      double error = calibrateBoard(s, m, rotation, &sum, &count, &solved);
+      if (!solved) {
+        failedSolves++;
+        continue;
+      }
+      if (error > s.maxErrorPx) {
+        overLimit++;
+      }
+      if (error > worst) {
+        worst = error;
+      }
+    }
+  }
+  printf("{\"scenario\":\"%s\",\"boards\":%d,\"noise_raw\":%d,"
+         "\"avg_error_px\":%.2f,\"max_error_px\":%.2f,\"limit_px\":%.1f,"
+         "\"failed_solves\":%u,\"over_limit\":%u}\n",
+         s.name, TOUCHCAL_BOARDS, s.noiseRaw, count ? sum / count : 0.0,
+         worst, s.maxErrorPx, failedSolves, overLimit);
+  return failedSolves == 0 && overLimit == 0;
+}
+
+// The map() chain that touchscreen_read() used before the calibration
+static long arduinoMap(long x, long inMin, long inMax, long outMin,
+                       long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+static void legacyMap(uint8_t rotation, int32_t rawX, int32_t rawY,
+                      int32_t w, int32_t h, int32_t *x, int32_t *y) {
+  const long minX = TOUCH_CAL_DEFAULT_MIN_X, maxX = TOUCH_CAL_DEFAULT_MAX_X;
+  const long minY = TOUCH_CAL_DEFAULT_MIN_Y, maxY = TOUCH_CAL_DEFAULT_MAX_Y;
+  long px, py;
+  if (rotation == 0) {
+    px = arduinoMap(rawX, minX, maxX, 0, w - 1);
+    py = arduinoMap(rawY, minY, maxY, 0, h - 1);
+  } else if (rotation == 1) {
+    px = arduinoMap(rawY, minY, maxY, 0, w - 1);
+    py = (h - 1) - arduinoMap(rawX, minX, maxX, 0, h - 1);
+  } else if (rotation == 2) {
+    px = arduinoMap(rawX, minX, maxX, w - 1, 0);
+    py = arduinoMap(rawY, minY, maxY, h - 1, 0);
+  } else {
+    px = arduinoMap(rawY, minY, maxY, w - 1, 0);
+    py = (h - 1) - arduinoMap(rawX, minX, maxX, h - 1, 0);
+  }
+  *x = px < 0 ? 0 : px > w - 1 ? w - 1 : (int32_t)px;
+  *y = py < 0 ? 0 : py > h - 1 ? h - 1 : (int32_t)py;
+}
+
+static bool checkDefault() {
+  TouchCalibration native;
+  touchCalibrationDefault(TOUCHCAL_NATIVE_W, TOUCHCAL_NATIVE_H, &native);
+  int32_t worst = 0;
+  for (uint8_t rotation = 0; rotation < 4; rotation++) {
+    int32_t w, h;
+    screenSize(rotation, &w, &h);
+    TouchCalibration rotated;
+    touchCalibrationRotate(&native, rotation, TOUCHCAL_NATIVE_W,
+                           TOUCHCAL_NATIVE_H, &rotated);
+    for (int32_t rawY = 0; rawY < 4096; rawY += 7) {
+      for (int32_t rawX = 0; rawX < 4096; rawX += 7) {
+        int32_t x, y, lx, ly;
+        touchCalibrationApply(&rotated, rawX, rawY, w, h, &x, &y);
+        legacyMap(rotation, rawX, rawY, w, h, &lx, &ly);
+        int32_t d = abs(x - lx) > abs(y - ly) ? abs(x - lx) : abs(y - ly);
+        if (d > worst) {
+          worst = d;
+        }
+      }
+    }
+  }
+  printf("{\"scenario\":\"default_vs_map\",\"max_diff_px\":%d}\n", worst);
+  return worst <= 1;
+}
+
+int simRunTouchCal(int argc, char **argv) {
+  rngState = 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--seed") == 0) {
+      rngState ^= strtoull(argv[++i], NULL, 0);
+    }
+  }
+  bool ok = checkDefault();
+  for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+    ok &= runScenario(SCENARIOS[i]);
+  }
+  return ok ? 0 : 1;
+}
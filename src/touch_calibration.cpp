@@ -0,0 +1,130 @@
+#include "touch_calibration.h"
+#include <stdlib.h>
+
+// Rotation as an integer affine map: out = M * in + tW * (W - 1) +
+// tH * (H - 1), where W x H is the native size
+struct RotationMap {
+  int8_t m00, m01, m10, m11;
+  int8_t txW, txH, tyW, tyH;
+};
+
+// Native -> screen, as TFT_eSPI rotates the display
+static const RotationMap TO_SCREEN[4] = {
+    {1, 0, 0, 1, 0, 0, 0, 0},   // x = x0, y = y0
+    {0, 1, -1, 0, 0, 0, 1, 0},  // x = y0, y = W-1 - x0
+    {-1, 0, 0, -1, 1, 0, 0, 1}, // x = W-1 - x0, y = H-1 - y0
+    {0, -1, 1, 0, 0, 1, 0, 0},  // x = H-1 - y0, y = x0
+};
+
+// Screen -> native, the inverses of the above
+static const RotationMap TO_NATIVE[4] = {
+    {1, 0, 0, 1, 0, 0, 0, 0},   // x0 = x, y0 = y
+    {0, -1, 1, 0, 1, 0, 0, 0},  // x0 = W-1 - y, y0 = x
+    {-1, 0, 0, -1, 1, 0, 0, 1}, // x0 = W-1 - x, y0 = H-1 - y
+    {0, 1, -1, 0, 0, 0, 0, 1},  // x0 = y, y0 = H-1 - x
+};
+
+// Rounded division, for either sign
+static int64_t divRound(int64_t num, int64_t den) {
+  if (den < 0) {
+    num = -num;
+    den = -den;
+  }
+  return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+void touchCalibrationDefault(int32_t width, int32_t height,
+                             TouchCalibration *cal) {
+  int32_t spanX = TOUCH_CAL_DEFAULT_MAX_X - TOUCH_CAL_DEFAULT_MIN_X;
+  int32_t spanY = TOUCH_CAL_DEFAULT_MAX_Y - TOUCH_CAL_DEFAULT_MIN_Y;
+  cal->a = (int32_t)divRound((int64_t)(width - 1) << TOUCH_CAL_SHIFT, spanX);
+  cal->b = 0;
+  cal->c = -TOUCH_CAL_DEFAULT_MIN_X * cal->a;
+  cal->d = 0;
+  cal->e = (int32_t)divRound((int64_t)(height - 1) << TOUCH_CAL_SHIFT, spanY);
+  cal->f = -TOUCH_CAL_DEFAULT_MIN_Y * cal->e;
+}
+
+static bool inBounds(int64_t gain1, int64_t gain2, int64_t offset) {
+  return llabs(gain1) <= TOUCH_CAL_MAX_GAIN &&
+         llabs(gain2) <= TOUCH_CAL_MAX_GAIN &&
+         llabs(offset) <= TOUCH_CAL_MAX_OFFSET;
+}
+
+bool touchCalibrationSolve(const int32_t raw[3][2], const int32_t screen[3][2],
+                           TouchCalibration *cal) {
+  int64_t x1 = raw[0][0], y1 = raw[0][1];
+  int64_t x2 = raw[1][0], y2 = raw[1][1];
+  int64_t x3 = raw[2][0], y3 = raw[2][1];
+  int64_t det = x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2);
+  if (llabs(det) < TOUCH_CAL_MIN_DET) {
+    return false;
+  }
+
+  // Cramer's rule, once per screen axis
+  int64_t coef[2][3];
+  for (int axis = 0; axis < 2; axis++) {
+    int64_t s1 = (int64_t)screen[0][axis] << TOUCH_CAL_SHIFT;
+    int64_t s2 = (int64_t)screen[1][axis] << TOUCH_CAL_SHIFT;
+    int64_t s3 = (int64_t)screen[2][axis] << TOUCH_CAL_SHIFT;
+    coef[axis][0] =
+        divRound(s1 * (y2 - y3) + s2 * (y3 - y1) + s3 * (y1 - y2), det);
+    coef[axis][1] =
+        divRound(s1 * (x3 - x2) + s2 * (x1 - x3) + s3 * (x2 - x1), det);
+    coef[axis][2] = divRound(s1 * (x2 * y3 - x3 * y2) +
+                                 s2 * (x3 * y1 - x1 * y3) +
+                                 s3 * (x1 * y2 - x2 * y1),
+                             det);
+    if (!inBounds(coef[axis][0], coef[axis][1], coef[axis][2])) {
+      return false;
+    }
+  }
+  cal->a = (int32_t)coef[0][0];
+  cal->b = (int32_t)coef[0][1];
+  cal->c = (int32_t)coef[0][2];
+  cal->d = (int32_t)coef[1][0];
+  cal->e = (int32_t)coef[1][1];
+  cal->f = (int32_t)coef[1][2];
+  return true;
+}
+
+void touchCalibrationRotate(const TouchCalibration *native, uint8_t rotation,
+                            int32_t nativeWidth, int32_t nativeHeight,
+                            TouchCalibration *rotated) {
+  const RotationMap &r = TO_SCREEN[rotation & 3];
+  int32_t tx = r.txW * (nativeWidth - 1) + r.txH * (nativeHeight - 1);
+  int32_t ty = r.tyW * (nativeWidth - 1) + r.tyH * (nativeHeight - 1);
+  TouchCalibration out;
+  out.a = r.m00 * native->a + r.m01 * native->d;
+  out.b = r.m00 * native->b + r.m01 * native->e;
+  out.c = r.m00 * native->c + r.m01 * native->f + tx * (1 << TOUCH_CAL_SHIFT);
+  out.d = r.m10 * native->a + r.m11 * native->d;
+  out.e = r.m10 * native->b + r.m11 * native->e;
+  out.f = r.m10 * native->c + r.m11 * native->f + ty * (1 << TOUCH_CAL_SHIFT);
+  *rotated = out;
+}
+
+void touchScreenToNative(uint8_t rotation, int32_t nativeWidth,
+                         int32_t nativeHeight, int32_t x, int32_t y,
+                         int32_t *nativeX, int32_t *nativeY) {
+  const RotationMap &r = TO_NATIVE[rotation & 3];
+  *nativeX = r.m00 * x + r.m01 * y + r.txW * (nativeWidth - 1) +
+             r.txH * (nativeHeight - 1);
+  *nativeY = r.m10 * x + r.m11 * y + r.tyW * (nativeWidth - 1) +
+             r.tyH * (nativeHeight - 1);
+}
+
+void touchCalibrationApply(const TouchCalibration *cal, int32_t rawX,
+                           int32_t rawY, int32_t width, int32_t height,
+                           int32_t *x, int32_t *y) {
+  const int32_t half = 1 << (TOUCH_CAL_SHIFT - 1);
+  int32_t sx = (cal->a * rawX + cal->b * rawY + cal->c + half) >>
+               TOUCH_CAL_SHIFT;
+  int32_t sy = (cal->d * rawX + cal->e * rawY + cal->f + half) >>
+               TOUCH_CAL_SHIFT;
+  // min/max compile to conditional moves (MIN/MAX on Xtensa)
+  sx = sx < 0 ? 0 : sx;
+  sy = sy < 0 ? 0 : sy;
+  *x = sx > width - 1 ? width - 1 : sx;
+  *y = sy > height - 1 ? height - 1 : sy;
+}
@@ -0,0 +1,68 @@
+#ifndef TOUCH_CALIBRATION_H
+#define TOUCH_CALIBRATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Affine touch calibration: screen = M * raw + t, in Q16 fixed point.
+//   x = (a * rawX + b * rawY + c) >> 16
+//   y = (d * rawX + e * rawY + f) >> 16
+// Three touches on known targets determine the six coefficients, which
+// covers offset, scale, rotation and skew of the panel against the display.
+//
+// A calibration is kept in native display coordinates (rotation 0).
+// touchCalibrationRotate() folds a display rotation into the matrix once,
+// so mapping a sample is the same multiply-add for every rotation, without
+// branches. Pure computation, no hardware access.
+#define TOUCH_CAL_SHIFT 16
+// Bounds that keep touchCalibrationApply() within int32 for 12-bit raw
+// values: up to 2 px per raw step, offsets up to 2^13 px
+#define TOUCH_CAL_MAX_GAIN (1 << (TOUCH_CAL_SHIFT + 1))
+#define TOUCH_CAL_MAX_OFFSET (1 << 29)
+// Smallest raw triangle (twice its area) accepted from the three touches
+#define TOUCH_CAL_MIN_DET (1 << 18)
+
+typedef struct {
+  int32_t a, b, c;
+  int32_t d, e, f;
+} TouchCalibration;
+
+// Raw bounds of the XPT2046_Touchscreen era: the default until a board has
+// been calibrated, mapping to native coordinates of width x height
+#define TOUCH_CAL_DEFAULT_MIN_X 521
+#define TOUCH_CAL_DEFAULT_MAX_X 3540
+#define TOUCH_CAL_DEFAULT_MIN_Y 379
+#define TOUCH_CAL_DEFAULT_MAX_Y 3624
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void touchCalibrationDefault(int32_t width, int32_t height,
+                             TouchCalibration *cal);
+
+// Solves the calibration from three raw points and the screen points they
+// were taken at. Returns false if the points are (nearly) collinear or the
+// result is out of bounds.
+bool touchCalibrationSolve(const int32_t raw[3][2], const int32_t screen[3][2],
+                           TouchCalibration *cal);
+
+// Native <-> rotated screen coordinates for TFT_eSPI rotations 0..3, with
+// the native (rotation 0) size
+void touchCalibrationRotate(const TouchCalibration *native, uint8_t rotation,
+                            int32_t nativeWidth, int32_t nativeHeight,
+                            TouchCalibration *rotated);
+void touchScreenToNative(uint8_t rotation, int32_t nativeWidth,
+                         int32_t nativeHeight, int32_t x, int32_t y,
+                         int32_t *nativeX, int32_t *nativeY);
+
+// Maps a raw point and clamps it to width x height
+void touchCalibrationApply(const TouchCalibration *cal, int32_t rawX,
+                           int32_t rawY, int32_t width, int32_t height,
+                           int32_t *x, int32_t *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOUCH_CALIBRATION_H
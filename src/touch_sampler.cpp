@@ -0,0 +1,235 @@
+#include "touch_sampler.h"
+#include "SpscRing.h"
+#include "cpu_power.h"
+#include "loop_scheduler.h"
+#include <Arduino.h>
+#include <SPI.h>
+#include <driver/gpio.h>
+
+// XPT2046 control bytes: start bit, channel, 12-bit, differential. The
+// low bits keep PENIRQ enabled between conversions; 0xD0 powers down.
+#define XPT2046_Z1 0xB1
+#define XPT2046_Z2 0xC1
+#define XPT2046_X 0xD1
+#define XPT2046_Y 0x91
+#define XPT2046_POWER_DOWN 0xD0
+#define TOUCH_SPI_HZ 2000000
+
+static SPIClass touchSPI(VSPI);
+static const SPISettings TOUCH_SPI_SETTINGS(TOUCH_SPI_HZ, MSBFIRST,
+                                            SPI_MODE0);
+
+static SpscRing<TouchPoint, TOUCH_QUEUE_CAPACITY> pointRing;
+static TaskHandle_t samplerTaskHandle = NULL;
+
+// Sampler task
+static uint32_t wakeCount = 0;
+static uint32_t touchCount = 0;
+static uint32_t sampleCount = 0;
+static uint32_t queuedCount = 0;
+static uint32_t droppedCount = 0;
+
+// Loop task
+static uint32_t coalescedCount = 0;
+static bool lastPopPressed = false;
+static uint32_t pressLatencySumUs = 0;
+static uint32_t pressLatencyMaxUs = 0;
+static uint32_t pressLatencySamples = 0;
+
+static void IRAM_ATTR onPenIrq() {
+  cpuPowerWakeFromISR();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(samplerTaskHandle, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static uint16_t median(uint16_t *values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    uint16_t v = values[i];
+    size_t j = i;
+    for (; j > 0 && values[j - 1] > v; j--) {
+      values[j] = values[j - 1];
+    }
+    values[j] = v;
+  }
+  return values[count / 2];
+}
+
+// One sample: pressure, and if pressed the median of TOUCH_OVERSAMPLE
+// conversion pairs. Each transfer returns the result of the previous
+// command while sending the next one.
+static bool readSample(TouchPoint *point) {
+  uint16_t xs[TOUCH_OVERSAMPLE];
+  uint16_t ys[TOUCH_OVERSAMPLE];
+
+  touchSPI.beginTransaction(TOUCH_SPI_SETTINGS);
+  digitalWrite(XPT2046_CS, LOW);
+  touchSPI.transfer(XPT2046_Z1);
+  int32_t z = (touchSPI.transfer16(XPT2046_Z2) >> 3) + 4095;
+  z -= touchSPI.transfer16(XPT2046_Y) >> 3;
+  bool pressed = z >= TOUCH_Z_THRESHOLD;
+  if (pressed) {
+    touchSPI.transfer16(XPT2046_Y); // the first conversion is noisy
+    for (size_t i = 0; i < TOUCH_OVERSAMPLE; i++) {
+      ys[i] = touchSPI.transfer16(XPT2046_X) >> 3;
+      uint8_t next = i + 1 < TOUCH_OVERSAMPLE ? XPT2046_Y : XPT2046_POWER_DOWN;
+      xs[i] = touchSPI.transfer16(next) >> 3;
+    }
+  } else {
+    touchSPI.transfer16(XPT2046_POWER_DOWN);
+  }
+  touchSPI.transfer16(0);
+  digitalWrite(XPT2046_CS, HIGH);
+  touchSPI.endTransaction();
+  sampleCount++;
+
+  point->us = (uint32_t)esp_timer_get_time();
+  point->pressed = pressed;
+  if (!pressed) {
+    point->z = 0;
+    return false;
+  }
+  // Same orientation as XPT2046_Touchscreen::getPoint() at rotation 0
+  point->x = 4095 - median(xs, TOUCH_OVERSAMPLE);
+  point->y = median(ys, TOUCH_OVERSAMPLE);
+  point->z = (uint16_t)z;
+  return true;
+}
+
+static void queuePoint(const TouchPoint &point) {
+  if (point.pressed) {
+    if (pointRing.push(point)) {
+      queuedCount++;
+    } else {
+      droppedCount++; // a later move or the release will follow
+    }
+  } else {
+    // A lost release would leave LVGL pressed
+    while (!pointRing.push(point)) {
+      vTaskDelay(1);
+    }
+    queuedCount++;
+  }
+  wakeLoop();
+}
+
+// Samples until the finger is lifted
+static void sampleTouch() {
+  TouchPoint point;
+  TouchPoint filtered = {};
+  bool down = false;
+  uint32_t misses = 0;
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;) {
+    if (readSample(&point)) {
+      misses = 0;
+      if (!down) {
+        down = true;
+        touchCount++;
+        filtered = point;
+        queuePoint(filtered);
+      } else {
+        int32_t weight = point.z >= TOUCH_Z_FIRM ? TOUCH_IIR_WEIGHT_FIRM
+                                                 : TOUCH_IIR_WEIGHT_LIGHT;
+        int32_t x = filtered.x + ((point.x - filtered.x) * weight) / 4;
+        int32_t y = filtered.y + ((point.y - filtered.y) * weight) / 4;
+        filtered.us = point.us;
+        filtered.z = point.z;
+        if (x != filtered.x || y != filtered.y) {
+          filtered.x = (uint16_t)x;
+          filtered.y = (uint16_t)y;
+          queuePoint(filtered);
+        }
+      }
+    } else if (!down) {
+      return; // glitch on the pen interrupt line
+    } else if (++misses >= TOUCH_RELEASE_SAMPLES) {
+      filtered.us = point.us;
+      filtered.z = 0;
+      filtered.pressed = false;
+      queuePoint(filtered);
+      return;
+    }
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TOUCH_SAMPLE_PERIOD_MS));
+  }
+}
+
+static void samplerTask(void *param) {
+  (void)param;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wakeCount++;
+    sampleTouch();
+    // PENIRQ toggles during conversions; those edges are not new touches
+    ulTaskNotifyTake(pdTRUE, 0);
+    if (digitalRead(XPT2046_IRQ) == LOW) {
+      xTaskNotifyGive(samplerTaskHandle); // touched again meanwhile
+    }
+  }
+}
+
+void startTouchSampler() {
+  if (samplerTaskHandle != NULL) {
+    return;
+  }
+  pinMode(XPT2046_CS, OUTPUT);
+  digitalWrite(XPT2046_CS, HIGH);
+  touchSPI.begin(XPT2046_CLK, XPT2046_MISO, XPT2046_MOSI, XPT2046_CS);
+
+  // Power down with PENIRQ enabled, so that the line reflects the panel
+  touchSPI.beginTransaction(TOUCH_SPI_SETTINGS);
+  digitalWrite(XPT2046_CS, LOW);
+  touchSPI.transfer(XPT2046_POWER_DOWN);
+  touchSPI.transfer16(0);
+  digitalWrite(XPT2046_CS, HIGH);
+  touchSPI.endTransaction();
+
+  xTaskCreatePinnedToCore(samplerTask, "touch", TOUCH_TASK_STACK_SIZE, NULL,
+                          TOUCH_TASK_PRIORITY, &samplerTaskHandle,
+                          TOUCH_TASK_CORE);
+  pinMode(XPT2046_IRQ, INPUT); // GPIO 36 has no pull-up; the board has one
+  attachInterrupt(digitalPinToInterrupt(XPT2046_IRQ), onPenIrq, FALLING);
+  addCpuPowerWakePin(XPT2046_IRQ, GPIO_INTR_NEGEDGE);
+}
+
+bool popTouchPoint(TouchPoint *point, bool *more) {
+  if (!pointRing.pop(*point)) {
+    return false;
+  }
+  // Only the newest of consecutive moves matters
+  const TouchPoint *next;
+  while (point->pressed && lastPopPressed &&
+         (next = pointRing.peek()) != NULL && next->pressed) {
+    pointRing.pop(*point);
+    coalescedCount++;
+  }
+  if (point->pressed && !lastPopPressed) {
+    uint32_t latency = (uint32_t)esp_timer_get_time() - point->us;
+    pressLatencySumUs += latency;
+    pressLatencySamples++;
+    if (latency > pressLatencyMaxUs) {
+      pressLatencyMaxUs = latency;
+    }
+  }
+  lastPopPressed = point->pressed;
+  *more = !pointRing.empty();
+  return true;
+}
+
+bool touchPointPending() { return !pointRing.empty(); }
+
+void getTouchSamplerStats(TouchSamplerStats *stats) {
+  stats->wakes = wakeCount;
+  stats->touches = touchCount;
+  stats->samples = sampleCount;
+  stats->queued = queuedCount;
+  stats->coalesced = coalescedCount;
+  stats->dropped = droppedCount;
+  stats->depth = pointRing.size();
+  stats->pressLatencyAvgUs =
+      pressLatencySamples ? pressLatencySumUs / pressLatencySamples : 0;
+  stats->pressLatencyMaxUs = pressLatencyMaxUs;
+}
@@ -0,0 +1,87 @@
+#ifndef TOUCH_SAMPLER_H
+#define TOUCH_SAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interrupt-driven XPT2046 sampling. The controller pulls its PENIRQ line
+// low when the panel is touched; the interrupt wakes a sampler task, which
+// reads the controller every TOUCH_SAMPLE_PERIOD_MS for as long as the
+// finger stays down and then blocks again. Nobody touching means no SPI
+// traffic and no task wakeups.
+//
+// Each sample takes TOUCH_OVERSAMPLE X/Y conversion pairs in one SPI
+// transaction and keeps their median. Light presses read noisier than firm
+// ones, so the median then goes through an IIR filter whose weight follows
+// the pressure. The first point of a touch is passed unfiltered so that
+// touch-down is not delayed. Points are queued with their sample time in a
+// lock-free ring that the LVGL read callback drains on the loop task.
+#define XPT2046_IRQ 36
+#define XPT2046_MOSI 32
+#define XPT2046_MISO 39
+#define XPT2046_CLK 25
+#define XPT2046_CS 33
+
+#define TOUCH_TASK_CORE 1 // with the loop task, which is the only consumer
+#define TOUCH_TASK_PRIORITY 2
+#define TOUCH_TASK_STACK_SIZE 2048
+#define TOUCH_QUEUE_CAPACITY 32 // must be a power of two
+
+#define TOUCH_SAMPLE_PERIOD_MS 4
+#define TOUCH_OVERSAMPLE 5 // conversion pairs per sample, odd
+// Pressure (Z1 + 4095 - Z2) below which the panel is not touched
+#define TOUCH_Z_THRESHOLD 400
+// Pressure from which a touch counts as firm and is filtered lightly
+#define TOUCH_Z_FIRM 1200
+// IIR weight of a new sample, in quarters
+#define TOUCH_IIR_WEIGHT_LIGHT 1
+#define TOUCH_IIR_WEIGHT_FIRM 3
+// Samples below the threshold in a row that end a touch
+#define TOUCH_RELEASE_SAMPLES 2
+
+// Raw controller coordinates (0..4095), oriented like XPT2046_Touchscreen
+// with rotation 0
+typedef struct {
+  uint32_t us; // esp_timer time of the sample
+  uint16_t x;
+  uint16_t y;
+  uint16_t z; // 0 for a release
+  bool pressed;
+} TouchPoint;
+
+typedef struct {
+  uint32_t wakes;     // pen interrupts that woke the sampler
+  uint32_t touches;   // ... that turned out to be a touch
+  uint32_t samples;   // SPI samples taken
+  uint32_t queued;    // points put in the queue
+  uint32_t coalesced; // moves skipped because a newer one was queued
+  uint32_t dropped;   // moves lost because the queue was full
+  uint32_t depth;     // points currently queued
+  // Touch-down sample to the LVGL read callback
+  uint32_t pressLatencyAvgUs;
+  uint32_t pressLatencyMaxUs;
+} TouchSamplerStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Starts the touch SPI bus, the pen interrupt and the sampler task. Call
+// once from setup().
+void startTouchSampler();
+
+// Loop task: takes the next point. Of several queued moves only the newest
+// is returned; presses and releases are never skipped. *more tells whether
+// further points are waiting. Returns false if the queue is empty.
+bool popTouchPoint(TouchPoint *point, bool *more);
+
+// Whether points are waiting, e.g. to run the LVGL read timer early
+bool touchPointPending();
+
+void getTouchSamplerStats(TouchSamplerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOUCH_SAMPLER_H
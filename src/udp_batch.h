@@ -0,0 +1,55 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How the network task cuts the queued commands into datagrams. Kept out of
+// udp_queue.cpp so that the simulator (sim/sim_batch.cpp) packs with the
+// same code.
+//
+// A command queued alone (enqueueUDP32Alone()) gets a datagram of its own:
+// the frame before it is closed and nothing joins it. The words of a unit
+// (enqueueUDP32Unit()) always share one datagram; a unit that does not fit
+// in the current frame starts the next one.
+#define QUEUED_ALONE 0x01
+
+struct QueuedCommand {
+  uint32_t value;
+  uint32_t enqueuedUs; // esp_timer time the UI thread queued the command
+  uint8_t flags;       // QUEUED_*
+  uint8_t unitWords;   // first word of a unit: its length; 1 otherwise
+};
+
+// Moves the commands of the next datagram from ring to frame: everything
+// queued, up to frameLimit words. A unit longer than frameLimit still goes
+// out whole, so frame must hold UDP_MAX_FRAME_WORDS. The ring must have
+// received each unit with a single push. Returns the number of words taken.
+template <typename Ring>
+size_t takeFrame(Ring &ring, size_t frameLimit, uint32_t *frame,
+                 uint32_t *enqueuedUs) {
+  QueuedCommand cmd;
+  size_t count = 0;
+  while (count < frameLimit) {
+    const QueuedCommand *next = ring.peek();
+    if (next == NULL) {
+      break;
+    }
+    size_t words = next->unitWords > 1 ? next->unitWords : 1;
+    bool alone = (next->flags & QUEUED_ALONE) != 0;
+    if (count > 0 && (alone || count + words > frameLimit)) {
+      break; // starts the next datagram
+    }
+    for (size_t i = 0; i < words && ring.pop(cmd); i++) {
+      frame[count] = cmd.value;
+      enqueuedUs[count] = cmd.enqueuedUs;
+      count++;
+    }
+    if (alone) {
+      break;
+    }
+  }
+  return count;
+}
+
+#endif // UDP_BATCH_H
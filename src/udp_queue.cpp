@@ -0,0 +1,265 @@
+#include "udp_queue.h"
+#include "SpscRing.h"
+#include "arp_warm.h"
+#include "liveness.h"
+#include "press_mode.h"
+#include "reliable_udp.h"
+#include "udp_batch.h"
+#include "wifi_power.h"
+#include "wifi_udp.h"
+#include <Arduino.h>
+
+static SpscRing<QueuedCommand, UDP_QUEUE_CAPACITY> commandRing;
+static TaskHandle_t udpTaskHandle = NULL;
+
+static volatile uint32_t batchWindowMs = UDP_BATCH_WINDOW_MS_DEFAULT;
+static volatile uint32_t maxFrameWords = UDP_MAX_FRAME_WORDS;
+static volatile bool urgentPending = false;
+
+// Producer-side counters (UI thread)
+static volatile uint32_t enqueuedCount = 0;
+static volatile uint32_t droppedCount = 0;
+static volatile uint32_t highWater = 0;
+
+// Consumer-side counters (network task)
+static volatile uint32_t sentCount = 0;
+static volatile uint32_t packetCount = 0;
+static volatile uint32_t sendFailureCount = 0;
+static volatile uint32_t latencyMinUs = UINT32_MAX;
+static volatile uint32_t latencyMaxUs = 0;
+static uint64_t latencySumUs = 0;
+static uint32_t latencySamples = 0;
+static volatile uint32_t transmitMaxUs = 0;
+static uint64_t transmitSumUs = 0;
+static uint32_t transmitSamples = 0;
+
+static void recordLatency(uint32_t enqueuedUs) {
+  uint32_t latency = (uint32_t)esp_timer_get_time() - enqueuedUs;
+  if (latency < latencyMinUs) {
+    latencyMinUs = latency;
+  }
+  if (latency > latencyMaxUs) {
+    latencyMaxUs = latency;
+  }
+  latencySumUs += latency;
+  latencySamples++;
+}
+
+// Moves queued commands into datagrams of at most frameLimit words.
+// Returns true if commands are left behind because the reliable-mode
+// in-flight window is full.
+static bool drainRing(uint32_t frameLimit) {
+  static uint32_t frame[UDP_MAX_FRAME_WORDS];
+  static uint32_t frameEnqueuedUs[UDP_MAX_FRAME_WORDS];
+
+  while (!commandRing.empty()) {
+    bool reliable = isReliableUDPEnabled();
+    if (reliable && reliableUDPWindowFree() == 0) {
+      serviceReliableUDP();
+      if (reliableUDPWindowFree() == 0) {
+        return true;
+      }
+    }
+
+    size_t count = takeFrame(commandRing, frameLimit, frame, frameEnqueuedUs);
+
+    uint32_t startUs = (uint32_t)esp_timer_get_time();
+    bool ok = reliable ? sendReliableUDP(frame, count)
+                       : transmitUDP32Array(frame, count);
+    uint32_t transmitUs = (uint32_t)esp_timer_get_time() - startUs;
+    if (transmitUs > transmitMaxUs) {
+      transmitMaxUs = transmitUs;
+    }
+    transmitSumUs += transmitUs;
+    transmitSamples++;
+    if (ok) {
+      sentCount += count;
+      packetCount++;
+      wifiPowerOnTransmit();
+      pressModeOnTransmit();
+    } else {
+      sendFailureCount += count;
+    }
+    for (size_t i = 0; i < count; i++) {
+      recordLatency(frameEnqueuedUs[i]);
+    }
+  }
+  return false;
+}
+
+// Gives other commands from the same UI frame a chance to join the datagram.
+// Ends early when an urgent command is queued.
+static void waitBatchWindow() {
+  TickType_t window = pdMS_TO_TICKS(batchWindowMs);
+  TickType_t start = xTaskGetTickCount();
+  while (!urgentPending) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= window) {
+      break;
+    }
+    ulTaskNotifyTake(pdTRUE, window - elapsed);
+  }
+}
+
+// Network task: sleeps until the UI thread signals new work (or until an
+// ACK or echo arrives, a retransmission is due, the next liveness probe
+// has to go out or ARP needs attention), waits for the batching window so
+// that commands from the same UI frame can join, then drains the ring onto
+// the wire in as few datagrams as possible
+static void udpTask(void *param) {
+  (void)param;
+  bool backlog = false;
+
+  for (;;) {
+    uint32_t nextMs = serviceLiveness();
+    uint32_t arpMs = serviceArpWarm();
+    if (arpMs < nextMs) {
+      nextMs = arpMs;
+    }
+    if (isReliableUDPEnabled()) {
+      uint32_t reliableMs = serviceReliableUDP();
+      if (reliableMs < nextMs) {
+        nextMs = reliableMs;
+      }
+    }
+    TickType_t wait = nextMs == UINT32_MAX ? portMAX_DELAY
+                                           : pdMS_TO_TICKS(nextMs) + 1;
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    if (commandRing.empty()) {
+      continue;
+    }
+
+    uint32_t frameLimit = maxFrameWords;
+    if (!backlog && batchWindowMs > 0 && frameLimit > 1) {
+      waitBatchWindow();
+    }
+    urgentPending = false;
+    backlog = drainRing(frameLimit);
+  }
+}
+
+void startUDPQueue() {
+  if (udpTaskHandle != NULL) {
+    return;
+  }
+  xTaskCreatePinnedToCore(udpTask, "udpTx", UDP_TASK_STACK_SIZE, NULL,
+                          UDP_TASK_PRIORITY, &udpTaskHandle, UDP_TASK_CORE);
+}
+
+void notifyUDPQueue() {
+  if (udpTaskHandle != NULL) {
+    xTaskNotifyGive(udpTaskHandle);
+  }
+}
+
+void setUDPBatching(uint32_t windowMs, uint32_t frameWords) {
+  if (frameWords < 1) {
+    frameWords = 1;
+  } else if (frameWords > UDP_MAX_FRAME_WORDS) {
+    frameWords = UDP_MAX_FRAME_WORDS;
+  }
+  batchWindowMs = windowMs;
+  maxFrameWords = frameWords;
+}
+
+// All or nothing, in one step for the network task (see udp_batch.h).
+// alone[i] marks words that get a datagram of their own; may be NULL.
+static bool push(const uint32_t *values, const bool *alone, size_t count,
+                 bool unit) {
+  QueuedCommand cmds[UDP_QUEUE_CAPACITY];
+  if (count == 0 || count > UDP_QUEUE_CAPACITY) {
+    droppedCount += count;
+    return false;
+  }
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  for (size_t i = 0; i < count; i++) {
+    cmds[i].value = values[i];
+    cmds[i].enqueuedUs = now;
+    cmds[i].flags = alone != NULL && alone[i] ? QUEUED_ALONE : 0;
+    cmds[i].unitWords = unit && i == 0 ? (uint8_t)count : 1;
+  }
+  if (!commandRing.push(cmds, count)) {
+    droppedCount += count;
+    return false;
+  }
+  enqueuedCount += count;
+
+  uint32_t depth = commandRing.size();
+  if (depth > highWater) {
+    highWater = depth;
+  }
+  return true;
+}
+
+static bool enqueue(const uint32_t *values, const bool *alone, size_t count,
+                    bool unit, bool urgent) {
+  if (!push(values, alone, count, unit)) {
+    return false;
+  }
+  if (urgent) {
+    urgentPending = true;
+  }
+  notifyUDPQueue();
+  return true;
+}
+
+bool enqueueUDP32(uint32_t value) {
+  return enqueue(&value, NULL, 1, false, false);
+}
+
+bool enqueueUDP32Urgent(uint32_t value) {
+  return enqueue(&value, NULL, 1, false, true);
+}
+
+bool enqueueUDP32Alone(uint32_t value) {
+  const bool alone = true;
+  return enqueue(&value, &alone, 1, false, true);
+}
+
+bool enqueueUDP32Unit(const uint32_t *values, size_t count) {
+  if (count > UDP_MAX_FRAME_WORDS) {
+    droppedCount += count;
+    return false;
+  }
+  return enqueue(values, NULL, count, true, false);
+}
+
+bool enqueueUDP32Batch(const uint32_t *values, const bool *alone,
+                       size_t count) {
+  // One wakeup for all of them, without waiting for the batching window
+  return enqueue(values, alone, count, false, true);
+}
+
+void getUDPQueueStats(UdpQueueStats *stats) {
+  stats->depth = commandRing.size();
+  stats->highWater = highWater;
+  stats->enqueued = enqueuedCount;
+  stats->sent = sentCount;
+  stats->packets = packetCount;
+  stats->dropped = droppedCount;
+  stats->sendFailures = sendFailureCount;
+  stats->latencyMinUs = latencySamples ? latencyMinUs : 0;
+  stats->latencyMaxUs = latencyMaxUs;
+  stats->latencyAvgUs =
+      latencySamples ? (uint32_t)(latencySumUs / latencySamples) : 0;
+  stats->transmitAvgUs =
+      transmitSamples ? (uint32_t)(transmitSumUs / transmitSamples) : 0;
+  stats->transmitMaxUs = transmitMaxUs;
+}
+
+void resetUDPQueueStats() {
+  highWater = commandRing.size();
+  enqueuedCount = 0;
+  droppedCount = 0;
+  sentCount = 0;
+  packetCount = 0;
+  sendFailureCount = 0;
+  latencyMinUs = UINT32_MAX;
+  latencyMaxUs = 0;
+  latencySumUs = 0;
+  latencySamples = 0;
+  transmitMaxUs = 0;
+  transmitSumUs = 0;
+  transmitSamples = 0;
+}
@@ -0,0 +1,83 @@
+#ifndef UDP_QUEUE_H
+#define UDP_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Outgoing command queue. The UI thread pushes command words into a lock-free
+// ring and a dedicated network task pinned to core 0 puts them on the wire,
+// so a slow or stalled radio never blocks lv_task_handler().
+#define UDP_QUEUE_CAPACITY 32 // must be a power of two
+#define UDP_TASK_CORE 0
+#define UDP_TASK_PRIORITY 3
+#define UDP_TASK_STACK_SIZE 4096
+
+// Batching: commands queued within the batching window after the first one
+// (about one UI frame) go out together in one datagram of at most
+// UDP_MAX_FRAME_WORDS words. A window of 0 or a frame of 1 word disables it.
+#define UDP_BATCH_WINDOW_MS_DEFAULT 5
+#define UDP_MAX_FRAME_WORDS 16 // command words per datagram
+// Largest datagram on the wire: a full frame plus the reliable-mode header
+// (RELIABLE_UDP_HEADER_WORDS)
+#define UDP_MAX_DATAGRAM_WORDS (UDP_MAX_FRAME_WORDS + 2)
+
+typedef struct {
+  uint32_t depth;         // commands currently waiting in the ring
+  uint32_t highWater;     // deepest the ring has been since the last reset
+  uint32_t enqueued;      // commands accepted by enqueueUDP32()
+  uint32_t sent;          // commands handed to the network stack
+  uint32_t packets;       // datagrams carrying those commands
+  uint32_t dropped;       // commands rejected because the ring was full
+  uint32_t sendFailures;  // commands the network stack refused
+  uint32_t latencyMinUs;  // enqueue-to-wire latency
+  uint32_t latencyMaxUs;
+  uint32_t latencyAvgUs;
+  uint32_t transmitAvgUs; // time spent handing one datagram to the stack,
+  uint32_t transmitMaxUs; // including any logging on that path
+} UdpQueueStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Create the network task. Call once from setup() before the first send.
+void startUDPQueue();
+
+// Queue a 32-bit command word for transmission. Never blocks.
+// Returns false if the queue is full and the command was dropped.
+bool enqueueUDP32(uint32_t value);
+
+// Same, but the network task flushes immediately instead of waiting for the
+// batching window (for latency-critical commands such as START/STOP)
+bool enqueueUDP32Urgent(uint32_t value);
+
+// Queue a word that goes out right away in a datagram of its own, for
+// commands that must not share one (non-batchable in COMMAND_TABLE)
+bool enqueueUDP32Alone(uint32_t value);
+
+// Queue up to UDP_MAX_FRAME_WORDS words that go out in the same datagram
+// (e.g. the three words of a time entry). All or nothing.
+bool enqueueUDP32Unit(const uint32_t *values, size_t count);
+
+// Queue several words that go out together and right away (e.g. the
+// offline journal on reconnect). Words with alone[i] set still get a
+// datagram of their own; alone may be NULL. All or nothing: returns false
+// without queueing any of them if the ring has no room for all.
+bool enqueueUDP32Batch(const uint32_t *values, const bool *alone,
+                       size_t count);
+
+// Wake the network task, e.g. when an ACK has arrived
+void notifyUDPQueue();
+
+// Batching window and frame size (1..UDP_MAX_FRAME_WORDS)
+void setUDPBatching(uint32_t windowMs, uint32_t maxFrameWords);
+
+// Snapshot of the queue counters
+void getUDPQueueStats(UdpQueueStats *stats);
+void resetUDPQueueStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UDP_QUEUE_H
@@ -0,0 +1,319 @@
+#include "udp_transport.h"
+#include "arp_warm.h"
+#include "logger.h"
+#include "udp_queue.h"
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <lwip/pbuf.h>
+#include <lwip/priv/tcpip_priv.h>
+#include <lwip/udp.h>
+
+#define DATAGRAM_BYTES (UDP_MAX_DATAGRAM_WORDS * 4)
+
+static UdpReceiveHandler receiveHandler = NULL;
+
+static volatile uint32_t sentCount = 0;
+static volatile uint32_t sendErrorCount = 0;
+static volatile uint32_t poolHitCount = 0;
+static volatile uint32_t poolMissCount = 0;
+static volatile uint32_t receivedCount = 0;
+
+// Command words go on the wire little-endian
+static void serialise(uint8_t *out, const uint32_t *values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i * 4 + 0] = (values[i] >> 0) & 0xFF;
+    out[i * 4 + 1] = (values[i] >> 8) & 0xFF;
+    out[i * 4 + 2] = (values[i] >> 16) & 0xFF;
+    out[i * 4 + 3] = (values[i] >> 24) & 0xFF;
+  }
+}
+
+// Raw lwIP backend
+
+#if UDP_TRANSPORT_RAW
+static struct udp_pcb *rawPcb = NULL;
+static struct pbuf *pool[UDP_PBUF_POOL_SIZE];
+static uint8_t *poolPayload[UDP_PBUF_POOL_SIZE]; // below lwIP's headers
+static bool poolBusy[UDP_PBUF_POOL_SIZE];
+static portMUX_TYPE poolMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Raw API calls have to run on the lwIP thread; tcpip_api_call() runs them
+// there and waits, without allocating
+struct RawCall {
+  struct tcpip_api_call_data call; // must be first
+  struct pbuf *p;
+  ip_addr_t addr;
+  uint16_t port;
+  err_t err;
+};
+
+static void onRawReceive(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                         const ip_addr_t *addr, u16_t port) {
+  (void)arg;
+  (void)pcb;
+  (void)port;
+  receivedCount++;
+  if (receiveHandler != NULL) {
+    uint32_t from = ip4_addr_get_u32(ip_2_ip4(addr));
+    if (p->len == p->tot_len) {
+      receiveHandler((const uint8_t *)p->payload, p->len, from);
+    } else {
+      // Chained pbuf: a frame's worth at the front is all we parse
+      uint8_t data[DATAGRAM_BYTES];
+      u16_t length = pbuf_copy_partial(p, data, sizeof(data), 0);
+      receiveHandler(data, length, from);
+    }
+  }
+  pbuf_free(p);
+}
+
+static err_t rawBind(struct tcpip_api_call_data *data) {
+  RawCall *c = (RawCall *)data;
+  rawPcb = udp_new();
+  if (rawPcb == NULL) {
+    c->err = ERR_MEM;
+    return c->err;
+  }
+  c->err = udp_bind(rawPcb, IP_ADDR_ANY, c->port);
+  if (c->err != ERR_OK) {
+    udp_remove(rawPcb);
+    rawPcb = NULL;
+    return c->err;
+  }
+  udp_recv(rawPcb, onRawReceive, NULL);
+  return ERR_OK;
+}
+
+static err_t rawSendTo(struct tcpip_api_call_data *data) {
+  RawCall *c = (RawCall *)data;
+  arpWarmCheckNextHop(ip4_addr_get_u32(ip_2_ip4(&c->addr)));
+  c->err = udp_sendto(rawPcb, c->p, &c->addr, c->port);
+  return c->err;
+}
+
+static bool initRaw(uint16_t localPort) {
+  for (int i = 0; i < UDP_PBUF_POOL_SIZE; i++) {
+    pool[i] = pbuf_alloc(PBUF_TRANSPORT, DATAGRAM_BYTES, PBUF_RAM);
+    if (pool[i] == NULL) {
+      LOG_ERROR("UDP: Could not allocate the pbuf pool\n");
+      return false;
+    }
+    poolPayload[i] = (uint8_t *)pool[i]->payload;
+  }
+
+  RawCall c;
+  c.port = localPort;
+  c.err = ERR_OK;
+  tcpip_api_call(rawBind, &c.call);
+  return c.err == ERR_OK;
+}
+
+// A pool pbuf that only we reference, or -1
+static int claimPbuf() {
+  int slot = -1;
+  portENTER_CRITICAL(&poolMux);
+  for (int i = 0; i < UDP_PBUF_POOL_SIZE; i++) {
+    if (!poolBusy[i] && pool[i]->ref == 1) {
+      poolBusy[i] = true;
+      slot = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&poolMux);
+  return slot;
+}
+
+static bool rawSend(uint32_t ip, uint16_t port, const uint32_t *values,
+                    size_t count) {
+  if (rawPcb == NULL) {
+    return false;
+  }
+  u16_t length = (u16_t)(count * 4);
+  int slot = claimPbuf();
+  struct pbuf *p;
+  if (slot >= 0) {
+    p = pool[slot];
+    // Drop the UDP/IP/link headers the previous send prepended, then
+    // shorten in place: a single PBUF_RAM sized for a full datagram
+    uint8_t *payload = (uint8_t *)p->payload;
+    if (payload < poolPayload[slot]) {
+      pbuf_remove_header(p, poolPayload[slot] - payload);
+    }
+    p->len = p->tot_len = length;
+    poolHitCount++;
+  } else {
+    p = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+    if (p == NULL) {
+      return false;
+    }
+    poolMissCount++;
+  }
+  serialise((uint8_t *)p->payload, values, count);
+
+  RawCall c;
+  c.p = p;
+  ip_addr_set_ip4_u32(&c.addr, ip);
+  c.port = port;
+  c.err = ERR_OK;
+  tcpip_api_call(rawSendTo, &c.call);
+
+  if (slot >= 0) {
+    portENTER_CRITICAL(&poolMux);
+    poolBusy[slot] = false;
+    portEXIT_CRITICAL(&poolMux);
+  } else {
+    pbuf_free(p);
+  }
+  return c.err == ERR_OK;
+}
+#endif
+
+// AsyncUDP backend (and the baseline for the benchmark)
+
+#if !UDP_TRANSPORT_RAW || defined(UDP_BENCH)
+static bool asyncSend(AsyncUDP &udp, uint32_t ip, uint16_t port,
+                      const uint32_t *values, size_t count) {
+  uint8_t packet[DATAGRAM_BYTES];
+  size_t length = count * 4;
+  serialise(packet, values, count);
+  poolMissCount++; // writeTo() allocates and copies a pbuf
+  return udp.writeTo(packet, length, IPAddress(ip), port) == length;
+}
+#endif
+
+#if !UDP_TRANSPORT_RAW
+static AsyncUDP asyncUdp;
+
+static void onAsyncPacket(AsyncUDPPacket &packet) {
+  receivedCount++;
+  if (receiveHandler != NULL) {
+    receiveHandler(packet.data(), packet.length(),
+                   (uint32_t)packet.remoteIP());
+  }
+}
+#endif
+
+bool initUDPTransport(uint16_t localPort, UdpReceiveHandler handler) {
+  receiveHandler = handler;
+#if UDP_TRANSPORT_RAW
+  return initRaw(localPort);
+#else
+  if (!asyncUdp.listen(localPort)) {
+    return false;
+  }
+  asyncUdp.onPacket(onAsyncPacket);
+  return true;
+#endif
+}
+
+bool udpTransportSend(uint32_t ip, uint16_t port, const uint32_t *values,
+                      size_t count) {
+  if (count == 0 || count > UDP_MAX_DATAGRAM_WORDS) {
+    sendErrorCount++;
+    return false;
+  }
+#if UDP_TRANSPORT_RAW
+  bool ok = rawSend(ip, port, values, count);
+#else
+  bool ok = asyncSend(asyncUdp, ip, port, values, count);
+#endif
+  if (ok) {
+    sentCount++;
+  } else {
+    sendErrorCount++;
+  }
+  return ok;
+}
+
+void getUDPTransportStats(UdpTransportStats *stats) {
+  stats->sent = sentCount;
+  stats->sendErrors = sendErrorCount;
+  stats->poolHits = poolHitCount;
+  stats->poolMisses = poolMissCount;
+  stats->received = receivedCount;
+}
+
+#ifdef UDP_BENCH
+#if !UDP_TRANSPORT_RAW
+#error "UDP_BENCH compares against the raw transport, set UDP_TRANSPORT_RAW"
+#endif
+#include "wifi_udp.h"
+#include <algorithm>
+
+#define UDP_BENCH_SENDS 200
+#define UDP_BENCH_PORT 9 // discard; the scoring device ignores it
+
+static volatile bool benchCounting = false;
+static volatile uint32_t benchAllocs = 0;
+static uint32_t benchCycles[UDP_BENCH_SENDS];
+static AsyncUDP benchAsyncUdp;
+
+// Linked with -Wl,--wrap=pbuf_alloc: counts the heap pbufs allocated by
+// any caller (AsyncUDP, lwIP, this file) while a benchmark runs
+extern "C" struct pbuf *__real_pbuf_alloc(pbuf_layer layer, u16_t length,
+                                          pbuf_type type);
+extern "C" struct pbuf *__wrap_pbuf_alloc(pbuf_layer layer, u16_t length,
+                                          pbuf_type type) {
+  if (benchCounting && type == PBUF_RAM) {
+    benchAllocs++;
+  }
+  return __real_pbuf_alloc(layer, length, type);
+}
+
+typedef bool (*BenchSend)(uint32_t ip, const uint32_t *values, size_t count);
+
+static bool benchAsyncSend(uint32_t ip, const uint32_t *values,
+                           size_t count) {
+  return asyncSend(benchAsyncUdp, ip, UDP_BENCH_PORT, values, count);
+}
+
+static bool benchRawSend(uint32_t ip, const uint32_t *values, size_t count) {
+  return rawSend(ip, UDP_BENCH_PORT, values, count);
+}
+
+static void runBench(const char *name, BenchSend send, uint32_t ip) {
+  uint32_t word = 0;
+  send(ip, &word, 1); // warm up ARP and the pcb outside the measurement
+
+  uint32_t failures = 0;
+  benchAllocs = 0;
+  benchCounting = true;
+  for (uint32_t i = 0; i < UDP_BENCH_SENDS; i++) {
+    word = i;
+    uint32_t start = ESP.getCycleCount();
+    if (!send(ip, &word, 1)) {
+      failures++;
+    }
+    benchCycles[i] = ESP.getCycleCount() - start;
+    delay(2); // presses are sparse; let the driver finish the frame
+  }
+  benchCounting = false;
+
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < UDP_BENCH_SENDS; i++) {
+    sum += benchCycles[i];
+  }
+  std::sort(benchCycles, benchCycles + UDP_BENCH_SENDS);
+  LOG_INFO("UDP bench: %s %u sends, %u failed\n", name, UDP_BENCH_SENDS,
+           failures);
+  LOG_INFO("UDP bench: %s cycles avg %u, p50 %u, p99 %u\n", name,
+           (uint32_t)(sum / UDP_BENCH_SENDS),
+           benchCycles[UDP_BENCH_SENDS / 2],
+           benchCycles[(UDP_BENCH_SENDS - 1) * 99 / 100]);
+  LOG_INFO("UDP bench: %s max %u cycles, %u pbuf allocs per 100 sends\n",
+           name, benchCycles[UDP_BENCH_SENDS - 1],
+           benchAllocs * 100 / UDP_BENCH_SENDS);
+}
+
+void serviceUDPBench() {
+  static bool done = false;
+  if (done || !wifiConnected) {
+    return;
+  }
+  done = true;
+  IPAddress target;
+  target.fromString(UDP_TARGET_IP);
+  runBench("AsyncUDP", benchAsyncSend, (uint32_t)target);
+  runBench("raw", benchRawSend, (uint32_t)target);
+}
+#endif
@@ -0,0 +1,52 @@
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Datagram transport under wifi_udp.cpp.
+//
+// 1: a raw lwIP udp_pcb bound once, sending from a small pool of pbufs
+//    that are allocated at startup and reused, with command words
+//    serialised straight into them. No heap traffic per send.
+// 0: AsyncUDP, which allocates and copies a pbuf for every datagram
+#ifndef UDP_TRANSPORT_RAW
+#define UDP_TRANSPORT_RAW 1
+#endif
+
+// Preallocated pbufs, each large enough for UDP_MAX_DATAGRAM_WORDS. A pbuf
+// still referenced by the WiFi driver or the ARP queue is skipped; if all
+// are busy the send falls back to a one-off allocation (a pool miss).
+#define UDP_PBUF_POOL_SIZE 4
+
+// Incoming datagram. Runs on the lwIP thread (raw) or the AsyncUDP task,
+// so it must not block; data is only valid during the call.
+typedef void (*UdpReceiveHandler)(const uint8_t *data, size_t length,
+                                  uint32_t fromIp);
+
+typedef struct {
+  uint32_t sent;       // datagrams accepted by the stack
+  uint32_t sendErrors; // datagrams the stack refused
+  uint32_t poolHits;   // sends from a preallocated pbuf (raw only)
+  uint32_t poolMisses; // sends that had to allocate one
+  uint32_t received;
+} UdpTransportStats;
+
+// Bind the local port and start receiving. Call once, after WiFi.mode().
+bool initUDPTransport(uint16_t localPort, UdpReceiveHandler handler);
+
+// Send count little-endian words as one datagram. ip is in network byte
+// order, as in (uint32_t)IPAddress. count is 1..UDP_MAX_DATAGRAM_WORDS.
+bool udpTransportSend(uint32_t ip, uint16_t port, const uint32_t *values,
+                      size_t count);
+
+void getUDPTransportStats(UdpTransportStats *stats);
+
+// Build with -D UDP_BENCH (env:udp_bench) to compare cycles and pbuf
+// allocations per send of AsyncUDP and the raw path once the station has
+// an IP address. Call from loop(); runs once.
+#ifdef UDP_BENCH
+void serviceUDPBench();
+#endif
+
+#endif // UDP_TRANSPORT_H
@@ -8,26 +8,27 @@
 #include <string.h>
 #include <ctype.h>
 #include "../backlight.h"
+#include "../commands.h"
 
-extern bool sendUDP32(uint32_t value);
+extern bool sendUDP32Array(uint32_t *values, size_t count);
 
 void OnLeftScorePlusClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000005);
+	sendCommand(CMD_SCORE_LEFT_PLUS);
 }
 
 void OnScoreLeftMinClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000006);
+	sendCommand(CMD_SCORE_LEFT_MINUS);
 }
 
 void OnStartStopClicked(lv_event_t * e)
 {
 	// Your code here
 	printf("The user clicked START/STOP\n");
-	sendUDP32(0x06000011);
+	sendCommand(CMD_START_STOP);
 }
 
 void OnSwipeLeft(lv_event_t * e)
@@ -43,125 +44,125 @@ void OnResetClicked(lv_event_t * e)
 void OnResetLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000003);
+	sendCommandLong(CMD_RESET);
 }
 
 void OnRightScorePlusClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000007);
+	sendCommand(CMD_SCORE_RIGHT_PLUS);
 }
 
 void OnRightScoreMinClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000008);
+	sendCommand(CMD_SCORE_RIGHT_MINUS);
 }
 
 
 void OnNextPauseLongpressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000021);
+	sendCommandLong(CMD_NEXT_PAUSE);
 }
 
 void OnCycleWeaponClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000012);
+	sendCommand(CMD_CYCLE_WEAPON);
 }
 
 void OnCycleMatchTypeClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600000a);
+	sendCommand(CMD_CYCLE_MATCH_TYPE);
 }
 
 void OnCycleIntensityClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000030);
+	sendCommand(CMD_CYCLE_INTENSITY);
 }
 
 void OnYellowCardLeftClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000013);
+	sendCommand(CMD_YELLOW_CARD_LEFT);
 }
 
 void OnRedCardLeftClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000015);
+	sendCommand(CMD_RED_CARD_LEFT);
 }
 
 void OnBlackCardLeftClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000051);
+	sendCommand(CMD_BLACK_CARD_LEFT);
 	
 }
 
 void OnYellowCardRightClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000014);
+	sendCommand(CMD_YELLOW_CARD_RIGHT);
 }
 
 void OnRedCardRightClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000016);
+	sendCommand(CMD_RED_CARD_RIGHT);
 }
 
 void OnBlackCardRightClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000050);
+	sendCommand(CMD_BLACK_CARD_RIGHT);
 	
 }
 
 void OnUW2FClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000017);
+	sendCommand(CMD_UW2F);
 	
 }
 
 void OnPrioClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000010);
+	sendCommand(CMD_PRIO);
 }
 
 void OnRedCardLeftLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff15);
+	sendCommandLong(CMD_RED_CARD_LEFT);
 }
 
 void OnBlackCardLeftLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff51);
+	sendCommandLong(CMD_BLACK_CARD_LEFT);
 }
 
 void OnYellowCardRightLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff14);
+	sendCommandLong(CMD_YELLOW_CARD_RIGHT);
 }
 
 void OnBlackCardRightLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff50);
+	sendCommandLong(CMD_BLACK_CARD_RIGHT);
 }
 
 void OnUW2FLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff17);
+	sendCommandLong(CMD_UW2F);
 }
 
 void OnPrioLongPressed(lv_event_t * e)
@@ -172,13 +173,13 @@ void OnPrioLongPressed(lv_event_t * e)
 void OnYellowCardLeftLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff13);
+	sendCommandLong(CMD_YELLOW_CARD_LEFT);
 }
 
 void OnRedCardRightLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600ff16);
+	sendCommandLong(CMD_RED_CARD_RIGHT);
 }
 
 void OnUNDOUW2FTimerResetClicked(lv_event_t * e)
@@ -187,13 +188,15 @@ void OnUNDOUW2FTimerResetClicked(lv_event_t * e)
 }
 
 extern int PisteNr;
+extern void setPisteNumberText(const char *number);
 void OnPisteIDChanged(lv_event_t * e)
 {
 	// Your code here
 	
 	const char* pisteValue = lv_textarea_get_text(ui_TextAreaPisteNr);
 	PisteNr = atoi(pisteValue);
-	lv_label_set_text_fmt(ui_LabelPisteID, "Piste %s", pisteValue);
+	// Also updates the label on the Central screen, if it is built
+	setPisteNumberText(pisteValue);
 	printf("The user changed the piste to %s (int: %d)\n", pisteValue, PisteNr);
 	SetPiste(PisteNr);
 	
@@ -202,55 +205,55 @@ void OnPisteIDChanged(lv_event_t * e)
 void OnNextClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000101);
+	sendCommand(CMD_NEXT);
 }
 
 void OnPrevClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000102);
+	sendCommand(CMD_PREV);
 }
 
 void OnBeginLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000103);
+	sendCommandLong(CMD_BEGIN);
 }
 
 void OnEndLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000104);
+	sendCommandLong(CMD_END);
 }
 
 void OnSwapClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600001a);
+	sendCommand(CMD_SWAP);
 }
 
 void OnResLClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600001);
+	sendCommand(CMD_RESERVE_LEFT);
 }
 
 void OnResRClicked(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x0600001c);
+	sendCommand(CMD_RESERVE_RIGHT);
 }
 
 void OnLeftScorePlusLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000006);
+	sendCommandLong(CMD_SCORE_LEFT_PLUS);
 }
 
 void OnRightScorePlusLongPressed(lv_event_t * e)
 {
 	// Your code here
-	sendUDP32(0x06000008);
+	sendCommandLong(CMD_SCORE_RIGHT_PLUS);
 }
 
 
@@ -305,10 +308,6 @@ void OnTimerTextChanged(lv_event_t * e)
 	formatting = false;
 }
 
-#define UI_SET_MINUTES 0x06000040
-#define UI_SET_SECONDS 0x06000041
-#define UI_SET_HUNDREDS 0x06000042
-
 void OnNewTimeEntered(lv_event_t * e)
 {
 	// Get the time text from textarea
@@ -331,10 +330,13 @@ void OnNewTimeEntered(lv_event_t * e)
 		// Extract hundredths (after .)
 		hundredths = atoi(dot + 1);
 		
-		// Send each value via UDP
-		sendUDP32(UI_SET_MINUTES | (minutes << 8 & 0xFF00));
-		sendUDP32(UI_SET_SECONDS | (seconds << 8 & 0xFF00));
-		sendUDP32(UI_SET_HUNDREDS | (hundredths << 8 & 0xFF00));
+		// Send the three values together so they share one datagram
+		uint32_t timeWords[3] = {
+			commandWordWithArg(CMD_SET_MINUTES, (uint8_t)minutes),
+			commandWordWithArg(CMD_SET_SECONDS, (uint8_t)seconds),
+			commandWordWithArg(CMD_SET_HUNDREDS, (uint8_t)hundredths)
+		};
+		sendUDP32Array(timeWords, 3);
 		
 		printf("Time set: %d:%02d.%02d\n", minutes, seconds, hundredths);
 	}
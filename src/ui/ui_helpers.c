@@ -46,10 +46,16 @@ void _ui_slider_set_property(lv_obj_t * target, int id, int val)
     if(id == _UI_SLIDER_PROPERTY_VALUE) lv_slider_set_value(target, val, LV_ANIM_OFF);
 }
 
+void (*_ui_screen_build_hook)(lv_obj_t ** target, void (*target_init)(void)) = NULL;
+
 void _ui_screen_change(lv_obj_t ** target, lv_scr_load_anim_t fademode, int spd, int delay, void (*target_init)(void))
 {
-    if(*target == NULL)
-        target_init();
+    if(*target == NULL) {
+        if(_ui_screen_build_hook)
+            _ui_screen_build_hook(target, target_init);
+        else
+            target_init();
+    }
     lv_scr_load_anim(*target, fademode, spd, delay, false);
 }
 
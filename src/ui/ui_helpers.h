@@ -40,6 +40,9 @@ void _ui_roller_set_property(lv_obj_t * target, int id, int val);
 #define _UI_SLIDER_PROPERTY_VALUE_WITH_ANIM 1
 void _ui_slider_set_property(lv_obj_t * target, int id, int val);
 
+// Optional hook: when set, _ui_screen_change() builds screens through it
+// instead of calling target_init directly (see screen_manager.cpp)
+extern void (*_ui_screen_build_hook)(lv_obj_t ** target, void (*target_init)(void));
 void _ui_screen_change(lv_obj_t ** target, lv_scr_load_anim_t fademode, int spd, int delay, void (*target_init)(void));
 
 void _ui_arc_increment(lv_obj_t * target, int val);
@@ -0,0 +1,92 @@
+#include "wifi_cache.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define NVS_KEY_MAX 15
+
+// Identifies the run of the system clock; kept through software resets
+// like the clock itself
+static RTC_NOINIT_ATTR uint32_t rtcClockSession;
+
+static uint32_t clockSession() {
+  static bool checked = false;
+  if (!checked) {
+    checked = true;
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool clockKept = reason == ESP_RST_SW || reason == ESP_RST_PANIC ||
+                     reason == ESP_RST_INT_WDT ||
+                     reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT ||
+                     reason == ESP_RST_DEEPSLEEP;
+    if (!clockKept || rtcClockSession == 0) {
+      rtcClockSession = esp_random() | 1; // RTC memory is random at power-on
+    }
+  }
+  return rtcClockSession;
+}
+
+// NVS keys are limited to 15 characters. Piste SSIDs fit; anything longer
+// is replaced by its FNV-1a hash.
+static void cacheKey(const char *ssid, char *key) {
+  size_t len = strlen(ssid);
+  if (len <= NVS_KEY_MAX) {
+    memcpy(key, ssid, len + 1);
+    return;
+  }
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)ssid[i]) * 16777619u;
+  }
+  snprintf(key, NVS_KEY_MAX + 1, "h%08x", (unsigned)hash);
+}
+
+bool loadWiFiCache(const char *ssid, WiFiCacheEntry *entry) {
+  char key[NVS_KEY_MAX + 1];
+  cacheKey(ssid, key);
+
+  Preferences prefs;
+  if (!prefs.begin(WIFI_CACHE_NAMESPACE, true)) {
+    return false; // namespace does not exist yet
+  }
+  size_t len = prefs.getBytes(key, entry, sizeof(*entry));
+  prefs.end();
+  return len == sizeof(*entry) && entry->version == WIFI_CACHE_VERSION &&
+         entry->channel != 0 && entry->ip != 0;
+}
+
+void saveWiFiCache(const char *ssid, const WiFiCacheEntry *entry) {
+  WiFiCacheEntry stored;
+  if (loadWiFiCache(ssid, &stored) &&
+      memcmp(&stored, entry, sizeof(stored)) == 0) {
+    return;
+  }
+
+  char key[NVS_KEY_MAX + 1];
+  cacheKey(ssid, key);
+  Preferences prefs;
+  prefs.begin(WIFI_CACHE_NAMESPACE, false);
+  prefs.putBytes(key, entry, sizeof(*entry));
+  prefs.end();
+}
+
+void clearWiFiCache(const char *ssid) {
+  char key[NVS_KEY_MAX + 1];
+  cacheKey(ssid, key);
+  Preferences prefs;
+  prefs.begin(WIFI_CACHE_NAMESPACE, false);
+  prefs.remove(key);
+  prefs.end();
+}
+
+void setWiFiCacheLease(WiFiCacheEntry *entry, uint32_t renewSeconds) {
+  entry->clockSession = clockSession();
+  entry->renewAtS = renewSeconds ? (uint32_t)time(NULL) + renewSeconds : 0;
+}
+
+bool wifiCacheLeaseValid(const WiFiCacheEntry *entry) {
+  return entry->renewAtS != 0 && entry->clockSession == clockSession() &&
+         (int32_t)(entry->renewAtS - (uint32_t)time(NULL)) > 0;
+}
@@ -0,0 +1,46 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-piste connection cache in NVS. After a successful DHCP connect the
+// access point (BSSID, channel) and the lease are stored under the SSID, so
+// the next connect to the same piste can skip the scan and DHCP.
+//
+// The lease is only reused until the time the DHCP client would have
+// started renewing it (T1). That time is kept as system time, which
+// survives software resets and panics but restarts at power-on, so each
+// entry also records the clock session it was stored in: a lease from
+// before a power cycle is of unknown age and is never reused. The access
+// point is used regardless, with DHCP instead of the lease.
+#define WIFI_CACHE_NAMESPACE "wificache"
+#define WIFI_CACHE_VERSION 2
+
+typedef struct {
+  uint8_t version;
+  uint8_t channel;
+  uint8_t bssid[6];
+  uint32_t ip; // addresses in lwIP byte order, as IPAddress stores them
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t clockSession; // see wifiCacheLeaseValid()
+  uint32_t renewAtS;     // system time of the lease's T1, 0: unknown
+} WiFiCacheEntry;
+
+// Returns false if nothing (valid) is stored for ssid
+bool loadWiFiCache(const char *ssid, WiFiCacheEntry *entry);
+
+// Writes only if the entry differs from what is stored, to spare the flash
+void saveWiFiCache(const char *ssid, const WiFiCacheEntry *entry);
+
+void clearWiFiCache(const char *ssid);
+
+// Records a lease obtained now, renewSeconds being its T1
+void setWiFiCacheLease(WiFiCacheEntry *entry, uint32_t renewSeconds);
+
+// True while the entry's lease can be reused as a static configuration
+bool wifiCacheLeaseValid(const WiFiCacheEntry *entry);
+
+#endif // WIFI_CACHE_H
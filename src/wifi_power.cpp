@@ -0,0 +1,159 @@
+#include "wifi_power.h"
+#include "logger.h"
+#include "udp_queue.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+
+static const uint32_t DUTY_PERMILLE[WIFI_POWER_MODE_COUNT] = {
+    WIFI_POWER_BEACON_RX_MS * 1000 / WIFI_POWER_DTIM_PERIOD_MS, 1000};
+
+// The mode changes on the loop task; the network task reads it and the
+// pending press when a datagram goes out
+static portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile WiFiPowerMode mode = WIFI_POWER_SAVE;
+static bool governorEnabled = true;
+static uint32_t activeWindowMs = WIFI_POWER_ACTIVE_WINDOW_MS_DEFAULT;
+static uint32_t lastActivityMs = 0;
+static volatile bool remoteIdle = true;
+
+static uint32_t enteredMs = 0;
+static uint32_t timeInModeMs[WIFI_POWER_MODE_COUNT];
+static uint32_t wakeups = 0;
+
+static bool pressPending = false;
+static uint32_t pressUs = 0;
+static uint32_t presses[WIFI_POWER_MODE_COUNT];
+static uint64_t pressToWireSumUs[WIFI_POWER_MODE_COUNT];
+static uint32_t pressToWireMaxUs[WIFI_POWER_MODE_COUNT];
+
+static void setMode(WiFiPowerMode next) {
+  if (next == mode) {
+    return;
+  }
+  esp_wifi_set_ps(next == WIFI_POWER_ACTIVE ? WIFI_PS_NONE
+                                            : WIFI_PS_MIN_MODEM);
+  uint32_t now = millis();
+  portENTER_CRITICAL(&powerMux);
+  timeInModeMs[mode] += now - enteredMs;
+  enteredMs = now;
+  mode = next;
+  if (next == WIFI_POWER_ACTIVE) {
+    wakeups++;
+  }
+  portEXIT_CRITICAL(&powerMux);
+  LOG_INFO("WiFi power: %s\n", next == WIFI_POWER_ACTIVE ? "active" : "save");
+}
+
+void initWiFiPower() {
+  WiFi.setSleep(true);
+  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  mode = WIFI_POWER_SAVE;
+  enteredMs = millis();
+}
+
+void wifiPowerOnPress() {
+  portENTER_CRITICAL(&powerMux);
+  pressPending = true;
+  pressUs = (uint32_t)esp_timer_get_time();
+  portEXIT_CRITICAL(&powerMux);
+  wifiPowerOnActivity();
+}
+
+void wifiPowerOnActivity() {
+  lastActivityMs = millis();
+  bool wasIdle = remoteIdle;
+  remoteIdle = false;
+  if (governorEnabled) {
+    setMode(WIFI_POWER_ACTIVE);
+  }
+  if (wasIdle) {
+    notifyUDPQueue(); // liveness probes back to their active period
+  }
+}
+
+void wifiPowerOnIdle() {
+  remoteIdle = true;
+  setMode(WIFI_POWER_SAVE);
+}
+
+bool remoteActive() { return !remoteIdle; }
+
+WiFiPowerMode wifiPowerMode() { return mode; }
+
+void wifiPowerOnTransmit() {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  portENTER_CRITICAL(&powerMux);
+  if (pressPending) {
+    pressPending = false;
+    uint32_t latency = now - pressUs;
+    if (latency < (uint32_t)WIFI_POWER_PRESS_EXPIRY_MS * 1000) {
+      presses[mode]++;
+      pressToWireSumUs[mode] += latency;
+      if (latency > pressToWireMaxUs[mode]) {
+        pressToWireMaxUs[mode] = latency;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&powerMux);
+}
+
+uint32_t serviceWiFiPower() {
+  if (remoteIdle) {
+    return UINT32_MAX;
+  }
+  uint32_t quiet = millis() - lastActivityMs;
+  if (quiet >= activeWindowMs) {
+    wifiPowerOnIdle();
+    return UINT32_MAX;
+  }
+  return activeWindowMs - quiet;
+}
+
+void setWiFiPowerActiveWindow(uint32_t windowMs) { activeWindowMs = windowMs; }
+
+void setWiFiPowerGovernorEnabled(bool enabled) {
+  governorEnabled = enabled;
+  if (!enabled) {
+    setMode(WIFI_POWER_SAVE);
+  }
+}
+
+void getWiFiPowerStats(WiFiPowerStats *stats) {
+  portENTER_CRITICAL(&powerMux);
+  stats->mode = mode;
+  stats->governorEnabled = governorEnabled;
+  stats->wakeups = wakeups;
+  for (int i = 0; i < WIFI_POWER_MODE_COUNT; i++) {
+    stats->timeInModeMs[i] = timeInModeMs[i];
+    stats->dutyPermille[i] = DUTY_PERMILLE[i];
+    stats->presses[i] = presses[i];
+    stats->pressToWireAvgUs[i] =
+        presses[i] ? (uint32_t)(pressToWireSumUs[i] / presses[i]) : 0;
+    stats->pressToWireMaxUs[i] = pressToWireMaxUs[i];
+  }
+  stats->timeInModeMs[mode] += millis() - enteredMs;
+  portEXIT_CRITICAL(&powerMux);
+
+  uint64_t total = 0;
+  uint64_t on = 0;
+  for (int i = 0; i < WIFI_POWER_MODE_COUNT; i++) {
+    total += stats->timeInModeMs[i];
+    on += (uint64_t)stats->timeInModeMs[i] * DUTY_PERMILLE[i];
+  }
+  stats->dutyPermilleOverall = total ? (uint32_t)(on / total) : 0;
+}
+
+void resetWiFiPowerStats() {
+  portENTER_CRITICAL(&powerMux);
+  enteredMs = millis();
+  wakeups = 0;
+  pressPending = false;
+  for (int i = 0; i < WIFI_POWER_MODE_COUNT; i++) {
+    timeInModeMs[i] = 0;
+    presses[i] = 0;
+    pressToWireSumUs[i] = 0;
+    pressToWireMaxUs[i] = 0;
+  }
+  portEXIT_CRITICAL(&powerMux);
+}
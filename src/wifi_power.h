@@ -0,0 +1,85 @@
+#ifndef WIFI_POWER_H
+#define WIFI_POWER_H
+
+#include <stdint.h>
+
+// WiFi power-save governor. In modem sleep (WIFI_PS_MIN_MODEM) the radio
+// only wakes for every DTIM beacon, so the first exchange after a quiet
+// period can wait 100+ ms. The governor turns power save off as soon as a
+// touch or a button press begins, i.e. before the command is sent on
+// release, keeps it off for the active window after the last activity and
+// returns to modem sleep when that expires or the backlight dims.
+#define WIFI_POWER_ACTIVE_WINDOW_MS_DEFAULT 10000
+
+// Radio duty cycle model for the estimate in WiFiPowerStats: in modem sleep
+// the station is awake for about WIFI_POWER_BEACON_RX_MS per DTIM period
+// (beacon interval 102.4 ms x DTIM 3 on a typical AP)
+#define WIFI_POWER_DTIM_PERIOD_MS 307
+#define WIFI_POWER_BEACON_RX_MS 3
+
+// A press that has not led to a datagram within this time did not send a
+// command (e.g. navigation) and is not counted as press-to-wire latency
+#define WIFI_POWER_PRESS_EXPIRY_MS 5000
+
+typedef enum {
+  WIFI_POWER_SAVE,   // WIFI_PS_MIN_MODEM
+  WIFI_POWER_ACTIVE, // WIFI_PS_NONE
+  WIFI_POWER_MODE_COUNT
+} WiFiPowerMode;
+
+typedef struct {
+  WiFiPowerMode mode;
+  bool governorEnabled;
+  uint32_t timeInModeMs[WIFI_POWER_MODE_COUNT]; // including the current stay
+  uint32_t wakeups;        // switches to WIFI_POWER_ACTIVE
+  uint32_t dutyPermille[WIFI_POWER_MODE_COUNT]; // estimated radio-on share
+  uint32_t dutyPermilleOverall;
+  // Press to first datagram handed to the stack, by power mode at send
+  // time. For touch this includes holding the finger down until release.
+  uint32_t presses[WIFI_POWER_MODE_COUNT];
+  uint32_t pressToWireAvgUs[WIFI_POWER_MODE_COUNT];
+  uint32_t pressToWireMaxUs[WIFI_POWER_MODE_COUNT];
+} WiFiPowerStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Puts the radio into modem sleep. Call from initWiFi().
+void initWiFiPower();
+
+// Activity inputs, on the loop task. onPress at the start of a touch or
+// button press, onActivity while a touch continues.
+void wifiPowerOnPress();
+void wifiPowerOnActivity();
+
+// The remote went idle (backlight dimmed): back to power save right away
+void wifiPowerOnIdle();
+
+// Touch or button activity within the active window (from any task,
+// independent of whether the governor is enabled)
+bool remoteActive();
+
+// Current radio mode, any task
+WiFiPowerMode wifiPowerMode();
+
+// Called by the network task after each datagram, for press-to-wire latency
+void wifiPowerOnTransmit();
+
+// Returns to power save once the active window has expired. Call from
+// loop(); returns the ms until the window expires (UINT32_MAX if idle).
+uint32_t serviceWiFiPower();
+
+void setWiFiPowerActiveWindow(uint32_t windowMs);
+
+// false keeps the radio in modem sleep, for comparing latencies
+void setWiFiPowerGovernorEnabled(bool enabled);
+
+void getWiFiPowerStats(WiFiPowerStats *stats);
+void resetWiFiPowerStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WIFI_POWER_H
@@ -1,8 +1,24 @@
 #include "wifi_udp.h"
+#include "arp_warm.h"
+#include "boot_profile.h"
+#include "command_journal.h"
+#include "connectivity.h"
 #include "esp_wifi.h"
-#include <AsyncUDP.h>
+#include "liveness.h"
+#include "logger.h"
+#include "loop_scheduler.h"
+#include "reliable_udp.h"
+#include "scoreboard.h"
+#include "udp_queue.h"
+#include "udp_transport.h"
+#include "wifi_cache.h"
+#include "wifi_power.h"
 #include <Preferences.h>
 #include <WiFi.h>
+#include <atomic>
+#include <esp_netif.h>
+#include <lwip/dhcp.h>
+#include <lwip/ip4.h>
 
 // WiFi credentials - update these with your access point details
 const char *WIFI_SSID = "Piste_001";
@@ -11,56 +27,257 @@ const char *WIFI_PASSWORD = "01041967";
 // UDP configuration
 const char *UDP_TARGET_IP = "192.168.4.1"; // Update with your target IP
 const uint16_t UDP_TARGET_PORT = 1234;     // Update with your target port
+const uint16_t UDP_LOCAL_PORT = 1234;      // Replies from the scoring device
 
 // Static IP address for UDP target (parsed once)
 static IPAddress targetIP;
 static bool targetIPInitialized = false;
 
-// AsyncUDP instance
-AsyncUDP udp;
-
-// WiFi connection status
+// WiFi connection status: the station has an IP address. The debounced
+// view for the UI is the state machine in connectivity.cpp.
 bool wifiConnected = false;
-static unsigned long lastWiFiStateChange = 0;
-const unsigned long WIFI_STATE_DEBOUNCE =
-    3000; // 3 seconds debounce for state changes
 
-unsigned long lastReconnectAttempt = 0;
-const unsigned long reconnectInterval =
-    5000; // Try to reconnect every 5 seconds
+// Station connect: fast path from the per-piste cache, full scan + DHCP
+// otherwise or when the fast path fails
+static char stationSSID[33] = "";
+static volatile bool connectPending = false; // waiting for the first IP
+// ... on the fast path. The fast connect timeout (esp_timer task) and the
+// WiFi events race to end it; whoever clears it acts.
+static std::atomic<bool> fastConnectPending(false);
+// The fast path failed; serviceWiFiConnect() starts the full connect
+static std::atomic<bool> fullConnectDue(false);
+static bool cachedLeaseInUse = false; // static config from the cache
+static uint32_t connectStartMs = 0;
+static esp_timer_handle_t fastConnectTimer = NULL;
+
+static volatile uint32_t connectAttempts = 0;
+static volatile uint32_t fastAttempts = 0;
+static volatile uint32_t fastSuccesses = 0;
+static volatile uint32_t fastFallbacks = 0;
+static volatile uint32_t lastConnectMs = 0;
+static volatile bool lastConnectFast = false;
+static uint32_t fastConnectSumMs = 0;
+static uint32_t fullConnects = 0;
+static uint32_t fullConnectSumMs = 0;
+
+// All-zero addresses switch the station back to DHCP
+static void useDhcp() {
+  cachedLeaseInUse = false;
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+}
 
-// WiFi event handler for connection monitoring
-void WiFiEvent(WiFiEvent_t event) {
-  unsigned long currentMillis = millis();
+static void startFullConnect() {
+  fastConnectPending = false;
+  useDhcp();
+  WiFi.begin(stationSSID, WIFI_PASSWORD);
+}
+
+// Ends the fast connect; the full connect is left to the loop task, as the
+// NVS erase and WiFi calls would hold up the esp_timer or WiFi event task.
+// Returns false if no fast connect was in progress, or another task has
+// already ended it.
+static bool fallBackToFullConnect(const char *reason) {
+  bool expected = true;
+  if (!fastConnectPending.compare_exchange_strong(expected, false)) {
+    return false;
+  }
+  esp_timer_stop(fastConnectTimer);
+  fastFallbacks++;
+  LOG_WARN("WiFi: Fast connect failed (%s), full connect\n", reason);
+  fullConnectDue = true;
+  wakeLoop();
+  return true;
+}
+
+void serviceWiFiConnect() {
+  if (!fullConnectDue.exchange(false)) {
+    return;
+  }
+  clearWiFiCache(stationSSID);
+  WiFi.disconnect();
+  startFullConnect();
+}
+
+static void onFastConnectTimeout(void *arg) {
+  (void)arg;
+  fallBackToFullConnect("timeout");
+}
+
+// Connect to ssid, through the cache when it has an entry for it
+static void startConnect(const char *ssid) {
+  if (fastConnectTimer == NULL) {
+    esp_timer_create_args_t args = {};
+    args.callback = onFastConnectTimeout;
+    args.name = "wifi_fast";
+    esp_timer_create(&args, &fastConnectTimer);
+  }
+
+  if (ssid != stationSSID) {
+    snprintf(stationSSID, sizeof(stationSSID), "%s", ssid);
+  }
+  connectStartMs = millis();
+  connectPending = true;
+  fullConnectDue = false; // for the attempt this one replaces
+  connectAttempts++;
+  connOnAssociating();
+
+  WiFiCacheEntry entry;
+  if (!loadWiFiCache(stationSSID, &entry)) {
+    LOG_INFO("WiFi: No cached AP, full connect\n");
+    startFullConnect();
+    return;
+  }
+
+  // The access point is still worth knowing when the lease is not
+  uint32_t timeoutMs = WIFI_FAST_CONNECT_TIMEOUT_MS;
+  if (wifiCacheLeaseValid(&entry)) {
+    LOG_INFO("WiFi: Fast connect on channel %u\n", entry.channel);
+    cachedLeaseInUse = true;
+    WiFi.config(IPAddress(entry.ip), IPAddress(entry.gateway),
+                IPAddress(entry.subnet), IPAddress(entry.dns));
+  } else {
+    LOG_INFO("WiFi: Fast connect on channel %u, lease expired, DHCP\n",
+             entry.channel);
+    useDhcp();
+    timeoutMs = WIFI_FAST_CONNECT_DHCP_TIMEOUT_MS;
+  }
+  fastAttempts++;
+  fastConnectPending = true;
+  WiFi.begin(stationSSID, WIFI_PASSWORD, entry.channel, entry.bssid);
+  esp_timer_start_once(fastConnectTimer, (uint64_t)timeoutMs * 1000);
+}
 
+// Backoff retry from the connectivity state machine
+static void reconnectStation() { startConnect(stationSSID); }
+
+// T1 of the lease DHCP has just bound, 0 if unknown. lwIP sets it before
+// the GOT_IP event is posted.
+static uint32_t dhcpRenewSeconds() {
+  ip4_addr_t local;
+  ip4_addr_set_u32(&local, (uint32_t)WiFi.localIP());
+  struct netif *netif = ip4_route(&local);
+  struct dhcp *dhcp = netif != NULL ? netif_dhcp_data(netif) : NULL;
+  return dhcp != NULL ? dhcp->offered_t1_renew : 0;
+}
+
+// The cached lease got the station online without DHCP. Left static, the
+// address would be kept past the lease for the whole session, however long,
+// and the AP could hand it to another remote. The DHCP client takes over in
+// the background: it clears the address until the AP answers, which usually
+// renews the same one, and the next GOT_IP records the new lease.
+static void restartDhcp() {
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  esp_err_t err = netif != NULL ? esp_netif_dhcpc_start(netif) : -1;
+  if (err != ESP_OK) {
+    LOG_WARN("WiFi: DHCP restart failed (%d)\n", err);
+  }
+}
+
+// Called with the station's IP address: record timing and refresh the cache
+static void onStationConnected() {
+  if (connectPending) {
+    uint32_t elapsed = millis() - connectStartMs;
+    bool fast = fastConnectPending.exchange(false);
+    lastConnectMs = elapsed;
+    lastConnectFast = fast;
+    if (fast) {
+      esp_timer_stop(fastConnectTimer);
+      fastSuccesses++;
+      fastConnectSumMs += elapsed;
+    } else {
+      fullConnects++;
+      fullConnectSumMs += elapsed;
+    }
+    LOG_INFO("WiFi: Connected in %u ms (%s)\n", elapsed,
+             fast ? "fast" : "full");
+    connectPending = false;
+  }
+
+  uint8_t *bssid = WiFi.BSSID();
+  if (bssid == NULL) {
+    return;
+  }
+  WiFiCacheEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.version = WIFI_CACHE_VERSION;
+  entry.channel = (uint8_t)WiFi.channel();
+  memcpy(entry.bssid, bssid, sizeof(entry.bssid));
+  entry.ip = (uint32_t)WiFi.localIP();
+  entry.gateway = (uint32_t)WiFi.gatewayIP();
+  entry.subnet = (uint32_t)WiFi.subnetMask();
+  entry.dns = (uint32_t)WiFi.dnsIP();
+  WiFiCacheEntry stored;
+  if (!cachedLeaseInUse) {
+    setWiFiCacheLease(&entry, dhcpRenewSeconds());
+  } else if (loadWiFiCache(stationSSID, &stored)) {
+    // No new lease on the static path; the cached one keeps its expiry
+    entry.clockSession = stored.clockSession;
+    entry.renewAtS = stored.renewAtS;
+  }
+  saveWiFiCache(stationSSID, &entry);
+}
+
+// WiFi event handler for connection monitoring
+void WiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
   switch (event) {
   case ARDUINO_EVENT_WIFI_STA_CONNECTED:
-    Serial.printf("[%lu] WiFi Event: Connected to AP\n", currentMillis);
+    LOG_INFO("WiFi Event: Connected to AP\n");
     break;
-  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
-    // Allow immediate connection (good news is fast)
-    Serial.printf("[%lu] WiFi Event: Got IP address: %s\n", currentMillis,
-                  WiFi.localIP().toString().c_str());
-    Serial.printf("[%lu]   wifiConnected: %d -> true, lastChange: %lu\n",
-                  currentMillis, wifiConnected, lastWiFiStateChange);
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
+    IPAddress ip = WiFi.localIP();
+    LOG_INFO("WiFi Event: Got IP address: %u.%u.%u.%u\n", ip[0], ip[1], ip[2],
+             ip[3]);
     wifiConnected = true;
-    lastWiFiStateChange = currentMillis;
+    bootMarkWiFiReady();
+    onStationConnected();
+    connOnGotIp();
+    arpWarmOnGotIp((uint32_t)targetIP, (uint32_t)WiFi.gatewayIP());
+    notifyUDPQueue(); // start the liveness probe and ARP resolution
+    if (cachedLeaseInUse) {
+      cachedLeaseInUse = false;
+      restartDhcp(); // last: it clears the addresses read above
+    }
     break;
-  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
-    Serial.printf("[%lu] WiFi Event: Disconnected, wifiConnected=%d, "
-                  "timeSinceChange=%lu\n",
-                  currentMillis, wifiConnected,
-                  currentMillis - lastWiFiStateChange);
-    // Debounce disconnection - only change state after debounce period
-    if (wifiConnected &&
-        currentMillis - lastWiFiStateChange >= WIFI_STATE_DEBOUNCE) {
-      Serial.printf("[%lu]   ACCEPTED: wifiConnected: true -> false\n",
-                    currentMillis);
-      wifiConnected = false;
-      lastWiFiStateChange = currentMillis;
-    } else {
-      Serial.printf("[%lu]   IGNORED: debounce active\n", currentMillis);
+  }
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: {
+    // Our own WiFi.disconnect() (SetPiste, fast-connect fallback) reports
+    // ASSOC_LEAVE and is already followed by a new association
+    bool expected =
+        info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE;
+    LOG_INFO("WiFi Event: Disconnected, reason %d\n",
+             info.wifi_sta_disconnected.reason);
+    wifiConnected = false;
+    arpWarmOnLinkDown();
+    // A stale BSSID or channel shows up as a failed association
+    if (!expected && fallBackToFullConnect("disconnected")) {
+      expected = true;
     }
+    connOnLinkDown(expected);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Incoming datagrams from the scoring device (lwIP thread or AsyncUDP
+// task, see udp_transport.h)
+static void onUDPPacket(const uint8_t *data, size_t length, uint32_t fromIp) {
+  if (length < 4 || fromIp != (uint32_t)targetIP) {
+    return;
+  }
+  uint32_t word = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                  ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+
+  switch (word & RELIABLE_UDP_TAG_MASK) {
+  case RELIABLE_UDP_ACK_TAG:
+    onReliableUDPAck(word);
+    break;
+  case LIVENESS_ECHO_TAG:
+    onLivenessEcho(data, length);
+    break;
+  case SCOREBOARD_STATE_TAG:
+    onScoreboardState(data, length);
     break;
   default:
     break;
@@ -68,7 +285,7 @@ void WiFiEvent(WiFiEvent_t event) {
 }
 
 // Initialize WiFi connection
-void initWiFi() {
+void initWiFi(const char *ssid) {
   Serial.println("WiFi: Initializing...");
 
   // Parse the target IP address once
@@ -82,8 +299,11 @@ void initWiFi() {
     }
   }
 
-  // Register event handler for async monitoring
+  // Register event handler for async monitoring. Reconnects are driven by
+  // the connectivity state machine with backoff, not by the WiFi library.
+  initConnectivity(reconnectStation);
   WiFi.onEvent(WiFiEvent);
+  WiFi.setAutoReconnect(false);
 
   // Set WiFi mode to both station and access point (AP+STA)
   WiFi.mode(WIFI_AP_STA);
@@ -97,23 +317,19 @@ void initWiFi() {
   WiFi.softAPConfig(apIP, apGateway, apSubnet);
   WiFi.softAP("RemoteControl", "01041967");
 
-  // Start station connection
-  Preferences networkpreferences;
-  networkpreferences.begin("network");
-
-  String storedSSID;
-  storedSSID = networkpreferences.getString("Piste", WIFI_SSID);
-  networkpreferences.end();
+  // Bind the UDP socket once so the scoring device can reply to us
+  if (!initUDPTransport(UDP_LOCAL_PORT, onUDPPacket)) {
+    Serial.println("UDP: ERROR - Could not bind local port!");
+  }
 
-  // Use DHCP for station by default (avoid forcing a static IP here)
-  Serial.println("WiFi: Using DHCP for station interface");
-  WiFi.begin(storedSSID.c_str(), WIFI_PASSWORD);
+  // Start station connection: cached AP and lease if we have them,
+  // otherwise scan and DHCP
+  startConnect(ssid);
 
   Serial.print("WiFi: Connecting to ");
-  Serial.println(storedSSID.c_str());
-  // This puts the radio into sleep unless sending UDP packets
-  WiFi.setSleep(true);
-  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  Serial.println(ssid);
+  // Modem sleep while idle; the power governor wakes the radio on touch
+  initWiFiPower();
 }
 
 void SetPiste(int PisteNr) {
@@ -124,107 +340,148 @@ void SetPiste(int PisteNr) {
   networkpreferences.putString("Piste", strPiste);
   networkpreferences.end();
   WiFi.disconnect();
-  WiFi.begin(strPiste, WIFI_PASSWORD);
+  startConnect(strPiste);
 }
 
-// Check WiFi status and attempt reconnection if needed
-// Returns false if connection is lost, true otherwise
-bool checkWiFiConnection() {
-  // If connected, return true
-  if (wifiConnected) {
-    return true;
-  }
+void getWiFiConnectStats(WiFiConnectStats *stats) {
+  stats->attempts = connectAttempts;
+  stats->fastAttempts = fastAttempts;
+  stats->fastSuccesses = fastSuccesses;
+  stats->fastFallbacks = fastFallbacks;
+  stats->lastConnectMs = lastConnectMs;
+  stats->lastConnectFast = lastConnectFast;
+  stats->fastAvgMs = fastSuccesses ? fastConnectSumMs / fastSuccesses : 0;
+  stats->fullAvgMs = fullConnects ? fullConnectSumMs / fullConnects : 0;
+}
 
-  unsigned long currentMillis = millis();
+// Queue a 32-bit word for the network task. Called from LVGL event
+// callbacks, so it must never block. Offline, the word goes to the journal.
+bool sendUDP32(uint32_t value) {
+  if (commandJournalActive()) {
+    return journalCommand(value);
+  }
 
-  // If not connected and enough time has passed since last attempt
-  if (currentMillis - lastReconnectAttempt >= reconnectInterval) {
-    lastReconnectAttempt = currentMillis;
+  return enqueueUDP32(value);
+}
 
-    if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("WiFi: Connection lost. Attempting to reconnect...");
-      // TEST: Comment out WiFi.begin to see if it's causing the flickers
-      // WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    }
+// Queue a 32-bit word that must not wait for other commands
+bool sendUDP32Now(uint32_t value) {
+  if (commandJournalActive()) {
+    return journalCommand(value);
   }
 
-  // Return actual connection status
-  return wifiConnected;
+  return enqueueUDP32Urgent(value);
 }
 
-// Send a 32-bit word via UDP
-bool sendUDP32(uint32_t value) {
-  if (!wifiConnected) {
-    Serial.println("UDP: Cannot send - WiFi not connected");
-    return false;
+// Queue a 32-bit word that goes out right away in a datagram of its own
+bool sendUDP32Alone(uint32_t value) {
+  if (commandJournalActive()) {
+    return journalCommand(value);
   }
 
+  return enqueueUDP32Alone(value);
+}
+
+// Send a 32-bit word via UDP (network task)
+bool transmitUDP32(uint32_t value) { return transmitUDP32Array(&value, 1); }
+
+static bool transmitTo(uint16_t port, const uint32_t *values, size_t count) {
   if (!targetIPInitialized) {
-    Serial.println("UDP: Cannot send - Target IP not initialized");
+    LOG_ERROR("UDP: Cannot send - Target IP not initialized\n");
     return false;
   }
 
-  // Create a packet with the 32-bit value (little-endian)
-  uint8_t packet[4];
-  packet[0] = (value >> 0) & 0xFF;
-  packet[1] = (value >> 8) & 0xFF;
-  packet[2] = (value >> 16) & 0xFF;
-  packet[3] = (value >> 24) & 0xFF;
-
-  // Debug info
-  Serial.printf("UDP: Sending 0x%08X to %s:%d\n", value, UDP_TARGET_IP,
-                UDP_TARGET_PORT);
-  Serial.printf("UDP: From IP: %s\n", WiFi.localIP().toString().c_str());
-
-  // Send the packet
-  size_t sent = udp.writeTo(packet, sizeof(packet), targetIP, UDP_TARGET_PORT);
+  if (count == 0 || count > UDP_MAX_DATAGRAM_WORDS) {
+    LOG_ERROR("UDP: Cannot send - invalid frame of %d words\n", count);
+    return false;
+  }
 
-  if (sent == sizeof(packet)) {
-    Serial.printf("UDP: Successfully sent %d bytes\n", sent);
+  if (udpTransportSend((uint32_t)targetIP, port, values, count)) {
+    LOG_DEBUG("UDP: Sent 0x%08X (%d words) to %s:%d\n", values[0], count,
+              UDP_TARGET_IP, port);
     return true;
   } else {
-    Serial.printf("UDP: Failed to send packet (sent %d of %d bytes)\n", sent,
-                  sizeof(packet));
+    LOG_WARN("UDP: Failed to send packet of %d words\n", count);
     return false;
   }
 }
 
-// Send multiple 32-bit words via UDP
+// Send several 32-bit words as one datagram (network task). The words are
+// serialised straight into a preallocated pbuf, see udp_transport.h.
+bool transmitUDP32Array(const uint32_t *values, size_t count) {
+  return transmitTo(UDP_TARGET_PORT, values, count);
+}
+
+// Queue multiple 32-bit words that go out in one datagram, possibly with
+// other commands. Offline, each word goes to the journal.
 bool sendUDP32Array(uint32_t *values, size_t count) {
-  if (!wifiConnected) {
-    Serial.println("UDP: Cannot send - WiFi not connected");
-    return false;
+  if (commandJournalActive()) {
+    bool allJournaled = true;
+    for (size_t i = 0; i < count; i++) {
+      allJournaled &= journalCommand(values[i]);
+    }
+    return allJournaled;
   }
 
-  if (!targetIPInitialized) {
-    Serial.println("UDP: Cannot send - Target IP not initialized");
-    return false;
-  }
+  return enqueueUDP32Unit(values, count);
+}
 
-  // Create a packet with all 32-bit values
-  size_t packetSize = count * 4;
-  uint8_t *packet = new uint8_t[packetSize];
+#ifdef LOG_BENCH
+#include <algorithm>
 
-  // Pack all values into the packet (little-endian)
-  for (size_t i = 0; i < count; i++) {
-    packet[i * 4 + 0] = (values[i] >> 0) & 0xFF;
-    packet[i * 4 + 1] = (values[i] >> 8) & 0xFF;
-    packet[i * 4 + 2] = (values[i] >> 16) & 0xFF;
-    packet[i * 4 + 3] = (values[i] >> 24) & 0xFF;
-  }
+#define LOG_BENCH_SENDS 200
+#define LOG_BENCH_PORT 9 // discard; the scoring device ignores it
 
-  // Send the packet
-  size_t sent = udp.writeTo(packet, packetSize, targetIP, UDP_TARGET_PORT);
+static uint32_t logBenchCycles[LOG_BENCH_SENDS];
 
-  delete[] packet;
+// Waits until the log task has printed everything and the UART is idle, so
+// one run does not pay for the output of the previous one
+static void drainLog() {
+  LogStats stats;
+  for (getLogStats(&stats); stats.printed < stats.written;
+       getLogStats(&stats)) {
+    delay(10);
+  }
+  Serial.flush();
+}
 
-  if (sent == packetSize) {
-    Serial.printf("UDP: Sent %d words (%d bytes) to %s:%d\n", count, sent,
-                  UDP_TARGET_IP, UDP_TARGET_PORT);
-    return true;
-  } else {
-    Serial.printf("UDP: Failed to send packet (sent %d of %d bytes)\n", sent,
-                  packetSize);
-    return false;
+static void runLogBench(bool deferred) {
+  drainLog();
+  setLogDeferred(deferred);
+  LogStats before;
+  getLogStats(&before);
+  for (uint32_t i = 0; i < LOG_BENCH_SENDS; i++) {
+    uint32_t start = ESP.getCycleCount();
+    transmitTo(LOG_BENCH_PORT, &i, 1);
+    logBenchCycles[i] = ESP.getCycleCount() - start;
+    delay(2); // presses are sparse; let the driver finish the frame
+  }
+  LogStats after;
+  getLogStats(&after);
+  setLogDeferred(true);
+  drainLog();
+
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < LOG_BENCH_SENDS; i++) {
+    sum += logBenchCycles[i];
+  }
+  std::sort(logBenchCycles, logBenchCycles + LOG_BENCH_SENDS);
+  LOG_INFO("Log bench: LOG_DEFERRED=%d cycles avg %u, p50 %u, p99 %u\n",
+           deferred, (uint32_t)(sum / LOG_BENCH_SENDS),
+           logBenchCycles[LOG_BENCH_SENDS / 2],
+           logBenchCycles[(LOG_BENCH_SENDS - 1) * 99 / 100]);
+  LOG_INFO("Log bench: LOG_DEFERRED=%d max %u cycles, %u records dropped\n",
+           deferred, logBenchCycles[LOG_BENCH_SENDS - 1],
+           after.dropped - before.dropped);
+}
+
+void serviceLogBench() {
+  static bool done = false;
+  if (done || !wifiConnected) {
+    return;
   }
+  done = true;
+  runLogBench(false);
+  runLogBench(true);
 }
+#endif
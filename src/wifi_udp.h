@@ -1,7 +1,6 @@
 #ifndef WIFI_UDP_H
 #define WIFI_UDP_H
 
-#include <Arduino.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -12,18 +11,53 @@ extern const char *WIFI_PASSWORD;
 // UDP configuration
 extern const char *UDP_TARGET_IP;
 extern const uint16_t UDP_TARGET_PORT;
+extern const uint16_t UDP_LOCAL_PORT;
 
 // WiFi connection status
 extern bool wifiConnected;
 
-// Initialize WiFi connection
-void initWiFi();
+// Fast connect (cached BSSID, channel and lease, see wifi_cache.h) falls
+// back to a full scan and DHCP if no IP arrives within this time. When the
+// cached lease can no longer be used, e.g. after a power cycle, the fast
+// path still skips the scan but runs DHCP, which takes longer.
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 1500
+#define WIFI_FAST_CONNECT_DHCP_TIMEOUT_MS 4000
 
+typedef struct {
+  uint32_t attempts;      // connects started by initWiFi() / SetPiste()
+  uint32_t fastAttempts;  // ... of which through the cache
+  uint32_t fastSuccesses;
+  uint32_t fastFallbacks; // fast attempts that fell back to a full connect
+  uint32_t lastConnectMs; // start of the attempt to IP address
+  bool lastConnectFast;
+  uint32_t fastAvgMs;
+  uint32_t fullAvgMs;
+} WiFiConnectStats;
 
+// Start WiFi and the association with ssid. Returns immediately; the
+// connection completes in the background (see wifiConnected).
+void initWiFi(const char *ssid);
 
-// Check WiFi status and attempt reconnection if needed
-// Returns false if connection is lost, true otherwise
-bool checkWiFiConnection();
+// Starts the full connect after a failed fast connect. Call from loop().
+void serviceWiFiConnect();
+
+// Connect-time telemetry
+void getWiFiConnectStats(WiFiConnectStats *stats);
+
+// Put a 32-bit word on the wire immediately. Runs on the network task; UI
+// code should use sendUDP32() instead.
+bool transmitUDP32(uint32_t value);
+
+// Put up to UDP_MAX_DATAGRAM_WORDS words on the wire as a single datagram
+bool transmitUDP32Array(const uint32_t *values, size_t count);
+
+// Build with -D LOG_BENCH (env:log_bench) to time a send with its
+// LOG_DEBUG line printed synchronously (LOG_DEFERRED=0) and through the log
+// task (LOG_DEFERRED=1) once the station has an IP address. The datagrams
+// go to the discard port. Call from loop(); runs once.
+#ifdef LOG_BENCH
+void serviceLogBench();
+#endif
 
 // C linkage for functions called from C files (ui_events.c)
 #ifdef __cplusplus
@@ -32,10 +66,17 @@ extern "C" {
 
 void SetPiste(int PisteNr);
 
-// Send a 32-bit word via UDP
+// Queue a 32-bit word for sending via UDP (non-blocking)
 bool sendUDP32(uint32_t value);
 
-// Send multiple 32-bit words via UDP
+// Queue a 32-bit word and flush it without waiting for the batching window
+bool sendUDP32Now(uint32_t value);
+
+// Same, in a datagram of its own (commands that are not batchable)
+bool sendUDP32Alone(uint32_t value);
+
+// Queue up to UDP_MAX_FRAME_WORDS words that must arrive together: they
+// share one datagram (non-blocking)
 bool sendUDP32Array(uint32_t *values, size_t count);
 
 #ifdef __cplusplus